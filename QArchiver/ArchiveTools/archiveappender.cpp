@@ -0,0 +1,557 @@
+#include "archiveappender.h"
+
+#include <archive.h>
+
+#include <QDataStream>
+#include <QDebug>
+
+#include <errno.h>
+
+#ifdef Q_OS_UNIX
+  #include <unistd.h>
+#endif
+
+static const quint32 c_journalMagic = 0x51414a31; // "QAJ1"
+
+static const int c_tarBlockSize = 512;
+static const int c_newcHeaderSize = 110;
+static const int c_odcHeaderSize = 76;
+static const int c_arHeaderSize = 60;
+static const qint64 c_maxMetadataSize = 1024 * 1024; // pax and GNU long name data
+
+static const char c_arMagic[] = "!<arch>\n";
+static const int c_arMagicSize = 8;
+static const char c_cpioTrailer[] = "TRAILER!!!";
+
+#if ARCHIVE_VERSION_NUMBER >= 3000000
+static int appender_open(struct archive *, void *)
+{
+    return ARCHIVE_OK;
+}
+
+static ssize_t appender_write(struct archive *a, void *client_data, const void *buff, size_t length)
+{
+    const qint64 bytes = static_cast<ArchiveAppender*>(client_data)->write(buff, length);
+    if (bytes < 0) {
+        archive_set_error(a, EIO, "Write error");
+        return ARCHIVE_FATAL;
+    }
+    return bytes;
+}
+
+static int appender_close(struct archive *, void *)
+{
+    return ARCHIVE_OK;
+}
+#endif
+
+static void syncFile(QFile *file)
+{
+    file->flush();
+#ifdef Q_OS_UNIX
+    ::fsync(file->handle());
+#endif
+}
+
+static qint64 parseNumber(const QByteArray &data, int pos, int length, int base)
+{
+    const QByteArray field = data.mid(pos, length);
+    const int end = field.indexOf('\0');
+    bool ok;
+    const qint64 value = field.left(end < 0 ? field.size() : end).trimmed().toLongLong(&ok, base);
+    return ok ? value : -1;
+}
+
+// Octal or GNU base-256 number of a tar header
+static qint64 tarNumber(const QByteArray &header, int pos, int length)
+{
+    if (uchar(header.at(pos)) & 0x80) {
+        qint64 value = uchar(header.at(pos)) & 0x7F;
+        for (int i = 1; i < length; ++i) {
+            value = (value << 8) | uchar(header.at(pos + i));
+        }
+        return value;
+    }
+    return parseNumber(header, pos, length, 8);
+}
+
+static bool tarChecksumOk(const QByteArray &header)
+{
+    const qint64 stored = parseNumber(header, 148, 8, 8);
+    qint64 sum = 0;
+    qint64 signedSum = 0;
+    for (int i = 0; i < c_tarBlockSize; ++i) {
+        const char c = (i >= 148 && i < 156) ? ' ' : header.at(i);
+        sum += uchar(c);
+        signedSum += static_cast<signed char>(c);
+    }
+    return stored == sum || stored == signedSum;
+}
+
+static QByteArray nulTerminated(const QByteArray &data)
+{
+    const int end = data.indexOf('\0');
+    return end < 0 ? data : data.left(end);
+}
+
+// Value of the key from pax extended header records "<length> <key>=<value>\n"
+static QByteArray paxValue(const QByteArray &data, const QByteArray &key)
+{
+    int pos = 0;
+    while (pos < data.size()) {
+        const int space = data.indexOf(' ', pos);
+        if (space < 0) {
+            break;
+        }
+        const int length = data.mid(pos, space - pos).toInt();
+        if (length <= 0 || pos + length > data.size()) {
+            break;
+        }
+        const QByteArray record = data.mid(space + 1, pos + length - space - 2); // bez '\n'
+        if (record.startsWith(key + '=')) {
+            return record.mid(key.size() + 1);
+        }
+        pos += length;
+    }
+    return QByteArray();
+}
+
+
+ArchiveAppender::ArchiveAppender(const QString &fileName, Format format)
+    : m_file(fileName)
+    , m_format(format)
+    , m_appendOffset(-1)
+    , m_skip(0)
+    , m_started(false)
+{
+}
+
+ArchiveAppender::~ArchiveAppender()
+{
+    if (m_started) {
+        rollback();
+    }
+}
+
+bool ArchiveAppender::scan()
+{
+    if (!m_file.open(QIODevice::ReadOnly)) {
+        return setError(m_file.errorString());
+    }
+
+    m_names.clear();
+    m_members.clear();
+    bool ok = false;
+    switch (m_format) {
+    case Tar:
+        ok = scanTar();
+        break;
+    case CpioNewc:
+        ok = scanCpio(true);
+        break;
+    case CpioOdc:
+        ok = scanCpio(false);
+        break;
+    case ArBsd:
+        ok = scanAr();
+        break;
+    }
+
+    m_file.close();
+    return ok;
+}
+
+bool ArchiveAppender::scanTar()
+{
+    const qint64 size = m_file.size();
+    QByteArray longName;
+    QByteArray paxPath;
+    qint64 pos = 0;
+    qint64 memberOffset = 0;
+    bool pending = false; // long name or pax header of the next member was read
+
+    while (pos < size) {
+        if (!m_file.seek(pos)) {
+            return setError(m_file.errorString());
+        }
+        const QByteArray header = m_file.read(c_tarBlockSize);
+        if (header.size() != c_tarBlockSize) {
+            return setError(tr("Unexpected end of the tar archive."));
+        }
+        if (header.count('\0') == c_tarBlockSize) {
+            // End of archive
+            m_appendOffset = pos;
+            return true;
+        }
+        if (!tarChecksumOk(header)) {
+            return setError(tr("The tar header at offset %1 is corrupted.").arg(pos));
+        }
+
+        const char type = header.at(156);
+        const qint64 dataSize = tarNumber(header, 124, 12);
+        if (dataSize < 0) {
+            return setError(tr("The tar header at offset %1 is corrupted.").arg(pos));
+        }
+        if (!pending) {
+            memberOffset = pos;
+        }
+        pos += c_tarBlockSize;
+
+        // GNU sparse file has extension headers before the data
+        if (type == 'S' && header.at(482) != 0) {
+            for (;;) {
+                const QByteArray extension = m_file.read(c_tarBlockSize);
+                if (extension.size() != c_tarBlockSize) {
+                    return setError(tr("Unexpected end of the tar archive."));
+                }
+                pos += c_tarBlockSize;
+                if (extension.at(504) == 0) {
+                    break;
+                }
+            }
+        }
+
+        const qint64 dataEnd = pos + (dataSize + c_tarBlockSize - 1) / c_tarBlockSize * c_tarBlockSize;
+        if (type == 'L' || type == 'x') {
+            if (dataSize > c_maxMetadataSize) {
+                return setError(tr("The tar header at offset %1 is corrupted.").arg(pos));
+            }
+            const QByteArray data = m_file.read(dataSize);
+            pending = true;
+            if (type == 'L') {
+                longName = nulTerminated(data);
+            } else {
+                paxPath = paxValue(data, "path");
+            }
+        } else if (type == 'K') {
+            pending = true;
+        } else if (type != 'g') {
+            QByteArray name;
+            if (!paxPath.isEmpty()) {
+                name = paxPath;
+            } else if (!longName.isEmpty()) {
+                name = longName;
+            } else {
+                name = nulTerminated(header.mid(0, 100));
+                // POSIX ustar prefix, GNU tar uses the field for other data
+                if (header.mid(257, 6) == QByteArray("ustar\0", 6)) {
+                    const QByteArray prefix = nulTerminated(header.mid(345, 155));
+                    if (!prefix.isEmpty()) {
+                        name = prefix + '/' + name;
+                    }
+                }
+            }
+            addName(name);
+            addMember(name, memberOffset, dataEnd, dataSize);
+            pending = false;
+            longName.clear();
+            paxPath.clear();
+        }
+
+        pos = dataEnd;
+    }
+
+    if (pos != size) {
+        return setError(tr("Unexpected end of the tar archive."));
+    }
+    // Archive without the end-of-archive blocks
+    m_appendOffset = size;
+    return true;
+}
+
+bool ArchiveAppender::scanCpio(bool newc)
+{
+    const qint64 size = m_file.size();
+    const int headerSize = newc ? c_newcHeaderSize : c_odcHeaderSize;
+    const QByteArray magic = newc ? "070701" : "070707";
+    qint64 pos = 0;
+
+    while (pos + headerSize <= size) {
+        if (!m_file.seek(pos)) {
+            return setError(m_file.errorString());
+        }
+        const QByteArray header = m_file.read(headerSize);
+        if (header.size() != headerSize || !header.startsWith(magic)) {
+            return setError(tr("The cpio header at offset %1 is corrupted.").arg(pos));
+        }
+
+        const qint64 nameSize = newc ? parseNumber(header, 94, 8, 16) : parseNumber(header, 59, 6, 8);
+        const qint64 dataSize = newc ? parseNumber(header, 54, 8, 16) : parseNumber(header, 65, 11, 8);
+        if (nameSize <= 0 || nameSize > c_maxMetadataSize || dataSize < 0) {
+            return setError(tr("The cpio header at offset %1 is corrupted.").arg(pos));
+        }
+        const QByteArray name = nulTerminated(m_file.read(nameSize));
+
+        if (name == c_cpioTrailer) {
+            m_appendOffset = pos;
+            return true;
+        }
+        addName(name);
+
+        const qint64 offset = pos;
+        pos += headerSize + nameSize;
+        if (newc) {
+            pos = (pos + 3) & ~qint64(3);
+        }
+        pos += dataSize;
+        if (newc) {
+            pos = (pos + 3) & ~qint64(3);
+        }
+        addMember(name, offset, pos, dataSize);
+    }
+
+    return setError(tr("The cpio trailer was not found."));
+}
+
+bool ArchiveAppender::scanAr()
+{
+    const qint64 size = m_file.size();
+    if (m_file.read(c_arMagicSize) != QByteArray(c_arMagic, c_arMagicSize)) {
+        return setError(tr("The file is not an ar archive."));
+    }
+
+    qint64 pos = c_arMagicSize;
+    while (pos + c_arHeaderSize <= size) {
+        if (!m_file.seek(pos)) {
+            return setError(m_file.errorString());
+        }
+        const QByteArray header = m_file.read(c_arHeaderSize);
+        const qint64 dataSize = parseNumber(header, 48, 10, 10);
+        if (header.size() != c_arHeaderSize || header.mid(58, 2) != "`\n" || dataSize < 0) {
+            return setError(tr("The ar header at offset %1 is corrupted.").arg(pos));
+        }
+
+        QByteArray name = header.left(16).trimmed();
+        if (name.startsWith("#1/")) {
+            // BSD long name stored before the data
+            const qint64 nameSize = name.mid(3).toLongLong();
+            if (nameSize <= 0 || nameSize > dataSize) {
+                return setError(tr("The ar header at offset %1 is corrupted.").arg(pos));
+            }
+            name = nulTerminated(m_file.read(nameSize));
+        } else if (name.endsWith('/') && name.size() > 1) {
+            name.chop(1);
+        }
+        const qint64 offset = pos;
+        pos += c_arHeaderSize + dataSize;
+        pos += pos & 1;
+
+        if (name != "/" && name != "//" && !name.startsWith("__.SYMDEF")) {
+            addName(name);
+            addMember(name, offset, pos, dataSize);
+        }
+    }
+
+    if (pos != size) {
+        return setError(tr("Unexpected end of the ar archive."));
+    }
+    m_appendOffset = size;
+    // The writer starts with the global header again
+    m_skip = c_arMagicSize;
+    return true;
+}
+
+void ArchiveAppender::addName(const QByteArray &name)
+{
+    QString decoded = QFile::decodeName(name);
+    while (decoded.endsWith(QLatin1Char('/'))) {
+        decoded.chop(1);
+    }
+    if (decoded.startsWith(QLatin1String("./"))) {
+        decoded.remove(0, 2);
+    }
+    m_names.insert(decoded);
+}
+
+void ArchiveAppender::addMember(const QByteArray &name, qint64 offset, qint64 end, qint64 size)
+{
+    Member member;
+    member.name = name;
+    member.offset = offset;
+    member.end = end;
+    member.size = size;
+    m_members.append(member);
+}
+
+const QSet<QString> &ArchiveAppender::entryNames() const
+{
+    return m_names;
+}
+
+const QList<ArchiveAppender::Member> &ArchiveAppender::members() const
+{
+    return m_members;
+}
+
+qint64 ArchiveAppender::appendOffset() const
+{
+    return m_appendOffset;
+}
+
+bool ArchiveAppender::begin()
+{
+    if (m_appendOffset < 0) {
+        return setError(tr("The archive was not scanned."));
+    }
+    if (!m_file.open(QIODevice::ReadWrite)) {
+        return setError(m_file.errorString());
+    }
+
+    if (!m_file.seek(m_appendOffset)) {
+        m_file.close();
+        return setError(m_file.errorString());
+    }
+    m_trailer = m_file.read(m_file.size() - m_appendOffset);
+
+    // Journal has to be on the disk before the archive is changed
+    QFile journal(journalName(m_file.fileName()));
+    if (!journal.open(QIODevice::WriteOnly | QIODevice::Truncate)) {
+        m_file.close();
+        return setError(journal.errorString());
+    }
+    QDataStream out(&journal);
+    out << c_journalMagic << m_appendOffset << m_trailer;
+    syncFile(&journal);
+    if (out.status() != QDataStream::Ok || journal.error() != QFile::NoError) {
+        journal.close();
+        journal.remove();
+        m_file.close();
+        return setError(tr("The append journal could not be written."));
+    }
+    journal.close();
+
+    if (!m_file.seek(m_appendOffset)) {
+        m_file.close();
+        QFile::remove(journalName(m_file.fileName()));
+        return setError(m_file.errorString());
+    }
+
+    m_started = true;
+    return true;
+}
+
+int ArchiveAppender::open(struct archive *a)
+{
+#if ARCHIVE_VERSION_NUMBER >= 3000000
+    return archive_write_open(a, this, appender_open, appender_write, appender_close);
+#else
+    Q_UNUSED(a);
+    return ARCHIVE_FATAL;
+#endif
+}
+
+qint64 ArchiveAppender::write(const void *buff, qint64 length)
+{
+    const char *data = static_cast<const char*>(buff);
+    qint64 skipped = 0;
+    if (m_skip > 0) {
+        skipped = qMin(m_skip, length);
+        m_skip -= skipped;
+    }
+
+    if (length > skipped && m_file.write(data + skipped, length - skipped) != length - skipped) {
+        setError(m_file.errorString());
+        return -1;
+    }
+    return length;
+}
+
+bool ArchiveAppender::commit()
+{
+    syncFile(&m_file);
+    if (m_file.error() != QFile::NoError) {
+        setError(m_file.errorString());
+        rollback();
+        return false;
+    }
+    m_file.close();
+    m_started = false;
+
+    QFile::remove(journalName(m_file.fileName()));
+    return true;
+}
+
+void ArchiveAppender::rollback()
+{
+    if (!m_started) {
+        return;
+    }
+    m_started = false;
+
+    if (restore(&m_file, m_appendOffset, m_trailer)) {
+        m_file.close();
+        QFile::remove(journalName(m_file.fileName()));
+    } else {
+        // Journal is kept for recover()
+        qDebug() << "ArchiveAppender: restoring failed" << m_file.errorString();
+        m_file.close();
+    }
+}
+
+bool ArchiveAppender::recover(const QString &fileName)
+{
+    QFile journal(journalName(fileName));
+    if (!journal.exists()) {
+        return false;
+    }
+
+    if (!journal.open(QIODevice::ReadOnly)) {
+        qDebug() << "ArchiveAppender: journal can not be read" << journal.errorString();
+        return false;
+    }
+    QDataStream in(&journal);
+    quint32 magic = 0;
+    qint64 offset = -1;
+    QByteArray trailer;
+    in >> magic >> offset >> trailer;
+    const bool valid = (in.status() == QDataStream::Ok && magic == c_journalMagic && offset >= 0);
+    journal.close();
+
+    if (!valid) {
+        // Written only partially, the archive was not changed yet
+        journal.remove();
+        return false;
+    }
+
+    qDebug() << "ArchiveAppender: restoring interrupted append of" << fileName;
+    QFile file(fileName);
+    if (!file.open(QIODevice::ReadWrite) || !restore(&file, offset, trailer)) {
+        qDebug() << "ArchiveAppender: restoring failed" << file.errorString();
+        return false;
+    }
+    file.close();
+    journal.remove();
+    return true;
+}
+
+bool ArchiveAppender::restore(QFile *file, qint64 offset, const QByteArray &trailer)
+{
+    if (!file->isOpen() && !file->open(QIODevice::ReadWrite)) {
+        return false;
+    }
+    if (!file->flush() || !file->resize(offset) || !file->seek(offset)) {
+        return false;
+    }
+    if (file->write(trailer) != trailer.size()) {
+        return false;
+    }
+    syncFile(file);
+    return file->error() == QFile::NoError;
+}
+
+QString ArchiveAppender::journalName(const QString &fileName)
+{
+    return fileName + QLatin1String(".Append");
+}
+
+QString ArchiveAppender::errorString() const
+{
+    return m_errorString;
+}
+
+bool ArchiveAppender::setError(const QString &message)
+{
+    qDebug() << "ArchiveAppender:" << message;
+    m_errorString = message;
+    return false;
+}
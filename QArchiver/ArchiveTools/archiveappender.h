@@ -0,0 +1,91 @@
+#ifndef ARCHIVEAPPENDER_H
+#define ARCHIVEAPPENDER_H
+
+#include <QByteArray>
+#include <QCoreApplication>
+#include <QFile>
+#include <QList>
+#include <QSet>
+#include <QString>
+
+struct archive;
+
+/*
+ * Appends members to an uncompressed tar, cpio or ar archive in place.
+ * scan() finds the end-of-archive trailer, the libarchive writer opened by
+ * open() then writes the new members and a new trailer over the old one.
+ *
+ * The old trailer is saved to "<archive>.Append" before the archive is
+ * touched. rollback() or recover() after a crash truncate the archive
+ * and put the trailer back, commit() removes the journal.
+ *
+ * The member ranges found by scan() are also used by ArchiveCompactor
+ * to delete members in place.
+ */
+class ArchiveAppender
+{
+    Q_DECLARE_TR_FUNCTIONS(ArchiveAppender)
+public:
+    enum Format {
+        Tar,
+        CpioNewc,   // SVR4 without CRC
+        CpioOdc,    // POSIX octet-oriented
+        ArBsd
+    };
+
+    struct Member {
+        QByteArray name; // raw name, as libarchive reports it
+        qint64 offset;   // first header (including GNU long name and pax headers)
+        qint64 end;      // end of the padded data
+        qint64 size;     // stored data size
+    };
+
+    ArchiveAppender(const QString &fileName, Format format);
+    ~ArchiveAppender();
+
+    // Finds the end of the last member, collects the member names
+    bool scan();
+    const QSet<QString> &entryNames() const;
+    const QList<Member> &members() const;
+    qint64 appendOffset() const;
+
+    // Saves the trailer to the journal, the archive is then written from appendOffset()
+    bool begin();
+    // archive_write_open() result, the writer must be closed before commit()
+    int open(struct archive *a);
+    // Syncs the archive and removes the journal
+    bool commit();
+    // Truncates the archive and restores its trailer
+    void rollback();
+
+    // Restores the archive left by an interrupted append, true if it was needed
+    static bool recover(const QString &fileName);
+
+    QString errorString() const;
+
+    // libarchive callback
+    qint64 write(const void *buff, qint64 length);
+
+private:
+    static QString journalName(const QString &fileName);
+    static bool restore(QFile *file, qint64 offset, const QByteArray &trailer);
+
+    bool scanTar();
+    bool scanCpio(bool newc);
+    bool scanAr();
+    void addName(const QByteArray &name);
+    void addMember(const QByteArray &name, qint64 offset, qint64 end, qint64 size);
+    bool setError(const QString &message);
+
+    QFile m_file;
+    Format m_format;
+    qint64 m_appendOffset;
+    qint64 m_skip; // bytes of the writer output not written (ar global header)
+    QByteArray m_trailer;
+    QSet<QString> m_names;
+    QList<Member> m_members;
+    bool m_started;
+    QString m_errorString;
+};
+
+#endif // ARCHIVEAPPENDER_H
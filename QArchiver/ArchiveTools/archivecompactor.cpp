@@ -0,0 +1,394 @@
+#include "archivecompactor.h"
+
+#include <QDataStream>
+#include <QDebug>
+
+#include <algorithm>
+
+#include <errno.h>
+#include <stdio.h>
+#include <string.h>
+
+#ifdef Q_OS_UNIX
+  #include <unistd.h>
+#endif
+
+// copy_file_range() je v glibc od verze 2.27
+#if defined(Q_OS_LINUX) && defined(__GLIBC__) && (__GLIBC__ > 2 || (__GLIBC__ == 2 && __GLIBC_MINOR__ >= 27))
+  #define HAVE_COPY_FILE_RANGE
+#endif
+
+static const quint32 c_journalMagic = 0x51414331; // "QAC1"
+
+static const qint64 c_blockSize = 8 * 1024 * 1024;
+// Smaller gaps are not worth a separate block, the moved data overlaps and goes to the journal
+static const qint64 c_minRangeCopy = 1024 * 1024;
+
+static void syncFile(QFile *file)
+{
+    file->flush();
+#ifdef Q_OS_UNIX
+    ::fsync(file->handle());
+#endif
+}
+
+
+ArchiveCompactor::ArchiveCompactor(const QString &fileName)
+    : m_file(fileName)
+    , m_planned(false)
+    , m_bytesToMove(0)
+    , m_newSize(0)
+    , m_move(0)
+    , m_moveDone(0)
+    , m_moved(0)
+#ifdef HAVE_COPY_FILE_RANGE
+    , m_copyRange(true)
+#else
+    , m_copyRange(false)
+#endif
+{
+}
+
+ArchiveCompactor::~ArchiveCompactor()
+{
+    if (m_file.isOpen()) {
+        m_file.close();
+    }
+}
+
+void ArchiveCompactor::removeRange(qint64 offset, qint64 end)
+{
+    if (end > offset) {
+        m_ranges.append(qMakePair(offset, end));
+        m_planned = false;
+    }
+}
+
+/* Everything behind a removed range is moved down to the write position */
+void ArchiveCompactor::plan() const
+{
+    if (m_planned) {
+        return;
+    }
+
+    QList<QPair<qint64, qint64> > ranges = m_ranges;
+    std::sort(ranges.begin(), ranges.end());
+
+    const qint64 size = m_file.size();
+    m_moves.clear();
+    m_bytesToMove = 0;
+    m_newSize = size;
+
+    if (!ranges.isEmpty()) {
+        qint64 to = ranges.first().first;
+        for (int i = 0; i < ranges.size(); ++i) {
+            Move move;
+            move.from = ranges.at(i).second;
+            move.to = to;
+            move.length = (i + 1 < ranges.size() ? ranges.at(i + 1).first : size) - move.from;
+            if (move.length > 0) {
+                m_moves.append(move);
+                m_bytesToMove += move.length;
+            }
+            to += qMax(Q_INT64_C(0), move.length);
+        }
+        m_newSize = to;
+    }
+
+    m_planned = true;
+}
+
+qint64 ArchiveCompactor::bytesToMove() const
+{
+    plan();
+    return m_bytesToMove;
+}
+
+qint64 ArchiveCompactor::removedBytes() const
+{
+    plan();
+    return m_file.size() - m_newSize;
+}
+
+bool ArchiveCompactor::open()
+{
+    plan();
+    if (!m_file.open(QIODevice::ReadWrite | QIODevice::Unbuffered)) {
+        return setError(m_file.errorString());
+    }
+    m_move = 0;
+    m_moveDone = 0;
+    m_moved = 0;
+    return true;
+}
+
+/*
+ * The journal always describes the block being moved, the blocks before it
+ * are on the disk. A block not overlapping its source is copied again by
+ * recover(), an overlapping one is written from the copy in the journal.
+ */
+bool ArchiveCompactor::step()
+{
+    if (atEnd()) {
+        return true;
+    }
+
+    const Move &move = m_moves.at(m_move);
+    qint64 length = qMin(c_blockSize, move.length - m_moveDone);
+    const qint64 gap = move.from - move.to;
+    if (gap < length && gap >= c_minRangeCopy) {
+        length = gap;
+    }
+    const qint64 from = move.from + m_moveDone;
+    const qint64 to = move.to + m_moveDone;
+
+    if (!sync()) {
+        return false;
+    }
+
+    qint64 copied;
+    if (gap < length) {
+        if (!readBlock(from, length)
+                || !writeJournal(QByteArray::fromRawData(m_buffer.constData(), length))
+                || !writeBlock(to, length)) {
+            return false;
+        }
+        copied = length;
+    } else {
+        if (!writeJournal(QByteArray())) {
+            return false;
+        }
+        copied = copyRange(from, to, length);
+    }
+    if (copied <= 0) {
+        return false;
+    }
+
+    m_moveDone += copied;
+    m_moved += copied;
+    if (m_moveDone == move.length) {
+        ++m_move;
+        m_moveDone = 0;
+    }
+    return true;
+}
+
+/* Data are always moved to a lower offset, blocks go from the beginning */
+qint64 ArchiveCompactor::copyRange(qint64 from, qint64 to, qint64 length)
+{
+#ifdef HAVE_COPY_FILE_RANGE
+    if (m_copyRange && from - to >= length) {
+        loff_t in = from;
+        loff_t out = to;
+        const ssize_t copied = ::copy_file_range(m_file.handle(), &in, m_file.handle(), &out, length, 0);
+        if (copied > 0) {
+            return copied;
+        }
+        if (copied < 0 && errno != ENOSYS && errno != EXDEV && errno != EINVAL && errno != EOPNOTSUPP) {
+            setError(QString::fromLocal8Bit(strerror(errno)));
+            return -1;
+        }
+        qDebug() << "ArchiveCompactor: copy_file_range() not usable, copying through a buffer";
+        m_copyRange = false;
+    }
+#endif
+
+    if (!readBlock(from, length) || !writeBlock(to, length)) {
+        return -1;
+    }
+    return length;
+}
+
+bool ArchiveCompactor::readBlock(qint64 from, qint64 length)
+{
+    if (m_buffer.size() < length) {
+        m_buffer.resize(length);
+    }
+    if (!m_file.seek(from) || m_file.read(m_buffer.data(), length) != length) {
+        return setError(m_file.error() != QFile::NoError ? m_file.errorString() : tr("Unexpected end of the archive."));
+    }
+    return true;
+}
+
+bool ArchiveCompactor::writeBlock(qint64 to, qint64 length)
+{
+    if (!m_file.seek(to) || m_file.write(m_buffer.constData(), length) != length) {
+        return setError(m_file.errorString());
+    }
+    return true;
+}
+
+/* The moved blocks have to be on the disk before the journal moves past them */
+bool ArchiveCompactor::sync()
+{
+    syncFile(&m_file);
+    if (m_file.error() != QFile::NoError) {
+        return setError(m_file.errorString());
+    }
+    return true;
+}
+
+/* Journal is written beside and renamed, a crash leaves the old or the new one */
+bool ArchiveCompactor::writeJournal(const QByteArray &data)
+{
+    const QString name = journalName(m_file.fileName());
+    QFile journal(name + QLatin1String(".Temp"));
+    if (!journal.open(QIODevice::WriteOnly | QIODevice::Truncate)) {
+        return setError(journal.errorString());
+    }
+
+    QDataStream out(&journal);
+    out << c_journalMagic << m_newSize << qint32(m_moves.size());
+    foreach (const Move &move, m_moves) {
+        out << move.from << move.to << move.length;
+    }
+    out << qint32(m_move) << m_moveDone << data;
+    syncFile(&journal);
+    const bool written = (out.status() == QDataStream::Ok && journal.error() == QFile::NoError);
+    journal.close();
+
+    if (!written) {
+        journal.remove();
+        return setError(tr("The compaction journal could not be written."));
+    }
+#ifdef Q_OS_UNIX
+    if (::rename(QFile::encodeName(journal.fileName()).constData(), QFile::encodeName(name).constData()) != 0) {
+        journal.remove();
+        return setError(QString::fromLocal8Bit(strerror(errno)));
+    }
+#else
+    QFile::remove(name);
+    if (!journal.rename(name)) {
+        journal.remove();
+        return setError(journal.errorString());
+    }
+#endif
+    return true;
+}
+
+bool ArchiveCompactor::atEnd() const
+{
+    return m_move >= m_moves.size();
+}
+
+qint64 ArchiveCompactor::movedBytes() const
+{
+    return m_moved;
+}
+
+bool ArchiveCompactor::finish()
+{
+    // Sources of the last block are behind the new end, they must not be copied again
+    if (!m_moves.isEmpty() && (!sync() || !writeJournal(QByteArray()))) {
+        m_file.close();
+        return false;
+    }
+
+    if (!m_file.resize(m_newSize)) {
+        setError(m_file.errorString());
+        m_file.close();
+        return false;
+    }
+#ifdef Q_OS_UNIX
+    ::fsync(m_file.handle());
+#endif
+    m_file.close();
+    m_buffer.clear();
+    QFile::remove(journalName(m_file.fileName()));
+    return true;
+}
+
+bool ArchiveCompactor::recover(const QString &fileName)
+{
+    const QString name = journalName(fileName);
+    // Not renamed, the journal before it is valid
+    QFile::remove(name + QLatin1String(".Temp"));
+
+    QFile journal(name);
+    if (!journal.exists()) {
+        return false;
+    }
+    if (!journal.open(QIODevice::ReadOnly)) {
+        qDebug() << "ArchiveCompactor: journal can not be read" << journal.errorString();
+        return false;
+    }
+
+    ArchiveCompactor compactor(fileName);
+    QDataStream in(&journal);
+    quint32 magic = 0;
+    qint32 count = -1;
+    in >> magic >> compactor.m_newSize >> count;
+    for (qint32 i = 0; i < count && in.status() == QDataStream::Ok; ++i) {
+        Move move;
+        in >> move.from >> move.to >> move.length;
+        compactor.m_moves.append(move);
+    }
+    qint32 current = -1;
+    QByteArray data;
+    in >> current >> compactor.m_moveDone >> data;
+    journal.close();
+
+    const bool valid = (in.status() == QDataStream::Ok && magic == c_journalMagic
+                        && current >= 0 && current <= count && compactor.m_moveDone >= 0
+                        && (current == count || compactor.m_moveDone + data.size() <= compactor.m_moves.at(current).length));
+    if (!valid) {
+        qDebug() << "ArchiveCompactor: invalid journal of" << fileName;
+        return false;
+    }
+
+    qDebug() << "ArchiveCompactor: finishing interrupted compaction of" << fileName;
+    compactor.m_planned = true;
+    compactor.m_move = current;
+    compactor.m_buffer = data;
+    if (!compactor.resume()) {
+        qDebug() << "ArchiveCompactor: recovery failed" << compactor.errorString();
+        return false;
+    }
+    return true;
+}
+
+bool ArchiveCompactor::resume()
+{
+    if (!m_file.open(QIODevice::ReadWrite | QIODevice::Unbuffered)) {
+        return setError(m_file.errorString());
+    }
+
+    // The overlapping block saved in the journal
+    if (!m_buffer.isEmpty()) {
+        const Move &move = m_moves.at(m_move);
+        if (!writeBlock(move.to + m_moveDone, m_buffer.size())) {
+            m_file.close();
+            return false;
+        }
+        m_moveDone += m_buffer.size();
+        if (m_moveDone == move.length) {
+            ++m_move;
+            m_moveDone = 0;
+        }
+    }
+
+    while (!atEnd()) {
+        if (!step()) {
+            m_file.close();
+            return false;
+        }
+    }
+    return finish();
+}
+
+QString ArchiveCompactor::journalName(const QString &fileName)
+{
+    return fileName + QLatin1String(".Compact");
+}
+
+QString ArchiveCompactor::errorString() const
+{
+    return m_errorString;
+}
+
+bool ArchiveCompactor::setError(const QString &message)
+{
+    qDebug() << "ArchiveCompactor:" << message;
+    m_errorString = message;
+    return false;
+}
@@ -0,0 +1,79 @@
+#ifndef ARCHIVECOMPACTOR_H
+#define ARCHIVECOMPACTOR_H
+
+#include <QCoreApplication>
+#include <QFile>
+#include <QList>
+#include <QPair>
+#include <QString>
+
+/*
+ * Removes byte ranges from a file in place. The data behind the first
+ * removed range is moved down in large sequential blocks and the file is
+ * truncated, so no temporary copy of the archive is needed.
+ * QLibArchive uses it to delete members of uncompressed tar archives.
+ *
+ * Before every block the move plan and the progress are saved to
+ * "<archive>.Compact", a block overlapping its own source is saved there
+ * too. recover() finishes a compaction interrupted by a crash.
+ */
+class ArchiveCompactor
+{
+    Q_DECLARE_TR_FUNCTIONS(ArchiveCompactor)
+public:
+    explicit ArchiveCompactor(const QString &fileName);
+    ~ArchiveCompactor();
+
+    // Range [offset, end) to be removed, ranges must not overlap
+    void removeRange(qint64 offset, qint64 end);
+
+    // Preflight, valid after the ranges are added
+    qint64 bytesToMove() const;
+    qint64 removedBytes() const;
+
+    bool open();
+    // Moves the next block, false on error
+    bool step();
+    bool atEnd() const;
+    qint64 movedBytes() const;
+    // Truncates the file, syncs it to the disk and removes the journal
+    bool finish();
+
+    // Finishes an interrupted compaction, true if it was needed
+    static bool recover(const QString &fileName);
+
+    QString errorString() const;
+
+private:
+    struct Move {
+        qint64 from;
+        qint64 to;
+        qint64 length;
+    };
+
+    static QString journalName(const QString &fileName);
+
+    void plan() const;
+    bool resume();
+    bool sync();
+    bool writeJournal(const QByteArray &data);
+    qint64 copyRange(qint64 from, qint64 to, qint64 length);
+    bool readBlock(qint64 from, qint64 length);
+    bool writeBlock(qint64 to, qint64 length);
+    bool setError(const QString &message);
+
+    QFile m_file;
+    QList<QPair<qint64, qint64> > m_ranges;
+    mutable QList<Move> m_moves;
+    mutable bool m_planned;
+    mutable qint64 m_bytesToMove;
+    mutable qint64 m_newSize;
+    int m_move;         // current move
+    qint64 m_moveDone;  // bytes of the current move
+    qint64 m_moved;
+    QByteArray m_buffer;
+    bool m_copyRange;   // copy_file_range() is usable
+    QString m_errorString;
+};
+
+#endif // ARCHIVECOMPACTOR_H
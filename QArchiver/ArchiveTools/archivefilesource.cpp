@@ -0,0 +1,246 @@
+#include "archivefilesource.h"
+
+#include <archive.h>
+
+#include <sys/types.h>
+#include <sys/stat.h>
+#include <errno.h>
+#include <stdio.h>
+
+#ifdef Q_OS_UNIX
+  #include <fcntl.h>
+  #include <sys/mman.h>
+#endif
+#ifdef Q_OS_LINUX
+  #include <sys/vfs.h>
+#endif
+
+#include <QDebug>
+
+static const qint64 c_minAutoBlockSize = 1024 * 1024;
+static const qint64 c_maxAutoBlockSize = 4 * 1024 * 1024;
+
+int ArchiveFileSource::s_blockSize = 0;
+bool ArchiveFileSource::s_memoryMap = true;
+
+#if ARCHIVE_VERSION_NUMBER >= 3000000
+static int source_open(struct archive *a, void *client_data)
+{
+    QString errorString;
+    if (!static_cast<ArchiveFileSource*>(client_data)->openFile(&errorString)) {
+        archive_set_error(a, EIO, "%s", errorString.toLocal8Bit().constData());
+        return ARCHIVE_FATAL;
+    }
+    return ARCHIVE_OK;
+}
+
+static ssize_t source_read(struct archive *a, void *client_data, const void **buff)
+{
+    const qint64 bytes = static_cast<ArchiveFileSource*>(client_data)->read(buff);
+    if (bytes < 0) {
+        archive_set_error(a, EIO, "Read error");
+        return ARCHIVE_FATAL;
+    }
+    return bytes;
+}
+
+static __LA_INT64_T source_skip(struct archive *, void *client_data, __LA_INT64_T request)
+{
+    return static_cast<ArchiveFileSource*>(client_data)->skip(request);
+}
+
+static __LA_INT64_T source_seek(struct archive *, void *client_data, __LA_INT64_T offset, int whence)
+{
+    const qint64 pos = static_cast<ArchiveFileSource*>(client_data)->seek(offset, whence);
+    return (pos < 0) ? ARCHIVE_FATAL : pos;
+}
+
+static int source_close(struct archive *, void *client_data)
+{
+    static_cast<ArchiveFileSource*>(client_data)->close();
+    return ARCHIVE_OK;
+}
+#endif
+
+ArchiveFileSource::ArchiveFileSource(const QString &fileName) :
+    m_file(fileName),
+    m_map(0),
+    m_mapSize(0),
+    m_pos(0),
+    m_blockSize(0)
+{
+}
+
+ArchiveFileSource::~ArchiveFileSource()
+{
+    close();
+}
+
+int ArchiveFileSource::open(struct archive *a)
+{
+#if ARCHIVE_VERSION_NUMBER >= 3000000
+    archive_read_set_open_callback(a, source_open);
+    archive_read_set_read_callback(a, source_read);
+    archive_read_set_skip_callback(a, source_skip);
+    archive_read_set_seek_callback(a, source_seek);
+    archive_read_set_close_callback(a, source_close);
+    archive_read_set_callback_data(a, this);
+    return archive_read_open1(a);
+#else
+    m_blockSize = s_blockSize ? s_blockSize : c_minAutoBlockSize;
+    return archive_read_open_filename(a, QFile::encodeName(m_file.fileName()), m_blockSize);
+#endif
+}
+
+qint64 ArchiveFileSource::blockSize() const
+{
+    return m_blockSize;
+}
+
+int ArchiveFileSource::blockSizeSetting()
+{
+    return s_blockSize;
+}
+
+void ArchiveFileSource::setBlockSizeSetting(int size)
+{
+    s_blockSize = qMax(0, size);
+}
+
+bool ArchiveFileSource::memoryMapEnabled()
+{
+    return s_memoryMap;
+}
+
+void ArchiveFileSource::setMemoryMapEnabled(bool enabled)
+{
+    s_memoryMap = enabled;
+}
+
+bool ArchiveFileSource::openFile(QString *errorString)
+{
+    if (!m_file.open(QIODevice::ReadOnly)) {
+        *errorString = m_file.errorString();
+        return false;
+    }
+
+    m_blockSize = s_blockSize ? s_blockSize : autoBlockSize();
+    m_pos = 0;
+
+    const qint64 size = m_file.size();
+    if (s_memoryMap && size > 0 && isLocalFile()) {
+        // na 32bit systémech se velký archiv nemusí vejít do adresního prostoru, pak se čte po blocích
+        m_map = m_file.map(0, size);
+        if (m_map) {
+            m_mapSize = size;
+#ifdef Q_OS_UNIX
+            posix_madvise(m_map, m_mapSize, POSIX_MADV_SEQUENTIAL);
+#endif
+            return true;
+        }
+    }
+
+    m_buffer.resize(m_blockSize);
+#ifdef Q_OS_LINUX
+    posix_fadvise(m_file.handle(), 0, 0, POSIX_FADV_SEQUENTIAL);
+#endif
+    return true;
+}
+
+qint64 ArchiveFileSource::read(const void **buff)
+{
+    if (m_map) {
+        const qint64 bytes = qMin(m_blockSize, m_mapSize - m_pos);
+        *buff = m_map + m_pos;
+        m_pos += bytes;
+        return bytes;
+    }
+
+    *buff = m_buffer.constData();
+    return m_file.read(m_buffer.data(), m_buffer.size());
+}
+
+qint64 ArchiveFileSource::skip(qint64 request)
+{
+    if (m_map) {
+        const qint64 bytes = qBound(Q_INT64_C(0), request, m_mapSize - m_pos);
+        m_pos += bytes;
+        return bytes;
+    }
+
+    const qint64 pos = m_file.pos();
+    const qint64 bytes = qMin(request, m_file.size() - pos);
+    if (bytes <= 0 || !m_file.seek(pos + bytes)) {
+        return 0;
+    }
+    return bytes;
+}
+
+qint64 ArchiveFileSource::seek(qint64 offset, int whence)
+{
+    const qint64 current = m_map ? m_pos : m_file.pos();
+    const qint64 size = m_map ? m_mapSize : m_file.size();
+
+    qint64 pos;
+    switch (whence) {
+    case SEEK_CUR:
+        pos = current + offset;
+        break;
+    case SEEK_END:
+        pos = size + offset;
+        break;
+    default:
+        pos = offset;
+        break;
+    }
+
+    if (pos < 0) {
+        return -1;
+    }
+    if (m_map) {
+        m_pos = qMin(pos, m_mapSize);
+        return m_pos;
+    }
+    return m_file.seek(pos) ? pos : -1;
+}
+
+void ArchiveFileSource::close()
+{
+    if (m_map) {
+        m_file.unmap(m_map);
+        m_map = 0;
+        m_mapSize = 0;
+    }
+    m_buffer.clear();
+    m_file.close();
+}
+
+qint64 ArchiveFileSource::autoBlockSize() const
+{
+#ifdef Q_OS_UNIX
+    struct stat st;
+    if (::fstat(m_file.handle(), &st) == 0) {
+        return qBound(c_minAutoBlockSize, qint64(st.st_blksize), c_maxAutoBlockSize);
+    }
+#endif
+    return c_minAutoBlockSize;
+}
+
+bool ArchiveFileSource::isLocalFile() const
+{
+#ifdef Q_OS_LINUX
+    // mapování souborů na síťových discích zdržuje, čtou se po velkých blocích
+    struct statfs fs;
+    if (::fstatfs(m_file.handle(), &fs) == 0) {
+        switch (quint32(fs.f_type)) {
+        case 0x6969:        // NFS
+        case 0x517B:        // SMB
+        case 0xFF534D42:    // CIFS
+        case 0xFE534D42:    // SMB2
+        case 0x65735546:    // FUSE (sshfs, ...)
+            return false;
+        }
+    }
+#endif
+    return true;
+}
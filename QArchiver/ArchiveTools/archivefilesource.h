@@ -0,0 +1,55 @@
+#ifndef ARCHIVEFILESOURCE_H
+#define ARCHIVEFILESOURCE_H
+
+#include <QByteArray>
+#include <QFile>
+#include <QString>
+
+struct archive;
+
+/*
+ * Input of the libarchive readers.
+ * Reads the archive file in large blocks (the size is taken from the settings
+ * or from st_blksize), local files can be memory mapped. The source supports
+ * seeking, so the seekable readers (zip, 7z) can jump directly to the entries.
+ *
+ * The source must outlive the reader it was opened for.
+ */
+class ArchiveFileSource
+{
+public:
+    explicit ArchiveFileSource(const QString &fileName);
+    ~ArchiveFileSource();
+
+    // archive_read_open1() result
+    int open(struct archive *a);
+    qint64 blockSize() const;
+
+    static int blockSizeSetting();
+    static void setBlockSizeSetting(int size); // 0 = automatic (st_blksize)
+    static bool memoryMapEnabled();
+    static void setMemoryMapEnabled(bool enabled);
+
+    // libarchive callbacks
+    bool openFile(QString *errorString);
+    qint64 read(const void **buff);
+    qint64 skip(qint64 request);
+    qint64 seek(qint64 offset, int whence);
+    void close();
+
+private:
+    qint64 autoBlockSize() const;
+    bool isLocalFile() const;
+
+    QFile m_file;
+    QByteArray m_buffer;
+    uchar *m_map;
+    qint64 m_mapSize;
+    qint64 m_pos; // jen pro m_map
+    qint64 m_blockSize;
+
+    static int s_blockSize;
+    static bool s_memoryMap;
+};
+
+#endif // ARCHIVEFILESOURCE_H
@@ -4,8 +4,11 @@
 #include <QDir>
 #include <QFileInfo>
 
+// one queued signal per batch, not per entry
+static const int c_entryBatchSize = 4096;
+
 ArchiveInterface::ArchiveInterface(QObject *parent) :
-    QObject(parent), m_waitForFinishedSignal(false)
+    QObject(parent), m_waitForFinishedSignal(false), m_listsOnOpen(false)
 {
     qDebug("Constructing %s object.", metaObject()->className());
     m_archive = NULL;
@@ -15,6 +18,12 @@ ArchiveInterface::~ArchiveInterface()
 {
 }
 
+QString ArchiveInterface::charsetInfo(const QString &description)
+{
+    return tr("Filename encoding is not in current locale codepage! QArchiver detected: %1. "
+              "If it is not valid encoding of archive, please select correct encoding from menu.").arg(description);
+}
+
 QString ArchiveInterface::filename() const
 {
     return m_archive->fileName();
@@ -52,14 +61,107 @@ bool ArchiveInterface::waitForFinishedSignal() const
     return m_waitForFinishedSignal;
 }
 
+bool ArchiveInterface::listsOnOpen() const
+{
+    return m_listsOnOpen;
+}
+
+QVariantMap ArchiveInterface::cacheData() const
+{
+    // default implementation
+    return QVariantMap();
+}
+
+void ArchiveInterface::setCacheData(const QVariantMap &data)
+{
+    // default implementation
+    Q_UNUSED(data)
+}
+
+QString ArchiveInterface::detectedCharset() const
+{
+    return m_detectedCharset;
+}
+
+QString ArchiveInterface::detectedCharsetDescription() const
+{
+    return m_detectedCharsetDescription;
+}
+
+void ArchiveInterface::setDetectedCharset(const QString &name, const QString &description)
+{
+    m_detectedCharset = name;
+    m_detectedCharsetDescription = description;
+}
+
+void ArchiveInterface::reportCharset(const QString &name, const QString &description)
+{
+    setDetectedCharset(name, description);
+    emit charset(name, description);
+    emit encodingInfo(charsetInfo(description));
+}
+
 bool ArchiveInterface::doKill()
 {
     // default implementation
     return false;
 }
 
+void ArchiveInterface::flushEntries()
+{
+    if (m_pendingEntries.isEmpty()) {
+        return;
+    }
+
+    // the batch is shared with the receivers, not copied
+    ArchiveEntryList batch;
+    batch.swap(m_pendingEntries);
+    m_pendingEntries.reserve(c_entryBatchSize);
+    emit entries(batch);
+}
+
+ProgressChannel *ArchiveInterface::progressChannel()
+{
+    return &m_progress;
+}
+
+void ArchiveInterface::setTotalProgress(int progress)
+{
+    m_progress.setTotalProgress(progress);
+}
+
+void ArchiveInterface::setCurrentFile(const QString &fileName)
+{
+    m_progress.setCurrentFile(fileName);
+}
+
+void ArchiveInterface::setCurrentFileProgress(int progress)
+{
+    m_progress.setCurrentFileProgress(progress);
+}
+
+void ArchiveInterface::addEntry(const ArchiveEntry &archiveEntry)
+{
+    m_pendingEntries.append(archiveEntry);
+    if (m_pendingEntries.size() >= c_entryBatchSize) {
+        flushEntries();
+    }
+}
+
+void ArchiveInterface::addEntries(const ArchiveEntryList &archiveEntries)
+{
+    flushEntries();
+    for (int i = 0; i < archiveEntries.size(); i += c_entryBatchSize) {
+        emit entries(archiveEntries.mid(i, c_entryBatchSize));
+    }
+}
+
 void ArchiveInterface::setWaitForFinishedSignal(bool value)
 {
     m_waitForFinishedSignal = value;
 }
 
+void ArchiveInterface::setListsOnOpen(bool value)
+{
+    m_listsOnOpen = value;
+}
@@ -2,6 +2,7 @@
 #define ARCHIVEINTERFACE_H
 
 #include "qarchive.h"
+#include "progresschannel.h"
 
 #include <QObject>
 #include <QString>
@@ -24,6 +25,8 @@ public:
     virtual ~ArchiveInterface();
 
     static QStringList supportedMimetypes(ArchiveOpenMode mode = ReadOnly);
+    /* encodingInfo() for filenames detected in another charset */
+    static QString charsetInfo(const QString &description);
 
     QString filename() const;
     QString password() const;
@@ -49,18 +52,28 @@ public:
     virtual bool deleteFiles(const QList<QVariant> & files) = 0;
 
     bool waitForFinishedSignal() const;
+    /* open() emits the entries too, list() is not needed after opening */
+    bool listsOnOpen() const;
+    /* Backend specific informations stored in the listing cache */
+    virtual QVariantMap cacheData() const;
+    virtual void setCacheData(const QVariantMap &data);
+    /* Charset of the filenames, empty if they are in the locale codepage */
+    QString detectedCharset() const;
+    QString detectedCharsetDescription() const;
+    void setDetectedCharset(const QString &name, const QString &description);
     virtual bool doKill();
+    /* Emit the entries waiting in the current batch */
+    void flushEntries();
+    /* Progress is sampled by the GUI, see ProgressChannel */
+    ProgressChannel *progressChannel();
     
 signals:
     void error(const QString &message, const QString &details = QString());
-    void entry(const ArchiveEntry &archiveEntry);
+    void entries(const ArchiveEntryList &batch);
     void entryRemoved(const QString &path);
-    void totalProgress(int progress);
     void encodingInfo(const QString &info);
     void finished(bool result);
     void userQuery(Query *query);
-    void currentFile(const QString &fileName);
-    void currentFileProgress(int progress);
     void testResult(const QString &line);
     void charset(const QString &name, const QString &description);
     
@@ -69,10 +82,23 @@ public slots:
 protected:
     /*  */
     void setWaitForFinishedSignal(bool value);
+    void setListsOnOpen(bool value);
+    /* Sets the detected charset and emits charset() and encodingInfo() */
+    void reportCharset(const QString &name, const QString &description);
+    void addEntry(const ArchiveEntry &archiveEntry);
+    void addEntries(const ArchiveEntryList &archiveEntries);
+    void setTotalProgress(int progress);
+    void setCurrentFile(const QString &fileName);
+    void setCurrentFileProgress(int progress);
     Archive *m_archive;
 
 private:
     bool m_waitForFinishedSignal;
+    bool m_listsOnOpen;
+    QString m_detectedCharset;
+    QString m_detectedCharsetDescription;
+    ArchiveEntryList m_pendingEntries;
+    ProgressChannel m_progress;
 };
 
 #endif // ARCHIVEINTERFACE_H
@@ -81,6 +81,9 @@ ParameterList Cli7zPlugin::parameterList() const
         p[FileExistsExpression] = QLatin1String( "already exists. Overwrite with" );
         p[WrongPasswordPatterns] = QStringList() << QLatin1String( "Wrong password" );
         p[AddArgs] = QStringList() << QLatin1String( "a" )  << QLatin1String( "$PasswordSwitch" ) << QLatin1String( "$Archive" ) << QLatin1String( "$Files" );
+        p[UpdateArgs] = QStringList() << QLatin1String( "u" )  << QLatin1String( "$PasswordSwitch" ) << QLatin1String( "$Archive" ) << QLatin1String( "$Files" );
+        // as "u", files not in the archive are skipped (r0)
+        p[FreshenArgs] = QStringList() << QLatin1String( "u" ) << QLatin1String( "-up1q1r0x1y2z1w2" ) << QLatin1String( "$PasswordSwitch" ) << QLatin1String( "$Archive" ) << QLatin1String( "$Files" );
         p[DeleteArgs] = QStringList() << QLatin1String( "d" ) << QLatin1String( "$PasswordSwitch" ) << QLatin1String( "$Archive" ) << QLatin1String( "$Files" );
         p[TestArgs] = QStringList() << QLatin1String("t")  << QLatin1String( "$PasswordSwitch" ) << QLatin1String( "$Archive" );
 
@@ -163,11 +166,11 @@ bool Cli7zPlugin::readListLine(const QString& line)
                     const QString entryFilename = QFileInfo(filename()).completeBaseName();
                     m_currentArchiveEntry[FileName] = entryFilename;
                     m_currentArchiveEntry[InternalID] = entryFilename;
-                    emit entry(m_currentArchiveEntry);
+                    addEntry(m_currentArchiveEntry);
                     m_uncompSize += m_currentArchiveEntry[Size].toLongLong();
                     m_archiveEntryCount++;
                     if (m_totalEntryCount > 0) {
-                        emit totalProgress(100 * m_archiveEntryCount / m_totalEntryCount);
+                        setTotalProgress(100 * m_archiveEntryCount / m_totalEntryCount);
                     }
                 }
             }
@@ -197,11 +200,11 @@ bool Cli7zPlugin::readListLine(const QString& line)
             m_currentArchiveEntry[ CRC ] = line.mid(6).trimmed();
             // GZip archive neobsahuje dalsi info => emit entry
             if (m_archiveType == ArchiveTypeGZip && m_currentArchiveEntry.contains(FileName)) {
-                emit entry(m_currentArchiveEntry);
+                addEntry(m_currentArchiveEntry);
                 m_uncompSize += m_currentArchiveEntry[Size].toLongLong();
                 m_archiveEntryCount++;
                 if (m_totalEntryCount > 0) {
-                    emit totalProgress(100 * m_archiveEntryCount / m_totalEntryCount);
+                    setTotalProgress(100 * m_archiveEntryCount / m_totalEntryCount);
                 }
             }
         } else if (line.startsWith(QLatin1String("Method = "))) {
@@ -211,22 +214,22 @@ bool Cli7zPlugin::readListLine(const QString& line)
             m_currentArchiveEntry[ IsPasswordProtected ] = (line.at(12) == QLatin1Char( '+' ));
         } else if (line.startsWith(QLatin1String("Block = "))) {
             if (m_currentArchiveEntry.contains(FileName)) {
-                emit entry(m_currentArchiveEntry);
+                addEntry(m_currentArchiveEntry);
                 m_uncompSize += m_currentArchiveEntry[Size].toLongLong();
                 m_archiveEntryCount++;
                 if (m_totalEntryCount > 0) {
-                    emit totalProgress(100 * m_archiveEntryCount / m_totalEntryCount);
+                    setTotalProgress(100 * m_archiveEntryCount / m_totalEntryCount);
                 }
             }
         } else if (line.startsWith(QLatin1String("Comment = "))) {
             m_currentArchiveEntry[ Comment ] = line.mid(10).trimmed();
             // Arj archive => emit entry
             if (m_archiveType == ArchiveTypeArj && m_currentArchiveEntry.contains(FileName)) {
-                emit entry(m_currentArchiveEntry);
+                addEntry(m_currentArchiveEntry);
                 m_uncompSize += m_currentArchiveEntry[Size].toLongLong();
                 m_archiveEntryCount++;
                 if (m_totalEntryCount > 0) {
-                    emit totalProgress(100 * m_archiveEntryCount / m_totalEntryCount);
+                    setTotalProgress(100 * m_archiveEntryCount / m_totalEntryCount);
                 }
             }
         }
@@ -258,11 +261,11 @@ bool Cli7zPlugin::readTestLine(const QString &line)
         if (pos > -1) {
             QString fileName = rxTestingFile.cap(2); // "filename.ext       "
             fileName = fileName.trimmed();  // mezery na zacatku/konci pryc
-            emit currentFile(fileName);
+            setCurrentFile(fileName);
             //qDebug() << fileName;
             m_archiveEntryCount++;
             if (m_totalEntryCount > 0) {
-                emit totalProgress(100 * m_archiveEntryCount / m_totalEntryCount);
+                setTotalProgress(100 * m_archiveEntryCount / m_totalEntryCount);
             }
 
             //QString ok = rxTestingFile.cap(3);  // "OK"
@@ -387,20 +390,20 @@ void Cli7zPlugin::handleLine(const QByteArray& lineBa)
 
         if (m_operationMode == Add) {
             if (line.startsWith("Updating archive")) {
-                emit currentFile(tr("Updating archive..."));
-                emit totalProgress(-1);
+                setCurrentFile(tr("Updating archive..."));
+                setTotalProgress(-1);
             }
             if (line.startsWith("Compressing ")) {
                 QString file_name = line.mid(12).trimmed();
                 //qDebug() << "Adding file:" << file_name;
-                emit currentFile(file_name);
+                setCurrentFile(file_name);
             }
 
             //read the percentage
             int pos = line.indexOf(QLatin1Char( '%' ));
             if (pos != -1 && pos > 1) {
                 int percentage = line.mid(pos - 2, 2).toInt();
-                emit totalProgress(percentage);
+                setTotalProgress(percentage);
                 return;
             }
         }
@@ -420,25 +423,25 @@ void Cli7zPlugin::handleLine(const QByteArray& lineBa)
             if (line.startsWith("Extracting ")) {
                 QString file_name = line.mid(11).trimmed();
                 //qDebug() << "Extractimg file:" << file_name;
-                emit currentFile(file_name);
+                setCurrentFile(file_name);
             }else if (line.startsWith("Skipping    ")) {
                 QString file_name = line.mid(11).trimmed();
-                emit currentFile(tr("Skipping: ") + file_name);
+                setCurrentFile(tr("Skipping: ") + file_name);
             }
 
             //read the percentage
             int pos = line.indexOf(QLatin1Char( '%' ));
             if (pos != -1 && pos > 1) {
                 int percentage = line.mid(pos - 2, 2).toInt();
-                emit totalProgress(percentage);
+                setTotalProgress(percentage);
                 return;
             }
         }
 
         if (m_operationMode == Delete) {
             if (line.startsWith("Updating archive")) {
-                emit currentFile(tr("Updating archive..."));
-                emit totalProgress(-1);
+                setCurrentFile(tr("Updating archive..."));
+                setTotalProgress(-1);
             }
         }
 
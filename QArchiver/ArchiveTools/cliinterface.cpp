@@ -236,8 +236,17 @@ bool CliInterface::addFiles(const QStringList & files, const CompressionOptions&
         QDir::setCurrent(globalWorkDir);
     }
 
+    // Update and freshen are other commands of the programs
+    const int addMode = options.value(QLatin1String( "AddMode" ), AddReplace).toInt();
+    const int argsParam = (addMode == AddNew) ? UpdateArgs : (addMode == AddExisting) ? FreshenArgs : AddArgs;
+    if (!m_param.contains(argsParam)) {
+        emit error(tr("Updating or freshening is not supported for this archive type."));
+        failOperation();
+        return false;
+    }
+
     //start preparing the argument list
-    QStringList args = m_param.value(AddArgs).toStringList();
+    QStringList args = m_param.value(argsParam).toStringList();
 
     //now replace the various elements in the list
     for (int i = 0; i < args.size(); ++i) {
@@ -515,6 +524,7 @@ void CliInterface::onProcessFinished(int exitCode, QProcess::ExitStatus exitStat
 
     // Handle all the remaining data in the process
     readStdout(true);
+    flushEntries();
 
     if (m_operationMode == Delete) {
         foreach(const QVariant& v, m_removedFiles) {
@@ -543,7 +553,7 @@ void CliInterface::onProcessFinished(int exitCode, QProcess::ExitStatus exitStat
     }
 
     // Set progress to 100%
-    emit totalProgress(100);
+    setTotalProgress(100);
 
     // Delete process object
     delete m_process;
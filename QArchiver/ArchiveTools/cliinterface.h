@@ -26,6 +26,8 @@ enum CliInterfaceParameters {
     WrongPasswordPatterns,
     AddProgram,
     AddArgs,
+    UpdateArgs,     // AddMode AddNew
+    FreshenArgs,    // AddMode AddExisting
     TestArgs,
     AutoOverwriteSwitch
 };
@@ -76,6 +76,8 @@ ParameterList CliRarPlugin::parameterList() const
                              ;
 
         p[AddArgs] = QStringList() << QLatin1String( "a" ) << QLatin1String( "$Archive" ) << QLatin1String( "$Files" );
+        p[UpdateArgs] = QStringList() << QLatin1String( "u" ) << QLatin1String( "$Archive" ) << QLatin1String( "$Files" );
+        p[FreshenArgs] = QStringList() << QLatin1String( "f" ) << QLatin1String( "$Archive" ) << QLatin1String( "$Files" );
 
         p[PasswordPromptPattern] = QLatin1String("Enter password \\(will not be echoed\\) for");
 
@@ -240,7 +242,7 @@ bool CliRarPlugin::readListLine(const QString &line)
         qDebug() << "CliRarPlugin::readListLine()\n" << "Added entry: " << e << "\n";
 
         if (m_emitEntries) {
-            emit entry(e);
+            addEntry(e);
         }
         m_uncompSize += e[Size].toLongLong();
         m_archiveEntryCount++;
@@ -273,7 +275,7 @@ bool CliRarPlugin::readTestLine(const QString &line)
             ++lineData;
         }
         fileName = fileName.trimmed();
-        emit currentFile(fileName);
+        setCurrentFile(fileName);
         //qDebug() << fileName << fileName.capacity() << line.size();
 
         QChar*const resultLine = new QChar[line.size()+1]();
@@ -428,7 +430,7 @@ void CliRarPlugin::handleLine(const QByteArray &lineBa)
                     ++lineData;
                 }
                 fileName = fileName.trimmed();
-                emit currentFile(fileName);
+                setCurrentFile(fileName);
                 //qDebug() << fileName;
             }
             else if (line.startsWith(QLatin1String("Adding    "))) {
@@ -442,7 +444,7 @@ void CliRarPlugin::handleLine(const QByteArray &lineBa)
                     ++lineData;
                 }
                 fileName = fileName.trimmed();
-                emit currentFile(fileName);
+                setCurrentFile(fileName);
                 qDebug() << fileName;
             }
 
@@ -450,7 +452,7 @@ void CliRarPlugin::handleLine(const QByteArray &lineBa)
             int pos = line.indexOf(QLatin1Char( '%' ));
             if (pos != -1 && pos > 1) {
                 int percentage = line.mid(pos - 2, 2).toInt();
-                emit totalProgress(percentage);
+                setTotalProgress(percentage);
                 return;
             }
         }
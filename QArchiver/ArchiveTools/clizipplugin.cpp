@@ -172,6 +172,10 @@ ParameterList CliZipPlugin::parameterList() const
 
         p[AddArgs] = QStringList() << QLatin1String( "-r" ) << QLatin1String( "$PasswordSwitch" )
                                    << QLatin1String( "$Archive" ) << QLatin1String( "$Files" );
+        p[UpdateArgs] = QStringList() << QLatin1String( "-r" ) << QLatin1String( "-u" ) << QLatin1String( "$PasswordSwitch" )
+                                      << QLatin1String( "$Archive" ) << QLatin1String( "$Files" );
+        p[FreshenArgs] = QStringList() << QLatin1String( "-r" ) << QLatin1String( "-f" ) << QLatin1String( "$PasswordSwitch" )
+                                       << QLatin1String( "$Archive" ) << QLatin1String( "$Files" );
 
         p[PasswordPromptPattern] = QLatin1String(" password: ");
         p[WrongPasswordPatterns] = QStringList() << QLatin1String( "incorrect password" );
@@ -264,13 +268,12 @@ bool CliZipPlugin::analyzeOutput()
         QByteArray system_charset(enca.systemCharset());
         if ( (archive_charset != "ASCII") && (archive_charset != system_charset) )
         {
-            //emit charset(enca.charsetName(ENCA_NAME_STYLE_ICONV), enca.charsetName(ENCA_NAME_STYLE_HUMAN));
-            emit encodingInfo(tr("Filename encoding is not in current locale codepage! QArchiver detected: %1."
-                                 "If it is not valid encoding of archive, please select correct encoding from menu.")
-                              .arg(QString::fromLocal8Bit(enca.charsetName(ENCA_NAME_STYLE_HUMAN))));
+            reportCharset(QString::fromLocal8Bit(enca.charsetName(ENCA_NAME_STYLE_ICONV)),
+                          QString::fromLocal8Bit(enca.charsetName(ENCA_NAME_STYLE_HUMAN)));
 
             m_archive->setCodePage(QString::fromLocal8Bit(enca.charsetName(ENCA_NAME_STYLE_ICONV)));
         } else {
+            setDetectedCharset(QString(), QString());
             m_archive->setCodePage("");
         }
         return true;
@@ -336,7 +339,7 @@ bool CliZipPlugin::readListLine(const QString &line)
             e[Timestamp] = ts;
 
             e[FileName] = e[InternalID] = entryPattern.cap(10);
-            emit entry(e);
+            addEntry(e);
             m_uncompSize += e[Size].toLongLong();
             m_archiveEntryCount++;
         }
@@ -366,7 +369,7 @@ bool CliZipPlugin::readTestLine(const QString &line)
         if (pos > -1) {
             QString fileName = rxTestingFile.cap(2); // "filename.ext       "
             fileName = fileName.trimmed();  // mezery na zacatku/konci pryc
-            emit currentFile(fileName);
+            setCurrentFile(fileName);
             qDebug() << fileName;
 
             QString ok = rxTestingFile.cap(3);  // "OK"
@@ -429,7 +432,7 @@ void CliZipPlugin::handleLine(const QByteArray& lineBa)
                 endPos = line.indexOf("(stored ");
             }
             QString fileName = line.mid(startPos, endPos - startPos).trimmed();
-            emit currentFile(fileName);
+            setCurrentFile(fileName);
             qDebug() << fileName;
         }
         else if (line.startsWith("updating:")) {
@@ -441,7 +444,7 @@ void CliZipPlugin::handleLine(const QByteArray& lineBa)
                 endPos = line.indexOf("(stored ");
             }
             QString fileName = line.mid(startPos, endPos - startPos).trimmed();
-            emit currentFile(fileName);
+            setCurrentFile(fileName);
             qDebug() << fileName;
         }
     }
@@ -457,11 +460,11 @@ void CliZipPlugin::handleLine(const QByteArray& lineBa)
             if (line.contains(badCRC)) {
                 int endPos = line.indexOf(badCRC);
                 fileName = line.mid(startPos, endPos - startPos).trimmed();
-                emit currentFile(fileName);
+                setCurrentFile(fileName);
                 emit error(tr("CRC error detected while extracting the file: %1").arg(fileName));
             } else {
                  fileName = line.mid(startPos).trimmed();
-                 emit currentFile(fileName);
+                 setCurrentFile(fileName);
             }
         }
         return;
@@ -0,0 +1,268 @@
+#include "filescanner.h"
+
+#include <QDebug>
+#include <QDir>
+#include <QDirIterator>
+#include <QFile>
+#include <QThread>
+
+#include <errno.h>
+#include <string.h>
+
+#ifndef Q_OS_WIN
+  #include <dirent.h>
+  #include <fcntl.h>
+  #include <unistd.h>
+#endif
+
+// Reading directories is bound by the disk, more threads do not help
+static const int c_maxWorkers = 8;
+
+class FileScanner::Worker : public QThread
+{
+public:
+    explicit Worker(FileScanner *scanner) : m_scanner(scanner) {}
+
+protected:
+    void run()
+    {
+        m_scanner->work();
+    }
+
+private:
+    FileScanner *m_scanner;
+};
+
+
+static FileScanner::Type fileType(mode_t mode)
+{
+    if (S_ISREG(mode)) {
+        return FileScanner::File;
+    }
+    if (S_ISDIR(mode)) {
+        return FileScanner::Directory;
+    }
+#ifndef Q_OS_WIN
+    if (S_ISLNK(mode)) {
+        return FileScanner::Symlink;
+    }
+#endif
+    return FileScanner::Other;
+}
+
+#ifndef Q_OS_WIN
+// Stejně jako QDir::Readable, access() jen pokud to nejde poznat z práv
+static bool isReadable(int dirFd, const char *name, const struct stat &st)
+{
+    if (S_ISLNK(st.st_mode)) {
+        return true;
+    }
+    if (st.st_uid == geteuid()) {
+        return (st.st_mode & S_IRUSR) || geteuid() == 0;
+    }
+    if ((st.st_mode & S_IRGRP) && (st.st_mode & S_IROTH)) {
+        return true;
+    }
+    return faccessat(dirFd, name, R_OK, AT_EACCESS) == 0;
+}
+#endif
+
+
+FileScanner::FileScanner()
+    : m_totalBytes(0)
+    , m_active(0)
+{
+}
+
+FileScanner::~FileScanner()
+{
+    qDeleteAll(m_listings);
+}
+
+bool FileScanner::scan(const QStringList &inputs)
+{
+    m_entries.clear();
+    m_totalBytes = 0;
+    qDeleteAll(m_listings);
+    m_listings.clear();
+    m_queue.clear();
+    m_active = 0;
+
+    // The inputs form the root listing
+    Listing *root = new Listing;
+    m_listings.append(root);
+
+    foreach (const QString &input, inputs) {
+        Entry entry;
+        entry.path = input;
+#ifdef Q_OS_WIN
+        const int r = stat(QFile::encodeName(input).constData(), &entry.st);
+#else
+        const int r = lstat(QFile::encodeName(input).constData(), &entry.st);
+#endif
+        if (r != 0) {
+            return setError(tr("Could not read the file %1: %2")
+                            .arg(input, QString::fromLocal8Bit(strerror(errno))));
+        }
+        entry.type = fileType(entry.st.st_mode);
+        root->entries.append(entry);
+        root->children.append(-1);
+
+        if (entry.type == Directory) {
+            Listing *listing = new Listing;
+            listing->path = input.endsWith(QLatin1Char('/')) ? input : input + QLatin1Char('/');
+            root->children.last() = m_listings.size();
+            m_queue.enqueue(m_listings.size());
+            m_listings.append(listing);
+        }
+    }
+
+    if (!m_queue.isEmpty()) {
+        QList<Worker*> workers;
+        const int workerCount = qBound(1, QThread::idealThreadCount(), c_maxWorkers);
+        for (int i = 0; i < workerCount; ++i) {
+            workers.append(new Worker(this));
+            workers.last()->start();
+        }
+        foreach (Worker *worker, workers) {
+            worker->wait();
+        }
+        qDeleteAll(workers);
+    }
+
+    flatten(0);
+    qDeleteAll(m_listings);
+    m_listings.clear();
+
+    qDebug() << "FileScanner:" << m_entries.count() << "files," << m_totalBytes << "bytes";
+    return true;
+}
+
+/* Worker loop, it ends when the queue is empty and no directory is being read */
+void FileScanner::work()
+{
+    QMutexLocker locker(&m_mutex);
+    for (;;) {
+        while (m_queue.isEmpty() && m_active > 0) {
+            m_wake.wait(&m_mutex);
+        }
+        if (m_queue.isEmpty()) {
+            m_wake.wakeAll();
+            return;
+        }
+
+        Listing *listing = m_listings.at(m_queue.dequeue());
+        ++m_active;
+        locker.unlock();
+
+        readDirectory(listing);
+
+        locker.relock();
+        for (int i = 0; i < listing->entries.size(); ++i) {
+            if (listing->entries.at(i).type == Directory) {
+                Listing *child = new Listing;
+                child->path = listing->entries.at(i).path;
+                listing->children[i] = m_listings.size();
+                m_queue.enqueue(m_listings.size());
+                m_listings.append(child);
+            }
+        }
+        --m_active;
+        m_wake.wakeAll();
+    }
+}
+
+void FileScanner::readDirectory(Listing *listing)
+{
+#ifdef Q_OS_WIN
+    QDirIterator it(listing->path, QDir::AllEntries | QDir::Readable | QDir::Hidden | QDir::NoDotAndDotDot);
+    while (it.hasNext()) {
+        Entry entry;
+        entry.path = it.next();
+        if (stat(QFile::encodeName(entry.path).constData(), &entry.st) != 0) {
+            continue;
+        }
+        entry.type = fileType(entry.st.st_mode);
+        if (entry.type == Other) {
+            continue;
+        }
+        if (entry.type == Directory) {
+            entry.path += QLatin1Char('/');
+        }
+        listing->entries.append(entry);
+    }
+#else
+    const int fd = ::open(QFile::encodeName(listing->path).constData(), O_RDONLY | O_DIRECTORY);
+    DIR *dir = (fd < 0) ? NULL : fdopendir(fd);
+    if (dir == NULL) {
+        qDebug() << "FileScanner: can not read" << listing->path << strerror(errno);
+        if (fd >= 0) {
+            ::close(fd);
+        }
+        return;
+    }
+
+    struct dirent *de;
+    while ((de = readdir(dir)) != NULL) {
+        if (strcmp(de->d_name, ".") == 0 || strcmp(de->d_name, "..") == 0) {
+            continue;
+        }
+
+        Entry entry;
+        if (fstatat(fd, de->d_name, &entry.st, AT_SYMLINK_NOFOLLOW) != 0 || !isReadable(fd, de->d_name, entry.st)) {
+            continue;
+        }
+        entry.type = fileType(entry.st.st_mode);
+        if (entry.type == Other) {
+            // FIFO, socket, device: open() would block or read the device
+            continue;
+        }
+        entry.path = listing->path + QFile::decodeName(de->d_name);
+        if (entry.type == Directory) {
+            entry.path += QLatin1Char('/');
+        }
+        listing->entries.append(entry);
+    }
+    closedir(dir);
+#endif
+
+    listing->children.fill(-1, listing->entries.size());
+}
+
+/* Each entry is followed by its subtree */
+void FileScanner::flatten(int index)
+{
+    const Listing *listing = m_listings.at(index);
+    for (int i = 0; i < listing->entries.size(); ++i) {
+        const Entry &entry = listing->entries.at(i);
+        m_entries.append(entry);
+        if (entry.type == File) {
+            m_totalBytes += entry.st.st_size;
+        }
+        if (listing->children.at(i) >= 0) {
+            flatten(listing->children.at(i));
+        }
+    }
+}
+
+const QList<FileScanner::Entry> &FileScanner::entries() const
+{
+    return m_entries;
+}
+
+qint64 FileScanner::totalBytes() const
+{
+    return m_totalBytes;
+}
+
+QString FileScanner::errorString() const
+{
+    return m_errorString;
+}
+
+bool FileScanner::setError(const QString &message)
+{
+    qDebug() << "FileScanner:" << message;
+    m_errorString = message;
+    return false;
+}
@@ -0,0 +1,83 @@
+#ifndef FILESCANNER_H
+#define FILESCANNER_H
+
+#include <QCoreApplication>
+#include <QList>
+#include <QMutex>
+#include <QQueue>
+#include <QString>
+#include <QStringList>
+#include <QVector>
+#include <QWaitCondition>
+
+#include <sys/types.h>
+#include <sys/stat.h>
+
+/*
+ * Walks the files selected for adding once and keeps the result.
+ * Subdirectories are read in parallel by worker threads, each directory
+ * is listed through its descriptor and its entries are stat'ed with
+ * fstatat(), so the paths are not resolved again for every file.
+ *
+ * entries() lists every input followed by its subtree, directories have
+ * a trailing '/' as QLibArchive writes them. Unreadable entries and
+ * special files (FIFO, socket, device) inside the directories are
+ * skipped, as QDirIterator without QDir::System did.
+ */
+class FileScanner
+{
+    Q_DECLARE_TR_FUNCTIONS(FileScanner)
+public:
+    enum Type {
+        File,
+        Directory,
+        Symlink,
+        Other
+    };
+
+    struct Entry {
+        QString path;
+        struct stat st; // lstat() of the path
+        Type type;
+    };
+
+    FileScanner();
+    ~FileScanner();
+
+    bool scan(const QStringList &inputs);
+
+    const QList<Entry> &entries() const;
+    // Size of all regular files
+    qint64 totalBytes() const;
+    QString errorString() const;
+
+private:
+    class Worker;
+
+    // Entries of one directory, children[i] is the listing of entries[i] or -1
+    struct Listing {
+        QString path;
+        QList<Entry> entries;
+        QVector<int> children;
+    };
+
+    void work();
+    void readDirectory(Listing *listing);
+    void flatten(int listing);
+    bool setError(const QString &message);
+
+    QList<Entry> m_entries;
+    qint64 m_totalBytes;
+    QString m_errorString;
+
+    // Shared by the workers
+    QMutex m_mutex;
+    QWaitCondition m_wake;
+    QVector<Listing*> m_listings;
+    QQueue<int> m_queue;
+    int m_active;
+};
+
+typedef QList<FileScanner::Entry> FileEntryList;
+
+#endif // FILESCANNER_H
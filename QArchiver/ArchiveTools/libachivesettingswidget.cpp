@@ -1,6 +1,7 @@
 #include "libachivesettingswidget.h"
 
 #include <QVBoxLayout>
+#include <QHBoxLayout>
 
 #include "qlibarchive.h"
 
@@ -17,11 +18,27 @@ LibAchiveSettingsWidget::LibAchiveSettingsWidget(QWidget *parent) :
     libArchiveLha = new QCheckBox(tr("Enable LHA format (read only)."),this);
     libArchiveLha->setEnabled(false);
 
+    blockSizeLabel = new QLabel(tr("Read block size:"), this);
+    blockSize = new QSpinBox(this);
+    blockSize->setRange(0, 64 * 1024);
+    blockSize->setSingleStep(256);
+    blockSize->setSuffix(tr(" KiB"));
+    blockSize->setSpecialValueText(tr("Automatic"));
+    blockSizeLabel->setBuddy(blockSize);
+    memoryMap = new QCheckBox(tr("Use memory mapped reading for local archives."), this);
+
+    QHBoxLayout *block_size_layout = new QHBoxLayout();
+    block_size_layout->addWidget(blockSizeLabel);
+    block_size_layout->addWidget(blockSize);
+    block_size_layout->addStretch();
+
     QVBoxLayout *vertical_layout = new QVBoxLayout(this);
     vertical_layout->addWidget(nameLabel);
     vertical_layout->addWidget(libArchiveZip);
     vertical_layout->addWidget(libArchiveRar);
     vertical_layout->addWidget(libArchiveLha);
+    vertical_layout->addLayout(block_size_layout);
+    vertical_layout->addWidget(memoryMap);
     QSpacerItem *verticalSpacer = new QSpacerItem(20, 40, QSizePolicy::Minimum, QSizePolicy::Expanding);
     vertical_layout->addSpacerItem(verticalSpacer);
 }
@@ -31,6 +48,8 @@ void LibAchiveSettingsWidget::apply()
     m_manager->setLaZipEnabled(libArchiveZip->isChecked());
     m_manager->setLaRarEnabled(libArchiveRar->isChecked());
     m_manager->setLaLhaEnabled(libArchiveLha->isChecked());
+    m_manager->setLaReadBlockSize(blockSize->value() * 1024);
+    m_manager->setLaMemoryMapEnabled(memoryMap->isChecked());
 }
 
 void LibAchiveSettingsWidget::reset()
@@ -38,6 +57,8 @@ void LibAchiveSettingsWidget::reset()
     libArchiveZip->setChecked(m_manager->laZipEnabled());
     libArchiveRar->setChecked(m_manager->laRarEnabled());
     libArchiveLha->setChecked(m_manager->laLhaEnabled());
+    blockSize->setValue(m_manager->laReadBlockSize() / 1024);
+    memoryMap->setChecked(m_manager->laMemoryMapEnabled());
 }
 
 void LibAchiveSettingsWidget::setToolManager(ArchiveToolManager *manager)
@@ -4,6 +4,7 @@
 #include <QWidget>
 #include <QLabel>
 #include <QCheckBox>
+#include <QSpinBox>
 #include <QSettings>
 
 #include "archivetoolmanager.h"
@@ -26,6 +27,9 @@ private:
     QCheckBox *libArchiveZip;
     QCheckBox *libArchiveRar;
     QCheckBox *libArchiveLha;
+    QLabel *blockSizeLabel;
+    QSpinBox *blockSize;
+    QCheckBox *memoryMap;
     ArchiveToolManager *m_manager;
 };
 
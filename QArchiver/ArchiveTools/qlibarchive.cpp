@@ -4,6 +4,7 @@
 #include <sys/stat.h> //lstat
 #include <unistd.h>
 #include <fcntl.h>
+#include <limits.h>
 
 #include <archive.h>
 #include <archive_entry.h>
@@ -11,12 +12,20 @@
 
 #include "qarchive.h"
 #include "queries.h"
+#include "archivefilesource.h"
+#include "selectionmatcher.h"
+#include "ziprewriter.h"
+#include "archivecompactor.h"
+#include "filescanner.h"
+#include "QSizeFormater.h"
 #include "Codecs/textencoder.h"
 #include "Codecs/qenca.h"
 
 #include <QDir>
-#include <QDirIterator>
 #include <QFile>
+#include <QMutex>
+#include <QSet>
+#include <QThread>
 #include <QDateTime>
 #include <QDebug>
 #include <QtMimeTypes/QMimeDatabase>
@@ -54,6 +63,34 @@ struct QLibArchive::ArchiveWriteCustomDeleter
     }
 };
 
+/*
+ * Zapíše blok dat položky na pozici offset. Zápis na disk zachová díry
+ * řídkých souborů, do archivu se díry doplní nulami.
+ */
+static bool writeDataBlock(struct archive *dest, const void *data, size_t size, qint64 offset, qint64 *position, bool toDisk)
+{
+    if (toDisk) {
+        if (archive_write_data_block(dest, data, size, offset) < ARCHIVE_OK) {
+            return false;
+        }
+    } else {
+        static const char zeros[10240] = {0};
+        while (*position < offset) {
+            const qint64 bytes = qMin<qint64>(offset - *position, sizeof(zeros));
+            if (archive_write_data(dest, zeros, bytes) < 0) {
+                return false;
+            }
+            *position += bytes;
+        }
+        if (archive_write_data(dest, data, size) < 0) {
+            return false;
+        }
+    }
+
+    *position = offset + size;
+    return true;
+}
+
 //const QString QLibArchive::c_mimeType[] =  {"application/zip", "application/x-java-archive",
 //                                            "application/x-tar", "application/x-compressed-tar",
 //                                            "application/x-bzip-compressed-tar", "application/x-xz-compressed-tar"};
@@ -79,6 +116,7 @@ QLibArchive::QLibArchive(const QString &mimeType, QObject *parent) :
 {
     m_archFilterName = QString();
     m_archFormatName = QString();
+    setListsOnOpen(true);
 
     if (mimeType.compare("application/x-rar") == 0)
     {
@@ -210,7 +248,7 @@ QLibArchive::QLibArchive(QObject *parent) :
     m_archFormat(0),
     m_archFilter(0)
 {
-    ;
+    setListsOnOpen(true);
 }
 
 QLibArchive::~QLibArchive()
@@ -289,6 +327,7 @@ void QLibArchive::setOptions(qint8 options)
 
 bool QLibArchive::analyze(Archive *archive)
 {
+    ArchiveFileSource input(archive->fileName());
     ArchiveRead arch_reader(archive_read_new());
 
     if (!(arch_reader.data())) {
@@ -318,7 +357,7 @@ bool QLibArchive::analyze(Archive *archive)
     */
 
     //if (archive_read_open_filename(arch_reader.data(), QFile::encodeName(filename()), 10240) != ARCHIVE_OK) {
-    if (archive_read_open_filename(arch_reader.data(), QFile::encodeName(archive->fileName()), 10240) != ARCHIVE_OK) {
+    if (input.open(arch_reader.data()) != ARCHIVE_OK) {
         //emit error(tr("<qt>Could not open the archive <i>%1</i>.</qt>", "@info").arg(filename()));
         emit error(tr("<qt>Could not open the archive <i>%1</i>.</qt>", "@info").arg( archive->fileName() ),
                    tr(archive_error_string( arch_reader.data() ), "@libArchiveError") );
@@ -327,7 +366,7 @@ bool QLibArchive::analyze(Archive *archive)
         return false;
     }
 
-    emit currentFileProgress(-2);
+    setCurrentFileProgress(-2);
 
     m_cachedArchiveEntryCount = 0;
     m_extractedFilesSize = 0;
@@ -341,6 +380,11 @@ bool QLibArchive::analyze(Archive *archive)
     int result;
     QByteArray ba;
 
+    // Položky se sbírají už při analýze, list() pak není potřeba volat.
+    // Názvy se emitují až po detekci kódování (případně se převedou).
+    QList<ArchiveEntry> entries;
+    QList<QByteArray> rawNames;
+
     //while ((result = archive_read_next_header(arch_reader.data(), &entry)) == ARCHIVE_OK) {
     while ((result = archive_read_next_header(arch_reader.data(), &entry)) < ARCHIVE_EOF) {
         if (result == ARCHIVE_FATAL) {
@@ -355,7 +399,7 @@ bool QLibArchive::analyze(Archive *archive)
             qDebug() << "QLibArchive:" << "Filenames in unknown encoding. Enca analyzer enabled.";
         }
         ba.append(pathname);
-        emit currentFile(tr("<qt>Analysing entry:<br/>%1</qt>").arg(QFile::decodeName(archive_entry_pathname(entry))));
+        setCurrentFile(QFile::decodeName(pathname));
 
         m_extractedFilesSize += (qlonglong)archive_entry_size(entry);
 
@@ -370,6 +414,10 @@ bool QLibArchive::analyze(Archive *archive)
             qDebug() << "Mode" << archive_entry_mode(entry) << "IsDir" << S_ISDIR(archive_entry_mode(entry)) << "IsFile:" << S_ISREG(archive_entry_mode(entry));
         }
 
+        if (!m_emitNoEntries) {
+            entries.append(entryFromArchiveEntry(entry));
+            rawNames.append(QByteArray(pathname));
+        }
 
         /* archive_format_name()
          *  -- vrací "ZIP 2.0 (deflation)", "ZIP 1.0 (uncompressed)"
@@ -394,7 +442,9 @@ bool QLibArchive::analyze(Archive *archive)
         //qDebug() << "ArchiveFileCount:" << m_archFilesCount << "m_cachedArchiveEntryCount:" << m_cachedArchiveEntryCount;
         archive_read_data_skip(arch_reader.data());
         compressedRead = archive_filter_bytes(arch_reader.data(), -1);
-        emit totalProgress(100 * compressedRead / archiveSize);
+        progressChannel()->setReadBytes(compressedRead);
+        progressChannel()->addProcessedEntries();
+        setTotalProgress(100 * compressedRead / archiveSize);
         archFormatPrev = m_archFormat;
     }
 
@@ -405,8 +455,11 @@ bool QLibArchive::analyze(Archive *archive)
     }
     m_archFilesCount = archive_file_count(arch_reader.data());
 
+    // Filter bytes are the archive stream (zip, tar), only the read progress uses them
+    qint64 compressed = archive_filter_bytes(arch_reader.data(), -1);
     archive->setEntryCount(m_archFilesCount);
     archive->setExtractedSize(m_extractedFilesSize);
+    archive->setCompressedSize(compressed);
 
     m_archFormat = archive_format(arch_reader.data());
 
@@ -422,7 +475,7 @@ bool QLibArchive::analyze(Archive *archive)
 
     analyze_encoding = true;
     if (analyze_encoding) {
-        emit currentFile(tr("Detecting charset..."));
+        setCurrentFile(tr("Detecting charset..."));
         QEnca enca;
         if (enca.analyse(ba)) {
             qDebug() << "Charset HUMAN:" << enca.charsetName(ENCA_NAME_STYLE_HUMAN);
@@ -436,13 +489,12 @@ bool QLibArchive::analyze(Archive *archive)
             QByteArray system_charset(enca.systemCharset());
             if ( (archive_charset != "ASCII") && (archive_charset != system_charset) )
             {
-                emit charset(enca.charsetName(ENCA_NAME_STYLE_ICONV), enca.charsetName(ENCA_NAME_STYLE_HUMAN));
-                emit encodingInfo(tr("Filename encoding is not in current locale codepage! QArchiver detected: %1. "
-                                     "If it is not valid encoding of archive, please select correct encoding from menu.")
-                                  .arg(QString::fromLocal8Bit(enca.charsetName(ENCA_NAME_STYLE_HUMAN))));
+                reportCharset(QString::fromLocal8Bit(enca.charsetName(ENCA_NAME_STYLE_ICONV)),
+                              QString::fromLocal8Bit(enca.charsetName(ENCA_NAME_STYLE_HUMAN)));
 
                 archive->setCodePage(QString::fromLocal8Bit(enca.charsetName(ENCA_NAME_STYLE_ICONV)));
             } else {
+                setDetectedCharset(QString(), QString());
                 archive->setCodePage("");
             }
         }else {
@@ -451,6 +503,19 @@ bool QLibArchive::analyze(Archive *archive)
         }
     }
 
+    // Názvy v jiné codepage převést stejně, jako by je převedl list() s "hdrcharset"
+    const QString codepage = archive->codePage();
+    if (!codepage.isEmpty()) {
+        for (int i = 0; i < entries.size(); ++i) {
+            const QString name = QDir::fromNativeSeparators(TextEncoder::decodeName(rawNames.at(i), codepage));
+            entries[i][FileName] = name;
+            entries[i][InternalID] = name;
+        }
+    }
+    rawNames.clear();
+
+    addEntries(entries);
+
     //qDebug() << "ArchiveFormatBase" << (m_archFormat & ARCHIVE_FORMAT_BASE_MASK) << ARCHIVE_FORMAT_TAR;
     return ok;
 }
@@ -532,6 +597,10 @@ bool QLibArchive::setFormatByFilename(const QString &file_name)
 
 bool QLibArchive::open()
 {
+    // Archiv zůstal po přerušeném přidávání nebo mazání souborů
+    ArchiveAppender::recover(m_archive->fileName());
+    ArchiveCompactor::recover(m_archive->fileName());
+
     if (m_archive->exists()) {
         return analyze(m_archive);
     } else {
@@ -539,12 +608,36 @@ bool QLibArchive::open()
     }
 }
 
+QVariantMap QLibArchive::cacheData() const
+{
+    QVariantMap data;
+    data[QLatin1String("Format")] = m_archFormat;
+    data[QLatin1String("FormatName")] = m_archFormatName;
+    data[QLatin1String("Filter")] = m_archFilter;
+    data[QLatin1String("FilterName")] = m_archFilterName;
+    data[QLatin1String("FilesCount")] = m_archFilesCount;
+    data[QLatin1String("EntryCount")] = m_cachedArchiveEntryCount;
+    return data;
+}
+
+void QLibArchive::setCacheData(const QVariantMap &data)
+{
+    // Archiv načten z cache, analyze() se neprovede
+    m_archFormat = data.value(QLatin1String("Format"), m_archFormat).toInt();
+    m_archFormatName = data.value(QLatin1String("FormatName")).toString();
+    m_archFilter = data.value(QLatin1String("Filter"), m_archFilter).toInt();
+    m_archFilterName = data.value(QLatin1String("FilterName")).toString();
+    m_archFilesCount = data.value(QLatin1String("FilesCount")).toInt();
+    m_cachedArchiveEntryCount = data.value(QLatin1String("EntryCount")).toInt();
+}
+
 bool QLibArchive::list()
 {
     qDebug() <<  "QLibArchive::list()";
     bool encoding_warn_emited = false;
     QString codepage = getArchive()->codePage();
 
+    ArchiveFileSource input(filename());
     ArchiveRead arch_reader(archive_read_new());
     if (!(arch_reader.data())) {
         return false;
@@ -579,7 +672,7 @@ bool QLibArchive::list()
         archive_read_set_option(arch_reader.data(),NULL, "read_concatenated_archives", "1");
     }
 
-    if (archive_read_open_filename(arch_reader.data(), QFile::encodeName(filename()), 10240) != ARCHIVE_OK) {
+    if (input.open(arch_reader.data()) != ARCHIVE_OK) {
         emit error(tr("<qt>Could not open the archive <i>%1</i>.</qt>", "@info").arg(filename()),
                    tr(archive_error_string( arch_reader.data() ), "@libArchiveError"));
         qDebug( archive_error_string(arch_reader.data()) );
@@ -590,7 +683,8 @@ bool QLibArchive::list()
     m_cachedArchiveEntryCount = 0;
     m_extractedFilesSize = 0;
     int totalCount = getArchive()->entryCount();
-    emit totalProgress(0);
+    progressChannel()->setTotalEntries(totalCount);
+    setTotalProgress(0);
 
     struct archive_entry *entry;
     int result;
@@ -624,7 +718,7 @@ bool QLibArchive::list()
                 //emit info(tr("Filename encoding is not in current locale codepage! Please select valid encoding from menu."));
             }
         }
-        emit currentFile(tr("<qt>%1</qt>").arg(QFile::decodeName(archive_entry_pathname(entry))));
+        setCurrentFile(QFile::decodeName(archive_entry_pathname(entry)));
 
         if (QString::fromLocal8Bit(pathname).endsWith('/') && (archive_entry_size(entry) == 0)) {
             archive_entry_set_filetype(entry, AE_IFDIR);
@@ -640,7 +734,9 @@ bool QLibArchive::list()
 
         m_cachedArchiveEntryCount++;
         archive_read_data_skip(arch_reader.data());
-        emit totalProgress(100 * m_cachedArchiveEntryCount / totalCount);
+        progressChannel()->setReadBytes(archive_filter_bytes(arch_reader.data(), -1));
+        progressChannel()->addProcessedEntries();
+        setTotalProgress(100 * m_cachedArchiveEntryCount / totalCount);
     }
 
     if (result != ARCHIVE_EOF) {
@@ -744,11 +840,27 @@ bool QLibArchive::copyFiles(const QVariantList &files, const QString &destinatio
     const bool extractAll = files.isEmpty();
     const bool preservePaths = options.value(QLatin1String( "PreservePaths" )).toBool();
 
+    // Zip: nejdřív paralelně, položky kolidující s existujícími soubory pak sekvenčně (dotaz na přepsání)
+    if (canExtractInParallel(extractAll ? m_cachedArchiveEntryCount : files.size(), options)) {
+        QVariantList deferredFiles;
+        if (!copyFilesParallel(files, options, &deferredFiles)) {
+            return false;
+        }
+        if (deferredFiles.isEmpty()) {
+            return true;
+        }
+        qDebug() << deferredFiles.size() << "entries already exist, extracting them sequentially";
+        ExtractionOptions sequentialOptions(options);
+        sequentialOptions[QLatin1String("Sequential")] = true;
+        return copyFiles(deferredFiles, destinationDirectory, sequentialOptions);
+    }
+
     QString rootNode = options.value(QLatin1String("RootNode"), QVariant()).toString();
     if ((!rootNode.isEmpty()) && (!rootNode.endsWith(QLatin1Char('/')))) {
         rootNode.append(QLatin1Char('/'));
     }
 
+    ArchiveFileSource input(filename());
     ArchiveRead arch_reader(archive_read_new());
 
     if (!(arch_reader.data())) {
@@ -779,12 +891,22 @@ bool QLibArchive::copyFiles(const QVariantList &files, const QString &destinatio
         }
     }
 
-    if (archive_read_open_filename(arch_reader.data(), QFile::encodeName(filename()), 10240) != ARCHIVE_OK) {
+    if (input.open(arch_reader.data()) != ARCHIVE_OK) {
         emit error(tr("Could not open the archive <i>%1</i>, libarchive can't handle it.", "@info").arg(filename()));
         qDebug( archive_error_string(arch_reader.data()) );
         return false;
     }
 
+    // Zip se čte přes centrální adresář, po nalezení všech vybraných položek není nutné číst dál
+    const bool stopWhenDone = !extractAll && (m_archFormat & ARCHIVE_FORMAT_BASE_MASK) == ARCHIVE_FORMAT_ZIP;
+    const SelectionMatcher selection(files);
+    QSet<QString> pendingFiles;
+    if (stopWhenDone) {
+        foreach (const QVariant &file, files) {
+            pendingFiles.insert(file.toString());
+        }
+    }
+
     ArchiveWrite writer(archive_write_disk_new());
     if (!(writer.data())) {
         return false;
@@ -797,7 +919,7 @@ bool QLibArchive::copyFiles(const QVariantList &files, const QString &destinatio
 
     if (extractAll) {
         if (!m_cachedArchiveEntryCount) {
-            emit totalProgress(0);
+            setTotalProgress(0);
             qDebug() << "For getting progress information, the archive will be listed once";
             m_emitNoEntries = true;
             list();
@@ -807,6 +929,9 @@ bool QLibArchive::copyFiles(const QVariantList &files, const QString &destinatio
     } else {
         totalCount = files.size();
     }
+    progressChannel()->reset();
+    progressChannel()->setTotalEntries(totalCount);
+    progressChannel()->setTotalBytes(extractAll ? m_extractedFilesSize : 0);
 
     m_currentExtractedFilesSize = 0;
 
@@ -817,8 +942,10 @@ bool QLibArchive::copyFiles(const QVariantList &files, const QString &destinatio
 
     QString fileBeingRenamed;
 
-    while (archive_read_next_header(arch_reader.data(), &entry) == ARCHIVE_OK) {
+    while (!(stopWhenDone && pendingFiles.isEmpty())
+           && archive_read_next_header(arch_reader.data(), &entry) == ARCHIVE_OK) {
         fileBeingRenamed.clear();
+        progressChannel()->setReadBytes(archive_filter_bytes(arch_reader.data(), -1));
 
         // retry with renamed entry, fire an overwrite query again
         // if the new entry also exists
@@ -865,7 +992,9 @@ bool QLibArchive::copyFiles(const QVariantList &files, const QString &destinatio
             return false;
         }
 
-        if (files.contains(entryName) || entryName == fileBeingRenamed || extractAll) {
+        if (extractAll || selection.matches(entryName) || entryName == fileBeingRenamed) {
+            pendingFiles.remove(entryName);
+
             // entryFI is the fileinfo pointing to where the file will be
             // written from the archive
             QFileInfo entryFI(entryName);
@@ -943,11 +1072,11 @@ bool QLibArchive::copyFiles(const QVariantList &files, const QString &destinatio
 
             int header_response;
             qDebug() << "Writing " << fileWithoutPath << " to " << archive_entry_pathname(entry);
-            emit currentFile(QFile::decodeName(archive_entry_pathname(entry)));
+            setCurrentFile(QFile::decodeName(archive_entry_pathname(entry)));
 
             if ((header_response = archive_write_header(writer.data(), entry)) == ARCHIVE_OK) {
                 //if the whole archive is extracted and the total filesize is available, we use partial progress
-                int data_response = copyData(arch_reader.data(), writer.data(), archive_entry_size(entry), (extractAll && m_extractedFilesSize));
+                int data_response = copyData(arch_reader.data(), writer.data(), archive_entry_size(entry), (extractAll && m_extractedFilesSize), true);
                 if (data_response != ARCHIVE_OK) {
                     qDebug() << "Copy data failed with response" << data_response << "==" << responseName(data_response);
                     return false;
@@ -966,8 +1095,9 @@ bool QLibArchive::copyFiles(const QVariantList &files, const QString &destinatio
             //number of items extracted
             if (!extractAll && m_cachedArchiveEntryCount) {
                 ++entryNr;
-                emit totalProgress(100 * entryNr / totalCount);
+                setTotalProgress(100 * entryNr / totalCount);
             }
+            progressChannel()->addProcessedEntries();
             archive_entry_clear(entry);
         } else {
             archive_read_data_skip(arch_reader.data());
@@ -980,38 +1110,432 @@ bool QLibArchive::copyFiles(const QVariantList &files, const QString &destinatio
     return reader_closed && writer_closed;
 }
 
-int QLibArchive::countFiles(const QStringList &files, QStringList *filesList)
+/*
+ * Parallel extraction of independently decodable entries (zip).
+ * Every worker has its own reader and disk writer and extracts a contiguous
+ * range of the archive index. Existing files are not touched, they are
+ * returned to copyFiles() which asks the user about them.
+ */
+static const int c_minEntriesPerWorker = 32;
+
+struct QLibArchive::ParallelExtractState
 {
-    int f_count = 0;
-    QStringList f_list;
+    ParallelExtractState() : stop(false), extractedEntries(0), extractedBytes(0) {}
+
+    QMutex mutex;
+    bool stop;
+    int extractedEntries;
+    qint64 extractedBytes;
+    QString currentFile;
+    QString errorString;
+};
 
-    foreach(const QString& selectedFile, files) {
-        f_count ++;
-        f_list.push_back(selectedFile);
+class QLibArchive::ExtractWorker : public QThread
+{
+public:
+    ExtractWorker(ParallelExtractState *state, const QString &fileName, int first, int last) :
+        m_state(state),
+        m_fileName(fileName),
+        m_first(first),
+        m_last(last),
+        m_flags(0),
+        m_overwrite(false),
+        m_selection(0)
+    {
+    }
 
-        if (QFileInfo(selectedFile).isDir()) {
-            QDirIterator it(selectedFile,
-                            QDir::AllEntries | QDir::Readable | QDir::Hidden | QDir::NoDotAndDotDot,
-                            QDirIterator::Subdirectories);
+    ParallelExtractState *m_state;
+    QString m_fileName;
+    QByteArray m_readerOptions;
+    int m_first;
+    int m_last;
+    int m_flags;
+    bool m_overwrite;
+    QString m_rootNode;
+    const SelectionMatcher *m_selection; // 0 = all
+    QVariantList m_deferredFiles;
 
-            while (it.hasNext()) {
-                const QString path = it.next();
+protected:
+    void run();
 
-                if ((it.fileName() == QLatin1String("..")) ||
-                    (it.fileName() == QLatin1String("."))) {
-                    continue;
-                }
+private:
+    bool stopped()
+    {
+        QMutexLocker locker(&m_state->mutex);
+        return m_state->stop;
+    }
+
+    void fail(const QString &message)
+    {
+        QMutexLocker locker(&m_state->mutex);
+        if (!m_state->stop) {
+            m_state->stop = true;
+            m_state->errorString = message;
+        }
+    }
+
+    int copyData(struct archive *source, struct archive *dest);
+};
+
+void QLibArchive::ExtractWorker::run()
+{
+    ArchiveFileSource input(m_fileName);
+    ArchiveRead reader(archive_read_new());
+    if (!reader.data()) {
+        fail(QString());
+        return;
+    }
+
+    archive_read_support_compression_all(reader.data());
+    archive_read_support_format_all(reader.data());
+    if (!m_readerOptions.isEmpty()) {
+        archive_read_set_options(reader.data(), m_readerOptions);
+    }
+
+    if (input.open(reader.data()) != ARCHIVE_OK) {
+        fail(QString::fromLocal8Bit(archive_error_string(reader.data())));
+        return;
+    }
+
+    ArchiveWrite writer(archive_write_disk_new());
+    if (!writer.data()) {
+        fail(QString());
+        return;
+    }
+    archive_write_disk_set_options(writer.data(), m_flags);
+
+    struct archive_entry *entry;
+    int index = -1;
+
+    while (!stopped() && archive_read_next_header(reader.data(), &entry) == ARCHIVE_OK) {
+        ++index;
+        if (index < m_first) {
+            continue;
+        }
+        if (index >= m_last) {
+            break;
+        }
+
+        const QString entryName = QDir::fromNativeSeparators(QFile::decodeName(archive_entry_pathname(entry)));
+        bool entryIsDir = S_ISDIR(archive_entry_mode(entry));
+        if (entryName.endsWith(QLatin1Char('/')) && !entryIsDir) {
+            entryIsDir = true;
+            archive_entry_set_filetype(entry, AE_IFDIR);
+        }
+
+        if (m_selection && !m_selection->matches(entryName)) {
+            continue;
+        }
+
+        if (entryName.startsWith(QLatin1Char('/'))) {
+            fail(QLibArchive::tr("This archive contains archive entries with absolute paths, which are not yet supported by QArchiver."));
+            break;
+        }
+
+        QString targetName = entryName;
+        if (!m_rootNode.isEmpty()) {
+            targetName.remove(0, m_rootNode.size());
+            archive_entry_copy_pathname(entry, QFile::encodeName(targetName).constData());
+        }
+
+        const QFileInfo targetFI(targetName);
+        if (targetFI.exists()) {
+            if (!entryIsDir && !m_overwrite) {
+                m_deferredFiles << entryName;
+                continue;
+            }
+            if (entryIsDir && !targetFI.isWritable()) {
+                qDebug() << "Warning, existing, but non-writable dir. skipping";
+                continue;
+            }
+        }
+
+        {
+            QMutexLocker locker(&m_state->mutex);
+            m_state->currentFile = targetName;
+        }
+
+        if (archive_write_header(writer.data(), entry) != ARCHIVE_OK) {
+            fail(QString::fromLocal8Bit(archive_error_string(writer.data())));
+            break;
+        }
+        if (copyData(reader.data(), writer.data()) != ARCHIVE_OK) {
+            break;
+        }
+
+        QMutexLocker locker(&m_state->mutex);
+        m_state->extractedEntries++;
+        m_state->extractedBytes += archive_entry_size(entry);
+    }
+
+    archive_read_close(reader.data());
+    if (archive_write_close(writer.data()) != ARCHIVE_OK) {
+        fail(QString::fromLocal8Bit(archive_error_string(writer.data())));
+    }
+}
+
+int QLibArchive::ExtractWorker::copyData(struct archive *source, struct archive *dest)
+{
+    const void *data;
+    size_t size;
+    __LA_INT64_T offset;
+    qint64 position = 0;
+    int response;
+
+    while ((response = archive_read_data_block(source, &data, &size, &offset)) == ARCHIVE_OK) {
+        if (!writeDataBlock(dest, data, size, offset, &position, true)) {
+            fail(QString::fromLocal8Bit(archive_error_string(dest)));
+            return ARCHIVE_FATAL;
+        }
+    }
+
+    if (response != ARCHIVE_EOF) {
+        fail(QString::fromLocal8Bit(archive_error_string(source)));
+        return response;
+    }
+    return ARCHIVE_OK;
+}
+
+bool QLibArchive::canExtractInParallel(int entryCount, const ExtractionOptions &options) const
+{
+    // Záznamy zip lze dekomprimovat nezávisle, 7z se solid bloky ne
+    if ((m_archFormat & ARCHIVE_FORMAT_BASE_MASK) != ARCHIVE_FORMAT_ZIP) {
+        return false;
+    }
+    // bez zachování cest mohou dva záznamy skončit ve stejném souboru
+    if (!options.value(QLatin1String("PreservePaths")).toBool()
+            || options.value(QLatin1String("Sequential")).toBool()) {
+        return false;
+    }
+    return QThread::idealThreadCount() > 1 && entryCount >= 2 * c_minEntriesPerWorker;
+}
+
+bool QLibArchive::copyFilesParallel(const QVariantList &files, const ExtractionOptions &options, QVariantList *deferredFiles)
+{
+    const bool extractAll = files.isEmpty();
+
+    if (!m_cachedArchiveEntryCount) {
+        setTotalProgress(0);
+        qDebug() << "For splitting the extraction, the archive will be listed once";
+        m_emitNoEntries = true;
+        list();
+        m_emitNoEntries = false;
+    }
+    const int archiveCount = m_cachedArchiveEntryCount;
+    const int totalCount = extractAll ? archiveCount : files.size();
+    const bool byteProgress = extractAll && m_extractedFilesSize;
 
-                f_list.push_back(path);
-                f_count++;
+    QString rootNode = options.value(QLatin1String("RootNode"), QVariant()).toString();
+    if ((!rootNode.isEmpty()) && (!rootNode.endsWith(QLatin1Char('/')))) {
+        rootNode.append(QLatin1Char('/'));
+    }
+
+    QByteArray readerOptions;
+    const QString codepage = getArchive()->codePage();
+    if (!codepage.isEmpty()) {
+        readerOptions = "hdrcharset=";
+        readerOptions += codepage.toLocal8Bit();
+    }
+
+    const SelectionMatcher selection(files);
+
+    const int workerCount = qMax(1, qMin(QThread::idealThreadCount(), totalCount / c_minEntriesPerWorker));
+    qDebug() << "Extracting" << totalCount << "entries with" << workerCount << "workers";
+
+    ParallelExtractState state;
+    QList<ExtractWorker*> workers;
+    for (int i = 0; i < workerCount; ++i) {
+        const int first = qint64(archiveCount) * i / workerCount;
+        const int last = (i == workerCount - 1) ? INT_MAX : int(qint64(archiveCount) * (i + 1) / workerCount);
+
+        ExtractWorker *worker = new ExtractWorker(&state, filename(), first, last);
+        worker->m_readerOptions = readerOptions;
+        worker->m_flags = extractionFlags();
+        worker->m_overwrite = options.value(QLatin1String("AutoOverwrite"), false).toBool();
+        worker->m_rootNode = rootNode;
+        worker->m_selection = extractAll ? 0 : &selection;
+        workers << worker;
+        worker->start();
+    }
+
+    progressChannel()->reset();
+    progressChannel()->setTotalEntries(totalCount);
+    progressChannel()->setTotalBytes(byteProgress ? m_extractedFilesSize : 0);
+
+    QString lastFile;
+    int lastEntries = 0;
+    qint64 lastBytes = 0;
+    forever {
+        ExtractWorker *running = 0;
+        foreach (ExtractWorker *worker, workers) {
+            if (!worker->isFinished()) {
+                running = worker;
+                break;
             }
-        } //END selectedFile.isDir()
+        }
+
+        QString fileName;
+        int extractedEntries;
+        qint64 extractedBytes;
+        {
+            QMutexLocker locker(&state.mutex);
+            fileName = state.currentFile;
+            extractedEntries = state.extractedEntries;
+            extractedBytes = state.extractedBytes;
+        }
+
+        if (fileName != lastFile) {
+            lastFile = fileName;
+            setCurrentFile(fileName);
+        }
+        progressChannel()->addProcessedEntries(extractedEntries - lastEntries);
+        progressChannel()->addProcessedBytes(extractedBytes - lastBytes);
+        lastEntries = extractedEntries;
+        lastBytes = extractedBytes;
+        if (byteProgress) {
+            setTotalProgress(100 * extractedBytes / m_extractedFilesSize);
+        } else if (totalCount) {
+            setTotalProgress(100 * extractedEntries / totalCount);
+        }
+
+        if (!running) {
+            break;
+        }
+        running->wait(100);
     }
 
-    filesList->clear();
-    filesList->append(f_list);
-    return f_count;
+    foreach (ExtractWorker *worker, workers) {
+        *deferredFiles << worker->m_deferredFiles;
+    }
+    qDeleteAll(workers);
 
+    if (state.stop) {
+        qDebug() << "Parallel extraction failed:" << state.errorString;
+        emit error(state.errorString.isEmpty() ? tr("Extraction failed.") : state.errorString);
+        return false;
+    }
+
+    return true;
+}
+
+/* files: manifest from FileScanner, directories are not walked again */
+bool QLibArchive::writeNewFiles(const FileEntryList &files, struct archive *arch_writer, int files_count, int *writen_count)
+{
+    foreach(const FileScanner::Entry &file, files) {
+        if (!fileToArchive(file, arch_writer)) {
+            return false;
+        }
+        (*writen_count)++;
+        progressChannel()->addProcessedEntries();
+        setTotalProgress(100 * *writen_count / files_count);
+    }
+
+    return true;
+}
+
+/* Names as written by fileToArchive(), directories without the trailing '/' */
+static QString stampKey(QString name)
+{
+    while (name.endsWith(QLatin1Char('/'))) {
+        name.chop(1);
+    }
+    if (name.startsWith(QLatin1String("./"))) {
+        name.remove(0, 2);
+    }
+    return name;
+}
+
+/* Header-only pass over the archive, the data of the entries is skipped */
+bool QLibArchive::readEntryStamps(QHash<QString, EntryStamp> *stamps)
+{
+    const QString codepage = getArchive()->codePage();
+
+    ArchiveFileSource input(filename());
+    ArchiveRead arch_reader(archive_read_new());
+    if (!(arch_reader.data())) {
+        emit error(tr("The archive reader could not be initialized."));
+        return false;
+    }
+
+    if (archive_read_support_compression_all(arch_reader.data()) != ARCHIVE_OK
+            || archive_read_support_format_all(arch_reader.data()) != ARCHIVE_OK) {
+        emit error(archive_error_string(arch_reader.data()));
+        qDebug("Error %i: %s", archive_errno(arch_reader.data()), archive_error_string(arch_reader.data()) );
+        return false;
+    }
+
+    if (!codepage.isEmpty()) {
+        QByteArray options("hdrcharset=");
+        options += codepage.toLocal8Bit();
+
+        if (archive_read_set_options(arch_reader.data(), options) != ARCHIVE_OK) {
+            emit error(tr("Libarchive can't convert character set."), archive_error_string(arch_reader.data()));
+            qDebug("Error %i: %s", archive_errno(arch_reader.data()), archive_error_string(arch_reader.data()) );
+            return false;
+        }
+    }
+
+    if (input.open(arch_reader.data()) != ARCHIVE_OK) {
+        emit error(tr("The source file could not be read."), archive_error_string(arch_reader.data()));
+        qDebug("Error %i: %s",archive_errno(arch_reader.data()), archive_error_string(arch_reader.data()) );
+        return false;
+    }
+
+    stamps->reserve(getArchive()->entryCount());
+
+    struct archive_entry *entry;
+    int r;
+    while ((r = archive_read_next_header(arch_reader.data(), &entry)) == ARCHIVE_OK) {
+        progressChannel()->setReadBytes(archive_filter_bytes(arch_reader.data(), -1));
+
+        EntryStamp stamp;
+        stamp.mtime = archive_entry_mtime(entry);
+        stamp.size = archive_entry_size(entry);
+        stamp.isDir = (archive_entry_filetype(entry) == AE_IFDIR);
+        stamps->insert(stampKey(QFile::decodeName(archive_entry_pathname(entry))), stamp);
+
+        archive_read_data_skip(arch_reader.data());
+    }
+    archive_read_close(arch_reader.data());
+
+    if (r != ARCHIVE_EOF) {
+        emit error(tr("The source file could not be read."), archive_error_string(arch_reader.data()));
+        return false;
+    }
+    return true;
+}
+
+/*
+ * AddNew: files missing in the archive or changed since they were archived.
+ * AddExisting: only changed files which are already in the archive.
+ */
+FileEntryList QLibArchive::changedFiles(const FileEntryList &files, const QHash<QString, EntryStamp> &stamps, int addMode)
+{
+    // Zip stores the DOS time with 2 s resolution
+    const qint64 tolerance = ((m_archFormat & ARCHIVE_FORMAT_BASE_MASK) == ARCHIVE_FORMAT_ZIP) ? 2 : 0;
+    FileEntryList changed;
+
+    foreach (const FileScanner::Entry &file, files) {
+        QHash<QString, EntryStamp>::const_iterator it = stamps.constFind(stampKey(m_workDir.relativeFilePath(file.path)));
+        if (it == stamps.constEnd()) {
+            if (addMode == AddNew) {
+                changed.append(file);
+            }
+            continue;
+        }
+
+        if (file.type == FileScanner::Directory && it->isDir) {
+            continue;
+        }
+
+        // Size of a symlink is the length of its target, archives store 0
+        const bool sizeChanged = (file.type != FileScanner::Symlink && file.st.st_size != it->size);
+        if (sizeChanged || qAbs(qint64(file.st.st_mtime) - it->mtime) > tolerance) {
+            changed.append(file);
+        }
+    }
+
+    return changed;
 }
 
 bool QLibArchive::addFiles(const QStringList &files, const CompressionOptions &options)
@@ -1029,8 +1553,65 @@ bool QLibArchive::addFiles(const QStringList &files, const CompressionOptions &o
     }
 
     m_writtenFiles.clear();
+    ArchiveAppender::recover(filename());
+    ArchiveCompactor::recover(filename());
+
+    // One walk of the selected trees, the manifest is used by all paths below
+    FileScanner scanner;
+    if (!scanner.scan(files)) {
+        emit error(tr("The files could not be added."), scanner.errorString());
+        return false;
+    }
+    FileEntryList f_list = scanner.entries();
+    qint64 newBytes = scanner.totalBytes();
+
+    // Update / freshen: unchanged files are not read at all
+    const int addMode = options.value(QLatin1String( "AddMode" ), AddReplace).toInt();
+    if (!creatingNewFile && addMode != AddReplace) {
+        QHash<QString, EntryStamp> stamps;
+        if (!readEntryStamps(&stamps)) {
+            return false;
+        }
+        const int selected = f_list.count();
+        f_list = changedFiles(f_list, stamps, addMode);
+        qDebug() << "QLibArchive: add mode" << addMode << "-" << f_list.count() << "of" << selected << "files changed";
+
+        if (f_list.isEmpty()) {
+            setTotalProgress(100);
+            return true;
+        }
+
+        newBytes = 0;
+        foreach (const FileScanner::Entry &file, f_list) {
+            if (file.type == FileScanner::File) {
+                newBytes += file.st.st_size;
+            }
+        }
+    }
+
+    // Uncompressed tar, cpio and ar: new members are written over the trailer
+    ArchiveAppender::Format appendFormat;
+    if (!creatingNewFile && canAppendInPlace(&appendFormat)) {
+        ArchiveAppender appender(filename(), appendFormat);
+        if (appender.scan() && !replacesEntries(f_list, appender.entryNames())) {
+            // Only the new files are written, their size is the whole work
+            progressChannel()->setTotalBytes(newBytes);
+            return addFilesInPlace(f_list, &appender);
+        }
+        qDebug() << "QLibArchive: in-place append not possible:" << appender.errorString();
+    }
+
+    // Unchanged zip entries are copied without recompression
+    if (!creatingNewFile && canRewriteZipRaw()) {
+        ZipRewriter rewriter;
+        if (rewriter.addSource(filename())) {
+            return addFilesZipRaw(f_list, &rewriter);
+        }
+        qDebug() << "QLibArchive: raw zip update not possible:" << rewriter.errorString();
+    }
 
     // If archive existing, create archive reader object
+    ArchiveFileSource input(filename());
     ArchiveRead arch_reader(NULL);
     if (!creatingNewFile) {
         arch_reader.reset(archive_read_new());
@@ -1065,7 +1646,7 @@ bool QLibArchive::addFiles(const QStringList &files, const CompressionOptions &o
         }
 
         // Open reader
-        if (archive_read_open_filename(arch_reader.data(), QFile::encodeName(filename()), 10240) != ARCHIVE_OK) {
+        if (input.open(arch_reader.data()) != ARCHIVE_OK) {
             emit error(tr("The source file could not be read."), archive_error_string(arch_reader.data()));
             qDebug("Error %i: %s",archive_errno(arch_reader.data()), archive_error_string(arch_reader.data()) );
             return false;
@@ -1194,54 +1775,20 @@ bool QLibArchive::addFiles(const QStringList &files, const CompressionOptions &o
     }
 
     // Write new files, copy files from old to new archive...
-    //int files_count = files.count();
-    QStringList f_list;
-    int files_count = countFiles(files, &f_list);
+    int files_count = f_list.count();
     int writen_count = 0;
     m_extractedFilesSize = 0;
-    emit totalProgress(100 * writen_count/files_count);
+    progressChannel()->setTotalEntries(files_count);
+    if (creatingNewFile) {
+        progressChannel()->setTotalBytes(newBytes);
+    }
+    setTotalProgress(100 * writen_count/files_count);
 
 
     // ********** Write the new files **********
-    foreach(const QString& selectedFile, files) {
-        bool success;
-
-        success = fileToArchive(selectedFile, arch_writer.data());
-
-        if (!success) {
-            QFile::remove(tempFilename);
-            return false;
-        }
-        writen_count++;
-        emit totalProgress(100 * writen_count / files_count);
-
-        if (QFileInfo(selectedFile).isDir()) {
-            QDirIterator it(selectedFile,
-                            QDir::AllEntries | QDir::Readable | QDir::Hidden | QDir::NoDotAndDotDot,
-                            QDirIterator::Subdirectories);
-
-            while (it.hasNext()) {
-                const QString path = it.next();
-
-                if ((it.fileName() == QLatin1String("..")) ||
-                    (it.fileName() == QLatin1String("."))) {
-                    continue;
-                }
-
-                //files_count++;
-                emit totalProgress(100* writen_count / files_count);
-
-                success = fileToArchive(path + (it.fileInfo().isDir() ? QLatin1String( "/" ) : QLatin1String( "" )),
-                                    arch_writer.data());
-
-                if (!success) {
-                    QFile::remove(tempFilename);
-                    return false;
-                }
-                writen_count++;
-                emit totalProgress(100 * writen_count / files_count);
-            }
-        } //END selectedFile.isDir()
+    if (!writeNewFiles(f_list, arch_writer.data(), files_count, &writen_count)) {
+        QFile::remove(tempFilename);
+        return false;
     }
 
 
@@ -1254,16 +1801,17 @@ bool QLibArchive::addFiles(const QStringList &files, const CompressionOptions &o
 
         while ((r = archive_read_next_header(arch_reader.data(), &entry)) == ARCHIVE_OK) {
             files_count++;
-            emit totalProgress(100 * writen_count / files_count);
-            emit currentFile(QString::fromLocal8Bit(archive_entry_pathname(entry)));
+            progressChannel()->setReadBytes(archive_filter_bytes(arch_reader.data(), -1));
+            setTotalProgress(100 * writen_count / files_count);
+            setCurrentFile(QString::fromLocal8Bit(archive_entry_pathname(entry)));
 
             if (m_writtenFiles.contains(QFile::decodeName(archive_entry_pathname(entry)))) {
                 // Nahrad položku nově přidávaným souborem
-                emit currentFileProgress(0);
+                setCurrentFileProgress(0);
                 archive_read_data_skip(arch_reader.data());
                 qDebug() << "Existing entry, will be refresh: =>" << archive_entry_pathname(entry);
                 files_count--;
-                emit currentFileProgress(100);
+                setCurrentFileProgress(100);
                 continue;
             }
 
@@ -1309,7 +1857,9 @@ bool QLibArchive::addFiles(const QStringList &files, const CompressionOptions &o
                 return false;
             }
             writen_count++;
-            emit totalProgress(100 * writen_count / files_count);
+            progressChannel()->setTotalEntries(files_count);
+            progressChannel()->addProcessedEntries();
+            setTotalProgress(100 * writen_count / files_count);
 
             // Clear entry for reuse
             archive_entry_clear(entry);
@@ -1320,7 +1870,7 @@ bool QLibArchive::addFiles(const QStringList &files, const CompressionOptions &o
         archive_read_close(arch_reader.data());
         arch_reader.reset(NULL);
     }
-    emit totalProgress(100 * writen_count / files_count);
+    setTotalProgress(100 * writen_count / files_count);
 
     // Close Writer
     archive_write_close(arch_writer.data());
@@ -1350,8 +1900,32 @@ bool QLibArchive::deleteFiles(const QVariantList &files)
     Archive* arch_info = getArchive();
     const QString tempFilename = arch_info->fileName() + QLatin1String( ".Temp" );
     const QString codepage = arch_info->codePage();
+    const SelectionMatcher selection(files);
+
+    ArchiveAppender::recover(filename());
+    ArchiveCompactor::recover(filename());
+
+    // Remaining zip entries are copied without recompression
+    if (canRewriteZipRaw()) {
+        ZipRewriter rewriter;
+        if (rewriter.addSource(filename())) {
+            return deleteFilesZipRaw(selection, &rewriter);
+        }
+        qDebug() << "QLibArchive: raw zip delete not possible:" << rewriter.errorString();
+    }
+
+    // Uncompressed tar: the remaining members are moved down in place
+    ArchiveAppender::Format format;
+    if (canAppendInPlace(&format) && format == ArchiveAppender::Tar) {
+        ArchiveAppender scanner(filename(), format);
+        if (scanner.scan()) {
+            return deleteFilesInPlace(selection, scanner.members());
+        }
+        qDebug() << "QLibArchive: in-place delete not possible:" << scanner.errorString();
+    }
 
     // Create Reader
+    ArchiveFileSource input(filename());
     ArchiveRead arch_reader(archive_read_new());
     if (!(arch_reader.data())) {
         emit error(tr("The archive reader could not be initialized."));
@@ -1384,7 +1958,7 @@ bool QLibArchive::deleteFiles(const QVariantList &files)
     }
 
     // Open Reader
-    if (archive_read_open_filename(arch_reader.data(), QFile::encodeName(filename()), 10240) != ARCHIVE_OK) {
+    if (input.open(arch_reader.data()) != ARCHIVE_OK) {
         emit error(tr("The source file could not be read."), archive_error_string(arch_reader.data()));
         qDebug("Error %i: %s",archive_errno(arch_reader.data()), archive_error_string(arch_reader.data()) );
         return false;
@@ -1513,12 +2087,14 @@ bool QLibArchive::deleteFiles(const QVariantList &files)
     int writen_count = 0;
     int deleted_count = 0;
     m_extractedFilesSize = 0;
-    emit totalProgress(0);
+    progressChannel()->setTotalEntries(files_count);
+    setTotalProgress(0);
 
     struct archive_entry *entry;
 
     /* Copy old elements from previous archive to new archive. */
     while (archive_read_next_header(arch_reader.data(), &entry) == ARCHIVE_OK) {
+        progressChannel()->setReadBytes(archive_filter_bytes(arch_reader.data(), -1));
 
         const char* pathname = archive_entry_pathname(entry);
         const wchar_t* pathname_w = archive_entry_pathname_w(entry);
@@ -1543,19 +2119,20 @@ bool QLibArchive::deleteFiles(const QVariantList &files)
             return false;
         }
 
-        if (files.contains(QFile::decodeName(archive_entry_pathname(entry)))) {
-            emit currentFile(tr("Delleting: %1").arg(QFile::decodeName(archive_entry_pathname(entry))));
+        if (selection.matches(QFile::decodeName(archive_entry_pathname(entry)))) {
+            setCurrentFile(tr("Delleting: %1").arg(QFile::decodeName(archive_entry_pathname(entry))));
             qDebug() << "Entry to be deleted, skipping" << archive_entry_pathname(entry);
             archive_read_data_skip(arch_reader.data());
             writen_count++;
             deleted_count++;
-            emit totalProgress(100 * writen_count / files_count);
+            progressChannel()->addProcessedEntries();
+            setTotalProgress(100 * writen_count / files_count);
             emit entryRemoved(QFile::decodeName(archive_entry_pathname(entry)));
             continue;
         }
 
         int header_response;
-        emit currentFile(QFile::decodeName(archive_entry_pathname(entry)));
+        setCurrentFile(QFile::decodeName(archive_entry_pathname(entry)));
         qDebug() << "Writing entry " << archive_entry_pathname(entry);
         if ((header_response = archive_write_header(arch_writer.data(), entry)) == ARCHIVE_OK) {
             // Count writen bytes
@@ -1569,7 +2146,8 @@ bool QLibArchive::deleteFiles(const QVariantList &files)
                 return false;
             }
             writen_count++;
-            emit totalProgress(100 * writen_count / files_count);
+            progressChannel()->addProcessedEntries();
+            setTotalProgress(100 * writen_count / files_count);
         } else {
             qDebug() << "Writing header failed with error code" << header_response << "==" << responseName(header_response);
             return false;
@@ -1596,10 +2174,394 @@ bool QLibArchive::deleteFiles(const QVariantList &files)
 }
 
 
+bool QLibArchive::canAppendInPlace(ArchiveAppender::Format *format) const
+{
+    if (m_archFilter != ARCHIVE_COMPRESSION_NONE || !getArchive()->codePage().isEmpty()) {
+        return false;
+    }
+
+    switch (m_archFormat) {
+    case ARCHIVE_FORMAT_TAR:
+    case ARCHIVE_FORMAT_TAR_USTAR:
+    case ARCHIVE_FORMAT_TAR_PAX_INTERCHANGE:
+    case ARCHIVE_FORMAT_TAR_PAX_RESTRICTED:
+    case ARCHIVE_FORMAT_TAR_GNUTAR:
+        *format = ArchiveAppender::Tar;
+        return true;
+    case ARCHIVE_FORMAT_CPIO_SVR4_NOCRC:
+        *format = ArchiveAppender::CpioNewc;
+        return true;
+    case ARCHIVE_FORMAT_CPIO_POSIX:
+        *format = ArchiveAppender::CpioOdc;
+        return true;
+    case ARCHIVE_FORMAT_AR_BSD:
+        *format = ArchiveAppender::ArBsd;
+        return true;
+    default:
+        // binary cpio, GNU ar (table of long names at the beginning)
+        return false;
+    }
+}
+
+/* New files with the same name as an existing entry have to replace it */
+bool QLibArchive::replacesEntries(const FileEntryList &files, const QSet<QString> &entryNames)
+{
+    foreach (const FileScanner::Entry &file, files) {
+        QString name = m_workDir.relativeFilePath(file.path);
+        while (name.endsWith(QLatin1Char('/'))) {
+            name.chop(1);
+        }
+        if (entryNames.contains(name)) {
+            return true;
+        }
+    }
+    return false;
+}
+
+/*
+ * The new members are written by libarchive from the end of the last
+ * member, the writer closes the archive with a new trailer.
+ */
+bool QLibArchive::addFilesInPlace(const FileEntryList &files, ArchiveAppender *appender)
+{
+    ArchiveWrite arch_writer(archive_write_new());
+    if (!(arch_writer.data())) {
+        emit error(tr("The archive writer could not be initialized."));
+        return false;
+    }
+
+    int ret;
+    switch (m_archFormat) {
+    case ARCHIVE_FORMAT_TAR_USTAR:
+        ret = archive_write_set_format_ustar(arch_writer.data());
+        break;
+    case ARCHIVE_FORMAT_TAR_PAX_INTERCHANGE:
+        ret = archive_write_set_format_pax(arch_writer.data());
+        break;
+    case ARCHIVE_FORMAT_TAR_GNUTAR:
+        ret = archive_write_set_format_gnutar(arch_writer.data());
+        break;
+    case ARCHIVE_FORMAT_CPIO_SVR4_NOCRC:
+        ret = archive_write_set_format_cpio_newc(arch_writer.data());
+        break;
+    case ARCHIVE_FORMAT_CPIO_POSIX:
+        ret = archive_write_set_format_cpio(arch_writer.data());
+        break;
+    case ARCHIVE_FORMAT_AR_BSD:
+        ret = archive_write_set_format_ar_bsd(arch_writer.data());
+        if (ret == ARCHIVE_OK) {
+            // ar nemá trailer, výstup nesmí být doplněn nulami
+            ret = archive_write_set_bytes_in_last_block(arch_writer.data(), 1);
+        }
+        break;
+    default:
+        ret = archive_write_set_format_pax_restricted(arch_writer.data());
+        break;
+    }
+    if (ret == ARCHIVE_OK) {
+        ret = archive_write_set_compression_none(arch_writer.data());
+    }
+    if (ret != ARCHIVE_OK) {
+        emit error(QString::fromLocal8Bit(archive_error_string(arch_writer.data())));
+        qDebug("Error %i: %s", archive_errno(arch_writer.data()), archive_error_string(arch_writer.data()) );
+        return false;
+    }
+
+    if (!appender->begin()) {
+        emit error(tr("The archive could not be updated."), appender->errorString());
+        return false;
+    }
+    if (appender->open(arch_writer.data()) != ARCHIVE_OK) {
+        emit error(tr("Opening the archive for writing failed with the following error: <message>%1</message>","@info")
+                   .arg(QLatin1String(archive_error_string(arch_writer.data()))));
+        appender->rollback();
+        return false;
+    }
+
+    const int files_count = files.count();
+    int writen_count = 0;
+    m_extractedFilesSize = 0;
+    progressChannel()->setTotalEntries(files_count);
+    setTotalProgress(0);
+
+    bool success = writeNewFiles(files, arch_writer.data(), files_count, &writen_count);
+    if (archive_write_close(arch_writer.data()) != ARCHIVE_OK && success) {
+        emit error(QString::fromLocal8Bit(archive_error_string(arch_writer.data())));
+        success = false;
+    }
+    arch_writer.reset(NULL);
+
+    if (!success) {
+        appender->rollback();
+        return false;
+    }
+    if (!appender->commit()) {
+        emit error(tr("The archive could not be updated."), appender->errorString());
+        return false;
+    }
+
+    Archive* arch_info = getArchive();
+    arch_info->setEntryCount(arch_info->entryCount() + writen_count);
+    arch_info->setExtractedSize(arch_info->extractedSize() + m_extractedFilesSize);
+    arch_info->setCompressedSize(QFileInfo(filename()).size());
+
+    return true;
+}
+
+bool QLibArchive::canRewriteZipRaw() const
+{
+    return (m_archFormat & ARCHIVE_FORMAT_BASE_MASK) == ARCHIVE_FORMAT_ZIP
+            && m_archFilter == ARCHIVE_COMPRESSION_NONE;
+}
+
+/*
+ * New files are compressed into "<name>.New", then the entries of the old
+ * archive that are not replaced and all the new entries are copied raw
+ * into "<name>.Temp" which replaces the archive.
+ */
+bool QLibArchive::addFilesZipRaw(const FileEntryList &files, ZipRewriter *rewriter)
+{
+    const QString partFilename = filename() + QLatin1String( ".New" );
+    const QString tempFilename = filename() + QLatin1String( ".Temp" );
+    const QString codepage = getArchive()->codePage();
+
+    ArchiveWrite arch_writer(archive_write_new());
+    if (!(arch_writer.data())) {
+        emit error(tr("The archive writer could not be initialized."));
+        return false;
+    }
+
+    if (archive_write_set_format_zip(arch_writer.data()) != ARCHIVE_OK
+            || archive_write_set_compression_none(arch_writer.data()) != ARCHIVE_OK) {
+        emit error(QString::fromLocal8Bit(archive_error_string(arch_writer.data())));
+        qDebug("Error %i: %s", archive_errno(arch_writer.data()), archive_error_string(arch_writer.data()) );
+        return false;
+    }
+
+    if (!codepage.isEmpty()) {
+        QByteArray options("hdrcharset=");
+        options += codepage.toLocal8Bit();
+
+        if (archive_write_set_options(arch_writer.data(), options) != ARCHIVE_OK) {
+            emit error(tr("Libarchive can't convert character set."), archive_error_string(arch_writer.data()));
+            qDebug("Error %i: %s", archive_errno(arch_writer.data()), archive_error_string(arch_writer.data()) );
+            return false;
+        }
+    }
+
+    if (archive_write_open_filename(arch_writer.data(), QFile::encodeName(partFilename)) != ARCHIVE_OK) {
+        emit error(tr("Opening the archive for writing failed with the following error: <message>%1</message>","@info")
+                   .arg(QLatin1String(archive_error_string(arch_writer.data()))));
+        return false;
+    }
+
+    const int old_count = rewriter->entries().count();
+    int files_count = files.count() + old_count;
+    int writen_count = 0;
+    m_extractedFilesSize = 0;
+    progressChannel()->setTotalEntries(files_count);
+    setTotalProgress(0);
+
+    // ********** Write the new files **********
+    bool success = writeNewFiles(files, arch_writer.data(), files_count, &writen_count);
+    archive_write_close(arch_writer.data());
+    arch_writer.reset(NULL);
+
+    if (!success || !rewriter->addSource(partFilename)) {
+        if (success) {
+            emit error(tr("The archive could not be updated."), rewriter->errorString());
+        }
+        QFile::remove(partFilename);
+        return false;
+    }
+
+    // ********** Copy the entries **********
+    if (!rewriter->open(tempFilename)) {
+        emit error(tr("The archive could not be updated."), rewriter->errorString());
+        QFile::remove(partFilename);
+        return false;
+    }
+
+    const QSet<QString> &replaced = m_writtenFiles;
+    const QList<ZipRewriter::Entry> &entries = rewriter->entries();
+    for (int i = 0; i < entries.count(); ++i) {
+        const ZipRewriter::Entry &entry = entries.at(i);
+
+        if (entry.source == 0) {
+            const QString name = rewriter->entryName(i, codepage);
+            setCurrentFile(name);
+            if (replaced.contains(name)) {
+                // Nahrazeno novým souborem
+                qDebug() << "Existing entry, will be refresh: =>" << name;
+                files_count--;
+                progressChannel()->setTotalEntries(files_count);
+                continue;
+            }
+        }
+
+        if (!rewriter->copyEntry(i)) {
+            emit error(tr("The archive could not be updated."), rewriter->errorString());
+            rewriter->abort();
+            QFile::remove(partFilename);
+            return false;
+        }
+        progressChannel()->setReadBytes(progressChannel()->readBytes() + entry.length);
+        if (entry.source == 0) {
+            writen_count++;
+            progressChannel()->addProcessedEntries();
+            setTotalProgress(100 * writen_count / files_count);
+        }
+    }
+
+    if (!rewriter->finish()) {
+        emit error(tr("The archive could not be updated."), rewriter->errorString());
+        rewriter->abort();
+        QFile::remove(partFilename);
+        return false;
+    }
+    QFile::remove(partFilename);
+
+    QFile::remove(filename());
+    QFile::rename(tempFilename, filename());
+
+    Archive* arch_info = getArchive();
+    arch_info->setEntryCount(rewriter->writtenCount());
+    arch_info->setExtractedSize(rewriter->writtenSize());
+    arch_info->setCompressedSize(QFileInfo(filename()).size());
+
+    return true;
+}
+
+bool QLibArchive::deleteFilesZipRaw(const SelectionMatcher &selection, ZipRewriter *rewriter)
+{
+    const QString tempFilename = filename() + QLatin1String( ".Temp" );
+    const QString codepage = getArchive()->codePage();
+
+    if (!rewriter->open(tempFilename)) {
+        emit error(tr("Opening the archive for writing failed with the following error: <message>%1</message>","@info")
+                   .arg(rewriter->errorString()));
+        return false;
+    }
+
+    const QList<ZipRewriter::Entry> &entries = rewriter->entries();
+    const int files_count = entries.count();
+    progressChannel()->setTotalEntries(files_count);
+    setTotalProgress(0);
+
+    QStringList removed;
+    for (int i = 0; i < files_count; ++i) {
+        const QString name = rewriter->entryName(i, codepage);
+
+        if (selection.matches(name)) {
+            setCurrentFile(tr("Delleting: %1").arg(name));
+            qDebug() << "Entry to be deleted, skipping" << name;
+            removed.append(name);
+        } else {
+            setCurrentFile(name);
+            if (!rewriter->copyEntry(i)) {
+                emit error(tr("The archive could not be updated."), rewriter->errorString());
+                rewriter->abort();
+                return false;
+            }
+            progressChannel()->setReadBytes(progressChannel()->readBytes() + entries.at(i).length);
+        }
+        progressChannel()->addProcessedEntries();
+        setTotalProgress(100 * (i + 1) / files_count);
+    }
+
+    if (!rewriter->finish()) {
+        emit error(tr("The archive could not be updated."), rewriter->errorString());
+        rewriter->abort();
+        return false;
+    }
+
+    QFile::remove(filename());
+    QFile::rename(tempFilename, filename());
+
+    // Model se aktualizuje až po úspěšném nahrazení archivu
+    foreach (const QString &name, removed) {
+        emit entryRemoved(name);
+    }
+
+    Archive* arch_info = getArchive();
+    arch_info->setEntryCount(rewriter->writtenCount());
+    arch_info->setExtractedSize(rewriter->writtenSize());
+    arch_info->setCompressedSize(QFileInfo(filename()).size());
+
+    return true;
+}
+
+
+/*
+ * Byte ranges of the deleted members are cut out of the archive, the data
+ * behind them is moved down and the file is truncated.
+ */
+bool QLibArchive::deleteFilesInPlace(const SelectionMatcher &selection, const QList<ArchiveAppender::Member> &members)
+{
+    ArchiveCompactor compactor(filename());
+    QStringList removed;
+    qint64 removedSize = 0;
+
+    foreach (const ArchiveAppender::Member &member, members) {
+        const QString name = QFile::decodeName(member.name);
+        if (selection.matches(name)) {
+            qDebug() << "Entry to be deleted, skipping" << name;
+            compactor.removeRange(member.offset, member.end);
+            removed.append(name);
+            removedSize += member.size;
+        }
+    }
+
+    // Preflight
+    const qint64 bytesToMove = compactor.bytesToMove();
+    qDebug() << "QLibArchive: deleting" << removed.count() << "entries in place," << compactor.removedBytes()
+             << "bytes removed," << bytesToMove << "bytes to move";
+
+    progressChannel()->setTotalEntries(removed.count());
+    progressChannel()->setTotalBytes(bytesToMove);
+    setTotalProgress(0);
+    setCurrentFile(tr("Moving %1 of the archive data").arg(QSizeFormater::convertSize(bytesToMove)));
+
+    if (!compactor.open()) {
+        emit error(tr("Opening the archive for writing failed with the following error: <message>%1</message>","@info")
+                   .arg(compactor.errorString()));
+        return false;
+    }
+
+    while (!compactor.atEnd()) {
+        const qint64 moved = compactor.movedBytes();
+        if (!compactor.step()) {
+            emit error(tr("The archive could not be updated."), compactor.errorString());
+            return false;
+        }
+        progressChannel()->addProcessedBytes(compactor.movedBytes() - moved);
+        setTotalProgress(100 * compactor.movedBytes() / bytesToMove);
+    }
+
+    if (!compactor.finish()) {
+        emit error(tr("The archive could not be updated."), compactor.errorString());
+        return false;
+    }
+    setTotalProgress(100);
+
+    foreach (const QString &name, removed) {
+        emit entryRemoved(name);
+    }
+    progressChannel()->addProcessedEntries(removed.count());
+
+    Archive* arch_info = getArchive();
+    arch_info->setEntryCount(arch_info->entryCount() - removed.count());
+    arch_info->setExtractedSize(qMax(Q_INT64_C(0), arch_info->extractedSize() - removedSize));
+    arch_info->setCompressedSize(QFileInfo(filename()).size());
+
+    return true;
+}
+
 bool QLibArchive::test()
 {
     emit testResult(tr("Archive: %1\n\n").arg(filename()));
 
+    ArchiveFileSource input(filename());
     ArchiveRead arch_reader(archive_read_new());
     if (!(arch_reader.data())) {
         return false;
@@ -1630,7 +2592,7 @@ bool QLibArchive::test()
         }
     }
 
-    if (archive_read_open_filename(arch_reader.data(), QFile::encodeName(filename()), 10240) != ARCHIVE_OK) {
+    if (input.open(arch_reader.data()) != ARCHIVE_OK) {
     //if (archive_read_open_filename(arch_reader.data(), QFile::encodeName(archive->fileName()), 10240) != ARCHIVE_OK) {
         emit error(tr("Could not open the archive <i>%1</i>.", "@info").arg(filename()));
         //emit error(tr("Could not open the archive <i>%1</i>.", "@info").arg( archive->fileName() ));
@@ -1639,10 +2601,12 @@ bool QLibArchive::test()
         return false;
     }
 
-    emit totalProgress(0);
+    setTotalProgress(0);
     //m_cachedArchiveEntryCount;
     m_extractedFilesSize = getArchive()->extractedSize();
     qint64 procesedSize = 0;
+    progressChannel()->setTotalBytes(m_extractedFilesSize);
+    progressChannel()->setTotalEntries(getArchive()->entryCount());
 
     struct archive_entry *entry;
     qint64 entry_size;
@@ -1666,16 +2630,13 @@ bool QLibArchive::test()
         //m_extractedFilesSize += entry_size;
 
         m_archFormat = archive_format(arch_reader.data());
-        qDebug() << "ArchiveFormat:" << m_archFormat;
         m_archFormatName = QString::fromLocal8Bit(archive_format_name(arch_reader.data()));
-        qDebug() << "ArchiveFormatName:" << m_archFormatName;
 
         m_archFilesCount = archive_file_count(arch_reader.data());
         //m_cachedArchiveEntryCount++;
-        qDebug() << "ArchiveFileCount:" << m_archFilesCount << "m_cachedArchiveEntryCount:" << m_cachedArchiveEntryCount;
 
-        emit currentFile(pathname);
-        emit currentFileProgress(0);
+        setCurrentFile(pathname);
+        setCurrentFileProgress(0);
         emit testResult(QString("Testing     %1  ").arg(pathname, -30, QLatin1Char(' ')));
 
         // Zde načíst všechna data souboru
@@ -1691,15 +2652,14 @@ bool QLibArchive::test()
             r = archive_read_data_block(arch_reader.data(), &buff, &size, &offset);
             readed_size += size;
             procesedSize += size;
-            emit currentFileProgress(static_cast<unsigned long>(100.0 * double(readed_size) / entry_size));
-            qDebug() << "EntrySize:" << entry_size << "Size:" << size << "ReadedSize" << readed_size;
+            progressChannel()->addProcessedBytes(size);
+            setCurrentFileProgress(static_cast<unsigned long>(100.0 * double(readed_size) / entry_size));
             //emit testResult(QString("%1, %2, %3, %4").arg(r).arg(pathname).arg(archive_errno(arch_reader.data())).arg(archive_error_string(arch_reader.data())));
             if (r < ARCHIVE_OK) {
                 error = 1;
                 error_count++;
                 emit testResult(QString("\n  Error: %1\n").arg(archive_error_string(arch_reader.data())));
             }
-            qDebug() << "ReadData Returning:" <<  responseName(r);
             if (r==ARCHIVE_EOF || r==ARCHIVE_FATAL) {
                 break;
             }
@@ -1713,7 +2673,9 @@ bool QLibArchive::test()
         //int prgrs = int(100.0 * double(procesedSize) / double(m_extractedFilesSize));
         //qDebug() << "ProgrCount:" << prgrc << "ProgrSize:" << prgrs;
 
-        emit totalProgress(100 * procesedSize / m_extractedFilesSize); // Přesnější
+        progressChannel()->setReadBytes(archive_filter_bytes(arch_reader.data(), -1));
+        progressChannel()->addProcessedEntries();
+        setTotalProgress(100 * procesedSize / m_extractedFilesSize); // Přesnější
     }
 
     if (result != ARCHIVE_EOF) {
@@ -1742,6 +2704,11 @@ bool QLibArchive::isReadOnly() const
 
 
 void QLibArchive::emitEntryFromArchiveEntry(archive_entry *aentry)
+{
+    addEntry(entryFromArchiveEntry(aentry));
+}
+
+ArchiveEntry QLibArchive::entryFromArchiveEntry(archive_entry *aentry)
 {
     ArchiveEntry e;
 
@@ -1792,7 +2759,7 @@ void QLibArchive::emitEntryFromArchiveEntry(archive_entry *aentry)
      */
     e[Timestamp] = QDateTime::fromTime_t(archive_entry_mtime(aentry));
 
-    emit entry(e);
+    return e;
 }
 
 /*
@@ -1836,48 +2803,52 @@ int QLibArchive::extractionFlags() const
 }
 
 
-int QLibArchive::copyData(struct archive *source, struct archive *dest, qint64 entry_size, bool partialprogress)
+int QLibArchive::copyData(struct archive *source, struct archive *dest, qint64 entry_size, bool partialprogress, bool toDisk)
 {
-    char buff[10240];
-    ssize_t readBytes;
-    qint64 writen_size = 0;
-
-    emit currentFileProgress(0);
+    const void *data;
+    size_t size;
+    __LA_INT64_T offset;
+    qint64 position = 0;
+    int response;
+
+    setCurrentFileProgress(0);
+
+    forever {
+        // bez kopírování, blok patří dekodéru do dalšího volání
+        response = archive_read_data_block(source, &data, &size, &offset);
+        if (response != ARCHIVE_OK) {
+            break;
+        }
 
-    readBytes = archive_read_data(source, buff, sizeof(buff));
-    while (readBytes > 0) {
-        /* int writeBytes = */
-        archive_write_data(dest, buff, readBytes);
-        if (archive_errno(dest) != ARCHIVE_OK) {
+        const qint64 lastPosition = position;
+        if (!writeDataBlock(dest, data, size, offset, &position, toDisk)) {
             qDebug() << "Error while extracting..."
                      << "Error" << archive_errno(dest) << ':' << archive_error_string(dest);
             emit error(archive_error_string(dest), "Error detail");
             return -1;
         }
 
+        progressChannel()->addProcessedBytes(position - lastPosition);
         if (entry_size > 0) {
-            writen_size += readBytes;
-            emit currentFileProgress(100 * writen_size / entry_size);
+            setCurrentFileProgress(100 * position / entry_size);
         }
 
         if (partialprogress) {//ToDo:
-            m_currentExtractedFilesSize += readBytes;
-            emit totalProgress(100 * m_currentExtractedFilesSize / m_extractedFilesSize);
+            m_currentExtractedFilesSize += position - lastPosition;
+            setTotalProgress(100 * m_currentExtractedFilesSize / m_extractedFilesSize);
         }
-
-        readBytes = archive_read_data(source, buff, sizeof(buff));
     }
 
-    emit currentFileProgress(100);
+    setCurrentFileProgress(100);
 
     /*ZIP : pokud data šifrována nelze je číst*/
-    if (readBytes < 0) {
-        /* Error: archive_read_data() returns  ARCHIVE_FATAL, ARCHIVE_WARN, or ARCHIVE_RETRY (dle dokumentace)*/
+    if (response != ARCHIVE_EOF) {
+        /* Error: archive_read_data_block() returns ARCHIVE_FATAL, ARCHIVE_WARN, or ARCHIVE_RETRY (dle dokumentace)*/
         /* !!! ale v případě zaheslovaného zip vrací -25 == ARCHIVE_FAILED !!! */
-        qDebug() << "Error while reading archive data..." << readBytes;
+        qDebug() << "Error while reading archive data..." << response;
         qDebug() << "Error" << archive_errno(source) << ':' << archive_error_string(source);
         emit error(archive_error_string(source));
-        return readBytes;
+        return response;
     }
     /*END ZIP*/
 
@@ -1885,8 +2856,10 @@ int QLibArchive::copyData(struct archive *source, struct archive *dest, qint64 e
 }
 
 
-bool QLibArchive::fileToArchive(const QString &fileName, archive *arch_writer)
+bool QLibArchive::fileToArchive(const FileScanner::Entry &file, archive *arch_writer)
 {
+    const QString &fileName = file.path;
+
     // Create disk reader
     ArchiveRead arch_read_disk(archive_read_disk_new());
     if (!(arch_read_disk.data())) {
@@ -1896,20 +2869,12 @@ bool QLibArchive::fileToArchive(const QString &fileName, archive *arch_writer)
     }
     archive_read_disk_set_standard_lookup(arch_read_disk.data());
 
-    emit currentFile(fileName);
-    emit currentFileProgress(0);
+    setCurrentFile(fileName);
+    setCurrentFileProgress(0);
 
     const bool trailingSlash = fileName.endsWith(QLatin1Char( '/' ));
     const QString relativeName = m_workDir.relativeFilePath(fileName) + (trailingSlash ? QLatin1String( "/" ) : QLatin1String( "" ));
 
-    struct stat st;
-    memset(&st, 0, sizeof(st)); // nulovat asi neni potreba
-#ifdef Q_OS_WIN
-    stat(QFile::encodeName(fileName).constData(), &st);
-#else
-    lstat(QFile::encodeName(fileName).constData(), &st);
-#endif
-
     int fd = ::open(fileName.toLocal8Bit(), O_RDONLY);
     if (fd < 0) {
         qDebug("%s: open(%s) failed:", __func__, fileName.toLocal8Bit().constData());
@@ -1922,7 +2887,7 @@ bool QLibArchive::fileToArchive(const QString &fileName, archive *arch_writer)
 
     //int r = archive_read_disk_entry_from_file(arch_read_disk.data(), entry, -1, &st);
     //int r = archive_read_disk_entry_from_file(arch_read_disk.data(), entry, -1, 0);
-    int r = archive_read_disk_entry_from_file(arch_read_disk.data(), entry, fd, &st);
+    int r = archive_read_disk_entry_from_file(arch_read_disk.data(), entry, fd, &file.st);
     if (r != ARCHIVE_OK) {
         qDebug("Error %i: %s", archive_errno(arch_read_disk.data()), archive_error_string(arch_read_disk.data()) );
     }
@@ -1964,11 +2929,12 @@ bool QLibArchive::fileToArchive(const QString &fileName, archive *arch_writer)
 
                 writen_size += readBytes;
                 m_extractedFilesSize += readBytes;
-                emit currentFileProgress(100 * writen_size / entry_size);
+                progressChannel()->addProcessedBytes(readBytes);
+                setCurrentFileProgress(100 * writen_size / entry_size);
 
                 if (partialprogress) {
                     m_currentExtractedFilesSize += readBytes;
-                    emit totalProgress(100 * m_currentExtractedFilesSize / m_extractedFilesSize);
+                    setTotalProgress(100 * m_currentExtractedFilesSize / m_extractedFilesSize);
                 }
 
                 readBytes = read(fd, buff, sizeof(buff));
@@ -1987,7 +2953,7 @@ bool QLibArchive::fileToArchive(const QString &fileName, archive *arch_writer)
         return false;
     }
 
-    m_writtenFiles.push_back(relativeName);
+    m_writtenFiles.insert(relativeName);
 
     emitEntryFromArchiveEntry(entry);
 
@@ -2015,7 +2981,8 @@ QStringList QLibArchive::archiveEntryList(struct archive *a_reader,const QString
 {
     struct archive_entry *entry;
 
-    if (archive_read_open_filename(a_reader, QFile::encodeName(fileName), 10240) != ARCHIVE_OK) {
+    ArchiveFileSource input(fileName);
+    if (input.open(a_reader) != ARCHIVE_OK) {
         emit error(tr("The source file could not be read."));
         qDebug("Error %i: %s", archive_errno(a_reader), archive_error_string(a_reader) );
         return QStringList();
@@ -2,14 +2,19 @@
 #define QLIBARCHIVE_H
 
 #include "archiveinterface.h"
+#include "archiveappender.h"
+#include "filescanner.h"
 
 #include <QDir>
 #include <QScopedPointer>
+#include <QSet>
 
 #define LIBARCHIVE_NO_RAR
 
 class QMimeType;
 class Archive;
+class SelectionMatcher;
+class ZipRewriter;
 
 class QLibArchive : public ArchiveInterface
 {
@@ -35,6 +40,8 @@ public:
     virtual bool addFiles(const QStringList& files, const CompressionOptions& options);
     virtual bool deleteFiles(const QVariantList& files);
     virtual bool test();
+    virtual QVariantMap cacheData() const;
+    virtual void setCacheData(const QVariantMap &data);
     int libArchiveFormatCode(const QMimeType &mimeType);
 
 signals:
@@ -46,15 +53,36 @@ private:
     struct ArchiveWriteCustomDeleter;
     typedef QScopedPointer<struct archive, ArchiveReadCustomDeleter> ArchiveRead;
     typedef QScopedPointer<struct archive, ArchiveWriteCustomDeleter> ArchiveWrite;
+    struct ParallelExtractState;
+    class ExtractWorker;
+
+    // Stored mtime and size of an archive entry (update / freshen)
+    struct EntryStamp {
+        qint64 mtime;
+        qint64 size;
+        bool isDir;
+    };
 
     void emitEntryFromArchiveEntry(struct archive_entry *aentry);
+    ArchiveEntry entryFromArchiveEntry(struct archive_entry *aentry);
     const QString relativeToLocalWD(const QString &fileName);
     QString absoluteFilePathLocalWD(const QString &relFilePath);
-    int countFiles(const QStringList &files, QStringList *filesList);
 
     int extractionFlags() const;
-    int copyData(struct archive *source, struct archive *dest, qint64 entry_size, bool partialprogress = true);
-    bool fileToArchive(const QString& fileName, struct archive* arch_writer);
+    bool canExtractInParallel(int entryCount, const ExtractionOptions &options) const;
+    bool copyFilesParallel(const QVariantList &files, const ExtractionOptions &options, QVariantList *deferredFiles);
+    int copyData(struct archive *source, struct archive *dest, qint64 entry_size, bool partialprogress = true, bool toDisk = false);
+    bool fileToArchive(const FileScanner::Entry &file, struct archive* arch_writer);
+    bool writeNewFiles(const FileEntryList &files, struct archive *arch_writer, int files_count, int *writen_count);
+    bool readEntryStamps(QHash<QString, EntryStamp> *stamps);
+    FileEntryList changedFiles(const FileEntryList &files, const QHash<QString, EntryStamp> &stamps, int addMode);
+    bool canAppendInPlace(ArchiveAppender::Format *format) const;
+    bool replacesEntries(const FileEntryList &files, const QSet<QString> &entryNames);
+    bool addFilesInPlace(const FileEntryList &files, ArchiveAppender *appender);
+    bool deleteFilesInPlace(const SelectionMatcher &selection, const QList<ArchiveAppender::Member> &members);
+    bool canRewriteZipRaw() const;
+    bool addFilesZipRaw(const FileEntryList &files, ZipRewriter *rewriter);
+    bool deleteFilesZipRaw(const SelectionMatcher &selection, ZipRewriter *rewriter);
     QStringList archiveEntryList(struct archive *a_reader, const QString &fileName);
 
     QString responseName(int response); // debug
@@ -65,7 +93,7 @@ private:
     qlonglong m_extractedFilesSize;
     qlonglong m_currentExtractedFilesSize;
     QDir m_workDir;
-    QStringList m_writtenFiles;
+    QSet<QString> m_writtenFiles; // looked up for every old entry
     int m_archFormat;
     QString m_archFormatName;
     int m_archFilter;
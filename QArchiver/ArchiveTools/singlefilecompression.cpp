@@ -8,6 +8,7 @@
 #include <QDebug>
 
 #include "queries.h"
+#include "archivefilesource.h"
 
 struct SingleFileCompression::ArchiveReadCustomDeleter
 {
@@ -99,6 +100,7 @@ bool SingleFileCompression::isReadOnly() const
 
 bool SingleFileCompression::open()
 {
+    ArchiveFileSource input(filename());
     ArchiveRead arch_reader(archive_read_new());
     if (!(arch_reader.data())) {
         return false;
@@ -116,7 +118,7 @@ bool SingleFileCompression::open()
         return false;
     }
 
-    if (archive_read_open_filename(arch_reader.data(), QFile::encodeName(filename()), 10240) != ARCHIVE_OK) {
+    if (input.open(arch_reader.data()) != ARCHIVE_OK) {
         emit error(tr("<qt>Could not open the archive <i>%1</i>.</qt>", "@info").arg(filename()),
                    tr(archive_error_string( arch_reader.data() ), "@libArchiveError"));
         qDebug( archive_error_string(arch_reader.data()) );
@@ -129,8 +131,8 @@ bool SingleFileCompression::open()
     qint64 compressed = 0;
     qint64 uncompressed = 0;
 
-    emit currentFileProgress(-2);
-    emit currentFile(tr("Reading archive..."));
+    setCurrentFileProgress(-2);
+    setCurrentFile(tr("Reading archive..."));
 
     char buff[10240];
     ssize_t readBytes;
@@ -142,7 +144,7 @@ bool SingleFileCompression::open()
             m_extractedSize += readBytes;
             readBytes = archive_read_data(arch_reader.data(), buff, sizeof(buff));
             compressed = archive_filter_bytes(arch_reader.data(), -1);
-            emit totalProgress(100 * compressed / archiveSize);
+            setTotalProgress(100 * compressed / archiveSize);
         }
 
         if (readBytes < 0) {
@@ -170,6 +172,7 @@ bool SingleFileCompression::open()
 
 bool SingleFileCompression::list()
 {
+    ArchiveFileSource input(filename());
     ArchiveRead arch_reader(archive_read_new());
     if (!(arch_reader.data())) {
         return false;
@@ -187,7 +190,7 @@ bool SingleFileCompression::list()
         return false;
     }
 
-    if (archive_read_open_filename(arch_reader.data(), QFile::encodeName(filename()), 10240) != ARCHIVE_OK) {
+    if (input.open(arch_reader.data()) != ARCHIVE_OK) {
         emit error(tr("<qt>Could not open the archive <i>%1</i>.</qt>", "@info").arg(filename()),
                    tr(archive_error_string( arch_reader.data() ), "@libArchiveError"));
         qDebug( archive_error_string(arch_reader.data()) );
@@ -198,7 +201,7 @@ bool SingleFileCompression::list()
     struct archive_entry *entry;
     while (archive_read_next_header(arch_reader.data(), &entry) == ARCHIVE_OK) {
         archive_entry_set_pathname(entry, fileNameForData().toLocal8Bit());
-        emit currentFile(tr("<qt>%1</qt>").arg(QString::fromLocal8Bit(archive_entry_pathname(entry))));
+        setCurrentFile(QString::fromLocal8Bit(archive_entry_pathname(entry)));
         archive_read_data_skip(arch_reader.data());
 
         emitEntry(entry);
@@ -214,6 +217,7 @@ bool SingleFileCompression::test()
 {
     emit testResult(tr("Archive: %1\n\n").arg(filename()));
 
+    ArchiveFileSource input(filename());
     ArchiveRead arch_reader(archive_read_new());
     if (!(arch_reader.data())) {
         return false;
@@ -231,14 +235,14 @@ bool SingleFileCompression::test()
         return false;
     }
 
-    if (archive_read_open_filename(arch_reader.data(), QFile::encodeName(filename()), 10240) != ARCHIVE_OK) {
+    if (input.open(arch_reader.data()) != ARCHIVE_OK) {
         emit error(tr("Could not open the archive <i>%1</i>.", "@info").arg(filename()));
         qDebug("%i: %s", archive_errno( arch_reader.data() ), strerror(archive_errno( arch_reader.data() )));
         qDebug( archive_error_string( arch_reader.data() ) );
         return false;
     }
 
-    emit totalProgress(0);
+    setTotalProgress(0);
     qint64 procesedSize = 0;
     qint64 entry_size = m_extractedSize;
 
@@ -255,8 +259,8 @@ bool SingleFileCompression::test()
 
         const QString pathname = fileNameForData();
 
-        emit currentFile(pathname);
-        emit currentFileProgress(0);
+        setCurrentFile(pathname);
+        setCurrentFileProgress(0);
         emit testResult(QString("Testing     %1  ").arg(pathname, -30, QLatin1Char(' ')));
 
         // Zde načíst všechna data souboru
@@ -272,8 +276,8 @@ bool SingleFileCompression::test()
             r = archive_read_data_block(arch_reader.data(), &buff, &size, &offset);
             readed_size += size;
             procesedSize += size;
-            emit currentFileProgress(100 * readed_size / entry_size);
-            emit totalProgress(100 * procesedSize / m_extractedSize);
+            setCurrentFileProgress(100 * readed_size / entry_size);
+            setTotalProgress(100 * procesedSize / m_extractedSize);
             qDebug() << "EntrySize:" << entry_size << "Size:" << size << "ReadedSize" << readed_size;
 
             if (r < ARCHIVE_OK) {
@@ -307,12 +311,13 @@ bool SingleFileCompression::test()
 
 bool SingleFileCompression::copyFiles(const QVariantList &files, const QString &destinationDirectory, ExtractionOptions options)
 {
+    // Single-file archive has only one entry, the selection does not matter
     Q_UNUSED(files);
-
     qDebug() << "Changing current directory to " << destinationDirectory;
     QDir::setCurrent(destinationDirectory);
     bool overwriteAll = options.value(QLatin1String( "AutoOverwrite" ), false).toBool();
 
+    ArchiveFileSource input(filename());
     ArchiveRead arch_reader(archive_read_new());
 
     if (!(arch_reader.data())) {
@@ -331,7 +336,7 @@ bool SingleFileCompression::copyFiles(const QVariantList &files, const QString &
         return false;
     }
 
-    if (archive_read_open_filename(arch_reader.data(), QFile::encodeName(filename()), 10240) != ARCHIVE_OK) {
+    if (input.open(arch_reader.data()) != ARCHIVE_OK) {
         emit error(tr("Could not open the archive <i>%1</i>", "@info").arg(filename()), archive_error_string(arch_reader.data()));
         qDebug( archive_error_string(arch_reader.data()) );
         return false;
@@ -347,7 +352,7 @@ bool SingleFileCompression::copyFiles(const QVariantList &files, const QString &
 //    struct stat st;
 //    stat(QFile::encodeName(filename()).constData(), &st);
 
-    emit totalProgress(0);
+    setTotalProgress(0);
 
     struct archive_entry *entry;
 
@@ -373,7 +378,7 @@ bool SingleFileCompression::copyFiles(const QVariantList &files, const QString &
             return true;
         }
     }
-    emit currentFile(entryName);
+    setCurrentFile(entryName);
 
     archive_entry_copy_pathname(entry, entryName.toLocal8Bit());
 
@@ -389,7 +394,7 @@ bool SingleFileCompression::copyFiles(const QVariantList &files, const QString &
         qDebug() << "Copy data failed.";
         return false;
     }
-    emit totalProgress(100);
+    setTotalProgress(100);
 
     bool reader_closed = (archive_read_close(arch_reader.data()) == ARCHIVE_OK);
     bool writer_closed = (archive_write_close(writer.data()) == ARCHIVE_OK);
@@ -480,63 +485,39 @@ void SingleFileCompression::emitEntry(archive_entry *aentry)
     }
 
 
-    emit entry(e);
-}
-
-int SingleFileCompression::copyDataBlock(struct archive *areader, struct archive *awriter)
-{
-  int r;
-  const void *buff;
-  size_t size;
-  off_t offset;
-
-  for (;;) {
-    r = archive_read_data_block(areader, &buff, &size, &offset);
-    if (r == ARCHIVE_EOF)
-      return (ARCHIVE_OK);
-    if (r < ARCHIVE_OK)
-      return (r);
-    r = archive_write_data_block(awriter, buff, size, offset);
-    if (r < ARCHIVE_OK) {
-      fprintf(stderr, "%s\n", archive_error_string(awriter));
-      return (r);
-    }
-  }
+    addEntry(e);
 }
 
 int SingleFileCompression::copyData(struct archive *source, struct archive *dest, qint64 entry_size)
 {
-    char buff[10240];
-    ssize_t readBytes;
-    qint64 writen_size = 0;
+    const void *buff;
+    size_t size;
+    __LA_INT64_T offset;
+    int response;
 
-    emit currentFileProgress(0);
+    setCurrentFileProgress(0);
 
-    readBytes = archive_read_data(source, buff, sizeof(buff));
-    while (readBytes > 0) {
-        /* int writeBytes = */
-        archive_write_data(dest, buff, readBytes);
-        if (archive_errno(dest) != ARCHIVE_OK) {
+    // bloky dekodéru se zapisují přímo, bez kopírování
+    while ((response = archive_read_data_block(source, &buff, &size, &offset)) == ARCHIVE_OK) {
+        if (archive_write_data_block(dest, buff, size, offset) < ARCHIVE_OK) {
             qDebug() << "Error while extracting..." << "Error" << archive_errno(dest) << ':' << archive_error_string(dest);
             emit error(archive_error_string(dest));
             return -1;
         }
 
         if (entry_size > 0) {
-            writen_size += readBytes;
-            emit currentFileProgress(100 * writen_size / entry_size);
-            emit totalProgress(100 * writen_size / entry_size);
+            const qint64 writen_size = offset + size;
+            setCurrentFileProgress(100 * writen_size / entry_size);
+            setTotalProgress(100 * writen_size / entry_size);
         }
-
-        readBytes = archive_read_data(source, buff, sizeof(buff));
     }
 
-    emit currentFileProgress(100);
+    setCurrentFileProgress(100);
 
-    if (readBytes < 0) {
+    if (response != ARCHIVE_EOF) {
         qDebug() << "Error" << archive_errno(source) << ':' << archive_error_string(source);
         emit error(archive_error_string(source), "");
-        return readBytes;
+        return response;
     }
 
     return ARCHIVE_OK;
@@ -30,7 +30,6 @@ private:
 
     QString fileNameForData() const;
     void emitEntry(struct archive_entry *aentry);
-    int copyDataBlock(struct archive *areader, struct archive *awriter);
     int copyData(struct archive *source, struct archive *dest, qint64 entry_size);
 
     int m_archFilter;
@@ -0,0 +1,486 @@
+#include "ziprewriter.h"
+
+#include "Codecs/textencoder.h"
+
+#include <QtEndian>
+#include <QDebug>
+
+#include <algorithm>
+
+static const quint32 c_localHeaderSignature = 0x04034b50;
+static const quint32 c_centralHeaderSignature = 0x02014b50;
+static const quint32 c_endOfDirSignature = 0x06054b50;
+static const quint32 c_zip64EndOfDirSignature = 0x06064b50;
+static const quint32 c_zip64LocatorSignature = 0x07064b50;
+
+static const int c_localHeaderSize = 30;
+static const int c_centralHeaderSize = 46;
+static const int c_endOfDirSize = 22;
+static const int c_zip64EndOfDirSize = 56;
+static const int c_zip64LocatorSize = 20;
+
+static const quint16 c_zip64ExtraId = 0x0001;
+static const quint16 c_unicodePathExtraId = 0x7075;
+static const quint16 c_utf8Flag = 0x0800;
+static const quint16 c_zip64Version = 45;
+
+static const qint64 c_max16 = 0xFFFF;
+static const qint64 c_max32 = 0xFFFFFFFFLL;
+
+// Entries are copied in blocks of this size
+static const qint64 c_copyBlockSize = 1024 * 1024;
+
+static inline quint16 readU16(const QByteArray &data, int pos)
+{
+    return qFromLittleEndian<quint16>(reinterpret_cast<const uchar*>(data.constData() + pos));
+}
+
+static inline quint32 readU32(const QByteArray &data, int pos)
+{
+    return qFromLittleEndian<quint32>(reinterpret_cast<const uchar*>(data.constData() + pos));
+}
+
+static inline quint64 readU64(const QByteArray &data, int pos)
+{
+    return qFromLittleEndian<quint64>(reinterpret_cast<const uchar*>(data.constData() + pos));
+}
+
+static inline void writeU16(QByteArray *data, int pos, quint16 value)
+{
+    qToLittleEndian<quint16>(value, reinterpret_cast<uchar*>(data->data() + pos));
+}
+
+static inline void writeU32(QByteArray *data, int pos, quint32 value)
+{
+    qToLittleEndian<quint32>(value, reinterpret_cast<uchar*>(data->data() + pos));
+}
+
+static inline void appendU16(QByteArray *data, quint16 value)
+{
+    data->resize(data->size() + 2);
+    writeU16(data, data->size() - 2, value);
+}
+
+static inline void appendU32(QByteArray *data, quint32 value)
+{
+    data->resize(data->size() + 4);
+    writeU32(data, data->size() - 4, value);
+}
+
+static inline void appendU64(QByteArray *data, quint64 value)
+{
+    data->resize(data->size() + 8);
+    qToLittleEndian<quint64>(value, reinterpret_cast<uchar*>(data->data() + data->size() - 8));
+}
+
+static bool offsetLessThan(const ZipRewriter::Entry *a, const ZipRewriter::Entry *b)
+{
+    return a->offset < b->offset;
+}
+
+
+ZipRewriter::ZipRewriter()
+    : m_written(0)
+    , m_writtenSize(0)
+{
+}
+
+ZipRewriter::~ZipRewriter()
+{
+    if (m_output.isOpen()) {
+        abort();
+    }
+    qDeleteAll(m_sources);
+}
+
+bool ZipRewriter::addSource(const QString &fileName)
+{
+    QFile *file = new QFile(fileName);
+    if (!file->open(QIODevice::ReadOnly)) {
+        setError(file->errorString());
+        delete file;
+        return false;
+    }
+
+    const int first = m_entries.count();
+    if (!readCentralDirectory(file, m_sources.count())) {
+        m_entries.erase(m_entries.begin() + first, m_entries.end());
+        delete file;
+        return false;
+    }
+
+    m_sources.append(file);
+    return true;
+}
+
+const QList<ZipRewriter::Entry> &ZipRewriter::entries() const
+{
+    return m_entries;
+}
+
+QString ZipRewriter::entryName(int index, const QString &codepage) const
+{
+    const Entry &entry = m_entries.at(index);
+    if (entry.flags & c_utf8Flag) {
+        return QString::fromUtf8(entry.name);
+    }
+    if (!entry.unicodeName.isEmpty()) {
+        return QString::fromUtf8(entry.unicodeName);
+    }
+    if (!codepage.isEmpty()) {
+        return TextEncoder::decodeName(entry.name, codepage);
+    }
+    return QFile::decodeName(entry.name);
+}
+
+bool ZipRewriter::readCentralDirectory(QFile *file, int source)
+{
+    const qint64 fileSize = file->size();
+    if (fileSize < c_endOfDirSize) {
+        return setError(tr("The file is not a zip archive."));
+    }
+
+    // End of central directory record is followed only by the comment
+    const qint64 tailSize = qMin(fileSize, qint64(c_endOfDirSize + c_max16));
+    if (!file->seek(fileSize - tailSize)) {
+        return setError(file->errorString());
+    }
+    const QByteArray tail = file->read(tailSize);
+    if (tail.size() != tailSize) {
+        return setError(file->errorString());
+    }
+
+    int eocd = -1;
+    for (int i = tail.size() - c_endOfDirSize; i >= 0; --i) {
+        if (readU32(tail, i) == c_endOfDirSignature
+                && i + c_endOfDirSize + readU16(tail, i + 20) <= tail.size()) {
+            eocd = i;
+            break;
+        }
+    }
+    if (eocd < 0) {
+        return setError(tr("The end of the zip central directory was not found."));
+    }
+
+    quint32 disk = readU16(tail, eocd + 4);
+    quint32 directoryDisk = readU16(tail, eocd + 6);
+    qint64 count = readU16(tail, eocd + 10);
+    qint64 directorySize = readU32(tail, eocd + 12);
+    qint64 directoryOffset = readU32(tail, eocd + 16);
+    qint64 directoryEnd = fileSize - tailSize + eocd;
+
+    if (source == 0) {
+        m_comment = tail.mid(eocd + c_endOfDirSize, readU16(tail, eocd + 20));
+    }
+
+    if (count == c_max16 || directorySize == c_max32 || directoryOffset == c_max32) {
+        const int locator = eocd - c_zip64LocatorSize;
+        if (locator < 0 || readU32(tail, locator) != c_zip64LocatorSignature) {
+            return setError(tr("The ZIP64 end of central directory locator was not found."));
+        }
+        const qint64 recordPos = readU64(tail, locator + 8);
+        if (!file->seek(recordPos)) {
+            return setError(file->errorString());
+        }
+        const QByteArray record = file->read(c_zip64EndOfDirSize);
+        if (record.size() != c_zip64EndOfDirSize || readU32(record, 0) != c_zip64EndOfDirSignature) {
+            return setError(tr("The ZIP64 end of central directory record is corrupted."));
+        }
+        disk = readU32(record, 16);
+        directoryDisk = readU32(record, 20);
+        count = readU64(record, 32);
+        directorySize = readU64(record, 40);
+        directoryOffset = readU64(record, 48);
+        directoryEnd = recordPos;
+    }
+
+    if (disk != 0 || directoryDisk != 0) {
+        return setError(tr("Multi-volume zip archives are not supported."));
+    }
+    if (directoryOffset + directorySize != directoryEnd) {
+        return setError(tr("The zip archive contains data outside of its entries."));
+    }
+
+    if (!file->seek(directoryOffset)) {
+        return setError(file->errorString());
+    }
+    const QByteArray directory = file->read(directorySize);
+    if (directory.size() != directorySize) {
+        return setError(tr("The zip central directory could not be read."));
+    }
+
+    QList<Entry*> sorted;
+    int pos = 0;
+    for (qint64 i = 0; i < count; ++i) {
+        if (pos + c_centralHeaderSize > directory.size() || readU32(directory, pos) != c_centralHeaderSignature) {
+            return setError(tr("The zip central directory is corrupted."));
+        }
+        const int nameLength = readU16(directory, pos + 28);
+        const int extraLength = readU16(directory, pos + 30);
+        const int commentLength = readU16(directory, pos + 32);
+        const int extraPos = pos + c_centralHeaderSize + nameLength;
+        const int extraEnd = extraPos + extraLength;
+        if (extraEnd + commentLength > directory.size()) {
+            return setError(tr("The zip central directory is corrupted."));
+        }
+
+        Entry entry;
+        entry.source = source;
+        entry.flags = readU16(directory, pos + 8);
+        entry.compressedSize = readU32(directory, pos + 20);
+        entry.size = readU32(directory, pos + 24);
+        entry.offset = readU32(directory, pos + 42);
+        entry.length = 0;
+        entry.record = directory.mid(pos, c_centralHeaderSize);
+        entry.name = directory.mid(pos + c_centralHeaderSize, nameLength);
+        entry.comment = directory.mid(extraEnd, commentLength);
+
+        // ZIP64 values are replaced, other extra fields are kept as they are
+        for (int x = extraPos; x + 4 <= extraEnd; ) {
+            const quint16 id = readU16(directory, x);
+            const int length = readU16(directory, x + 2);
+            const int data = x + 4;
+            if (data + length > extraEnd) {
+                break;
+            }
+            if (id == c_zip64ExtraId) {
+                int field = data;
+                if (entry.size == c_max32 && field + 8 <= data + length) {
+                    entry.size = readU64(directory, field);
+                    field += 8;
+                }
+                if (entry.compressedSize == c_max32 && field + 8 <= data + length) {
+                    entry.compressedSize = readU64(directory, field);
+                    field += 8;
+                }
+                if (entry.offset == c_max32 && field + 8 <= data + length) {
+                    entry.offset = readU64(directory, field);
+                }
+            } else {
+                if (id == c_unicodePathExtraId && length > 5 && directory.at(data) == 1) {
+                    entry.unicodeName = directory.mid(data + 5, length - 5);
+                }
+                entry.extra += directory.mid(x, 4 + length);
+            }
+            x = data + length;
+        }
+
+        m_entries.append(entry);
+        pos = extraEnd + commentLength;
+    }
+
+    for (int i = m_entries.count() - count; i < m_entries.count(); ++i) {
+        sorted.append(&m_entries[i]);
+    }
+    std::sort(sorted.begin(), sorted.end(), offsetLessThan);
+
+    // An entry ends where the next one begins, the descriptor is included
+    for (int i = 0; i < sorted.count(); ++i) {
+        Entry *entry = sorted.at(i);
+        const qint64 end = (i + 1 < sorted.count()) ? sorted.at(i + 1)->offset : directoryOffset;
+        entry->length = end - entry->offset;
+        if ((i == 0 && entry->offset != 0)
+                || entry->length < c_localHeaderSize + entry->name.size() + entry->compressedSize) {
+            return setError(tr("The zip archive contains data outside of its entries."));
+        }
+    }
+
+    return true;
+}
+
+bool ZipRewriter::open(const QString &fileName)
+{
+    m_output.setFileName(fileName);
+    if (!m_output.open(QIODevice::WriteOnly | QIODevice::Truncate)) {
+        return setError(m_output.errorString());
+    }
+
+    m_directory.clear();
+    m_written = 0;
+    m_writtenSize = 0;
+    return true;
+}
+
+bool ZipRewriter::copyEntry(int index)
+{
+    const Entry &entry = m_entries.at(index);
+    QFile *source = m_sources.at(entry.source);
+    const qint64 offset = m_output.pos();
+
+    if (!source->seek(entry.offset)) {
+        return setError(source->errorString());
+    }
+
+    qint64 left = entry.length;
+    bool first = true;
+    while (left > 0) {
+        const QByteArray block = source->read(qMin(left, c_copyBlockSize));
+        if (block.isEmpty()) {
+            return setError(tr("Unexpected end of the zip archive."));
+        }
+        if (first) {
+            if (block.size() < 4 || readU32(block, 0) != c_localHeaderSignature) {
+                return setError(tr("The zip local header of %1 is corrupted.").arg(QFile::decodeName(entry.name)));
+            }
+            first = false;
+        }
+        if (!write(block)) {
+            return false;
+        }
+        left -= block.size();
+    }
+
+    if (!appendCentralRecord(entry, offset)) {
+        return false;
+    }
+    m_written++;
+    m_writtenSize += entry.size;
+    return true;
+}
+
+bool ZipRewriter::appendCentralRecord(const Entry &entry, qint64 offset)
+{
+    QByteArray record = entry.record;
+
+    // Values which do not fit into 32 bits go to the ZIP64 extra field
+    QByteArray zip64;
+    quint32 size = entry.size;
+    quint32 compressedSize = entry.compressedSize;
+    quint32 localOffset = offset;
+    if (entry.size >= c_max32) {
+        appendU64(&zip64, entry.size);
+        size = c_max32;
+    }
+    if (entry.compressedSize >= c_max32) {
+        appendU64(&zip64, entry.compressedSize);
+        compressedSize = c_max32;
+    }
+    if (offset >= c_max32) {
+        appendU64(&zip64, offset);
+        localOffset = c_max32;
+    }
+
+    QByteArray extra;
+    if (!zip64.isEmpty()) {
+        appendU16(&extra, c_zip64ExtraId);
+        appendU16(&extra, zip64.size());
+        extra += zip64;
+
+        const quint16 needed = readU16(record, 6);
+        if ((needed & 0xFF) < c_zip64Version) {
+            writeU16(&record, 6, (needed & 0xFF00) | c_zip64Version);
+        }
+    }
+    extra += entry.extra;
+    if (extra.size() > c_max16) {
+        return setError(tr("The zip extra field of %1 is too long.").arg(QFile::decodeName(entry.name)));
+    }
+
+    writeU32(&record, 20, compressedSize);
+    writeU32(&record, 24, size);
+    writeU16(&record, 30, extra.size());
+    writeU16(&record, 34, 0); // disk number start
+    writeU32(&record, 42, localOffset);
+
+    m_directory += record;
+    m_directory += entry.name;
+    m_directory += extra;
+    m_directory += entry.comment;
+    return true;
+}
+
+bool ZipRewriter::finish()
+{
+    const qint64 directoryOffset = m_output.pos();
+    const qint64 directorySize = m_directory.size();
+    const qint64 count = m_written;
+
+    if (!write(m_directory)) {
+        return false;
+    }
+    m_directory.clear();
+
+    QByteArray end;
+    if (count >= c_max16 || directorySize >= c_max32 || directoryOffset >= c_max32) {
+        const qint64 recordPos = directoryOffset + directorySize;
+
+        appendU32(&end, c_zip64EndOfDirSignature);
+        appendU64(&end, c_zip64EndOfDirSize - 12);
+        appendU16(&end, c_zip64Version); // version made by
+        appendU16(&end, c_zip64Version); // version needed
+        appendU32(&end, 0);              // this disk
+        appendU32(&end, 0);              // disk of the central directory
+        appendU64(&end, count);
+        appendU64(&end, count);
+        appendU64(&end, directorySize);
+        appendU64(&end, directoryOffset);
+
+        appendU32(&end, c_zip64LocatorSignature);
+        appendU32(&end, 0);
+        appendU64(&end, recordPos);
+        appendU32(&end, 1);              // total number of disks
+    }
+
+    appendU32(&end, c_endOfDirSignature);
+    appendU16(&end, 0);
+    appendU16(&end, 0);
+    appendU16(&end, qMin(count, c_max16));
+    appendU16(&end, qMin(count, c_max16));
+    appendU32(&end, qMin(directorySize, c_max32));
+    appendU32(&end, qMin(directoryOffset, c_max32));
+    appendU16(&end, m_comment.size());
+    end += m_comment;
+
+    if (!write(end) || !m_output.flush()) {
+        return false;
+    }
+    m_output.close();
+    closeSources();
+    return true;
+}
+
+void ZipRewriter::abort()
+{
+    m_output.close();
+    m_output.remove();
+    m_directory.clear();
+    closeSources();
+}
+
+// Sources have to be closed before they are replaced or removed (Windows)
+void ZipRewriter::closeSources()
+{
+    foreach (QFile *file, m_sources) {
+        file->close();
+    }
+}
+
+int ZipRewriter::writtenCount() const
+{
+    return m_written;
+}
+
+qint64 ZipRewriter::writtenSize() const
+{
+    return m_writtenSize;
+}
+
+QString ZipRewriter::errorString() const
+{
+    return m_errorString;
+}
+
+bool ZipRewriter::write(const QByteArray &data)
+{
+    if (m_output.write(data) != data.size()) {
+        return setError(m_output.errorString());
+    }
+    return true;
+}
+
+bool ZipRewriter::setError(const QString &message)
+{
+    qDebug() << "ZipRewriter:" << message;
+    m_errorString = message;
+    return false;
+}
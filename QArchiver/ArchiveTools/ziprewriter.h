@@ -0,0 +1,76 @@
+#ifndef ZIPREWRITER_H
+#define ZIPREWRITER_H
+
+#include <QByteArray>
+#include <QCoreApplication>
+#include <QFile>
+#include <QList>
+#include <QString>
+
+/*
+ * Rewrites zip archives without recompressing them.
+ * Entries of the source archives are copied verbatim (local header, data
+ * and data descriptor), only the central directory is generated again.
+ * QLibArchive uses it to delete and replace entries of zip archives.
+ *
+ * Multi-volume archives and archives with data before the first entry
+ * (self-extracting) are refused by addSource().
+ */
+class ZipRewriter
+{
+    Q_DECLARE_TR_FUNCTIONS(ZipRewriter)
+public:
+    struct Entry {
+        int source;             // index of the source archive
+        QByteArray name;        // raw name from the central directory
+        QByteArray unicodeName; // Info-ZIP Unicode Path extra field (UTF-8)
+        quint16 flags;
+        qint64 size;
+        qint64 compressedSize;
+        qint64 offset;          // local header in the source
+        qint64 length;          // local header + data + descriptor
+
+        // Parts of the central directory record copied to the new one
+        QByteArray record;      // fixed part
+        QByteArray extra;       // extra fields except ZIP64
+        QByteArray comment;
+    };
+
+    ZipRewriter();
+    ~ZipRewriter();
+
+    // Reads the central directory, the entries are appended to entries()
+    bool addSource(const QString &fileName);
+    const QList<Entry> &entries() const;
+    // Name decoded as libarchive does: UTF-8 if flagged, else in the codepage
+    QString entryName(int index, const QString &codepage) const;
+
+    bool open(const QString &fileName);
+    bool copyEntry(int index);
+    // Writes the central directory, closes the output and the sources
+    bool finish();
+    // Closes and removes the output, closes the sources
+    void abort();
+
+    int writtenCount() const;
+    qint64 writtenSize() const; // uncompressed size of the copied entries
+    QString errorString() const;
+
+private:
+    bool readCentralDirectory(QFile *file, int source);
+    bool appendCentralRecord(const Entry &entry, qint64 offset);
+    bool write(const QByteArray &data);
+    void closeSources();
+    bool setError(const QString &message);
+
+    QList<QFile*> m_sources;
+    QList<Entry> m_entries;
+    QByteArray m_comment; // archive comment of the first source
+    QFile m_output;
+    QByteArray m_directory;
+    int m_written;
+    qint64 m_writtenSize;
+    QString m_errorString;
+};
+
+#endif // ZIPREWRITER_H
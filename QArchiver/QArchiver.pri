@@ -0,0 +1,129 @@
+# Sources of the application without main.cpp, shared with the benchmarks
+
+INCLUDEPATH += $$PWD
+
+SOURCES += \
+    $$PWD/mainwindow.cpp \
+    $$PWD/ArchiveTools/archiveinterface.cpp \
+    $$PWD/ArchiveTools/cliinterface.cpp \
+    $$PWD/ArchiveTools/clirarplugin.cpp \
+    $$PWD/ArchiveTools/cli7zplugin.cpp \
+    $$PWD/ArchiveTools/clizipplugin.cpp \
+    $$PWD/queries.cpp \
+    $$PWD/archivemodel.cpp \
+    $$PWD/iconprovider.cpp \
+    $$PWD/Codecs/textencoder.cpp \
+    $$PWD/Codecs/qibm852codec.cpp \
+    $$PWD/jobs.cpp \
+    $$PWD/overwritedialog.cpp \
+    $$PWD/extractdialog.cpp \
+    $$PWD/openarguments.cpp \
+    $$PWD/progressdialog.cpp \
+    $$PWD/qstandarddirs.cpp \
+    $$PWD/QtExt/qled.cpp \
+    $$PWD/testresultdialog.cpp \
+    $$PWD/archivetoolmanager.cpp \
+    $$PWD/addtoarchive.cpp \
+    $$PWD/jobinterface.cpp \
+    $$PWD/adddialog.cpp \
+    $$PWD/qarchive.cpp \
+    $$PWD/QtExt/qrecentfilesmenu.cpp \
+    $$PWD/infoframe.cpp \
+    $$PWD/QSizeFormater.cpp \
+    $$PWD/filesystemmodel.cpp \
+    $$PWD/dirfilterproxymodel.cpp \
+    $$PWD/QtExt/qduoled.cpp \
+    $$PWD/ArchiveTools/qlibarchive.cpp \
+    $$PWD/settingsdialog.cpp \
+    $$PWD/ArchiveTools/libachivesettingswidget.cpp \
+    $$PWD/Codecs/qenca.cpp \
+    $$PWD/QtExt/qclickablelabel.cpp \
+    $$PWD/Codecs/unzipreverseencoder.cpp \
+    $$PWD/QtExt/qbargraf.cpp \
+    $$PWD/propertiesdialog.cpp \
+    $$PWD/ArchiveTools/singlefilecompression.cpp \
+    $$PWD/ArchiveTools/archivefilesource.cpp \
+    $$PWD/ArchiveTools/ziprewriter.cpp \
+    $$PWD/ArchiveTools/archiveappender.cpp \
+    $$PWD/ArchiveTools/archivecompactor.cpp \
+    $$PWD/ArchiveTools/filescanner.cpp \
+    $$PWD/QtExt/qcbmessagebox.cpp \
+    $$PWD/listingcache.cpp \
+    $$PWD/archiveentrystore.cpp \
+    $$PWD/archivesearchindex.cpp \
+    $$PWD/archivesearchmodel.cpp \
+    $$PWD/searchframe.cpp \
+    $$PWD/selectionmatcher.cpp \
+    $$PWD/progresschannel.cpp
+
+HEADERS += \
+    $$PWD/mainwindow.h \
+    $$PWD/ArchiveTools/archiveinterface.h \
+    $$PWD/ArchiveTools/cliinterface.h \
+    $$PWD/ArchiveTools/clirarplugin.h \
+    $$PWD/ArchiveTools/cli7zplugin.h \
+    $$PWD/ArchiveTools/clizipplugin.h \
+    $$PWD/queries.h \
+    $$PWD/archivemodel.h \
+    $$PWD/QSizeFormater.h \
+    $$PWD/iconprovider.h \
+    $$PWD/Codecs/textencoder.h \
+    $$PWD/Codecs/qibm852codec.h \
+    $$PWD/jobs.h \
+    $$PWD/overwritedialog.h \
+    $$PWD/extractdialog.h \
+    $$PWD/openarguments.h \
+    $$PWD/progressdialog.h \
+    $$PWD/qstandarddirs.h \
+    $$PWD/QtExt/qled.h \
+    $$PWD/testresultdialog.h \
+    $$PWD/archivetoolmanager.h \
+    $$PWD/addtoarchive.h \
+    $$PWD/jobinterface.h \
+    $$PWD/adddialog.h \
+    $$PWD/qarchive.h \
+    $$PWD/QtExt/qrecentfilesmenu.h \
+    $$PWD/infoframe.h \
+    $$PWD/filesystemmodel.h \
+    $$PWD/dirfilterproxymodel.h \
+    $$PWD/QtExt/qduoled.h \
+    $$PWD/ArchiveTools/qlibarchive.h \
+    $$PWD/settingsdialog.h \
+    $$PWD/ArchiveTools/libachivesettingswidget.h \
+    $$PWD/Codecs/qenca.h \
+    $$PWD/QtExt/qclickablelabel.h \
+    $$PWD/Codecs/unzipreverseencoder.h \
+    $$PWD/QtExt/qbargraf.h \
+    $$PWD/propertiesdialog.h \
+    $$PWD/ArchiveTools/singlefilecompression.h \
+    $$PWD/ArchiveTools/archivefilesource.h \
+    $$PWD/ArchiveTools/ziprewriter.h \
+    $$PWD/ArchiveTools/archiveappender.h \
+    $$PWD/ArchiveTools/archivecompactor.h \
+    $$PWD/ArchiveTools/filescanner.h \
+    $$PWD/QtExt/qcbmessagebox.h \
+    $$PWD/listingcache.h \
+    $$PWD/archiveentrystore.h \
+    $$PWD/archivesearchindex.h \
+    $$PWD/archivesearchmodel.h \
+    $$PWD/searchframe.h \
+    $$PWD/selectionmatcher.h \
+    $$PWD/progresschannel.h
+
+FORMS += \
+    $$PWD/mainwindow.ui \
+    $$PWD/overwritedialog.ui \
+    $$PWD/extractdialog.ui \
+    $$PWD/progressdialog.ui \
+    $$PWD/testresultdialog.ui \
+    $$PWD/adddialog.ui \
+    $$PWD/infoframe.ui \
+    $$PWD/settingsdialog.ui \
+    $$PWD/propertiesdialog.ui
+
+RESOURCES += \
+    $$PWD/icons.qrc
+
+win32: LIBS += -lshell32 -lOle32 -lUser32
+
+unix: LIBS += -larchive -lenca -lQtMimeTypes
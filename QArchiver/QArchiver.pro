@@ -6,107 +6,15 @@
 
 QT       += core gui
 
-greaterThan(QT_MAJOR_VERSION, 4): QT += widgets
+greaterThan(QT_MAJOR_VERSION, 4): QT += widgets concurrent
 
 TARGET = qarchiver
 TEMPLATE = app
 
 
-SOURCES += main.cpp\
-        mainwindow.cpp \
-    ArchiveTools/archiveinterface.cpp \
-    ArchiveTools/cliinterface.cpp \
-    ArchiveTools/clirarplugin.cpp \
-    ArchiveTools/cli7zplugin.cpp \
-    ArchiveTools/clizipplugin.cpp \
-    queries.cpp \
-    archivemodel.cpp \
-    iconprovider.cpp \
-    Codecs/textencoder.cpp \
-    Codecs/qibm852codec.cpp \
-    jobs.cpp \
-    overwritedialog.cpp \
-    extractdialog.cpp \
-    openarguments.cpp \
-    progressdialog.cpp \
-    qstandarddirs.cpp \
-    QtExt/qled.cpp \
-    testresultdialog.cpp \
-    archivetoolmanager.cpp \
-    addtoarchive.cpp \
-    jobinterface.cpp \
-    adddialog.cpp \
-    qarchive.cpp \
-    QtExt/qrecentfilesmenu.cpp \
-    infoframe.cpp \
-    QSizeFormater.cpp \
-    filesystemmodel.cpp \
-    dirfilterproxymodel.cpp \
-    QtExt/qduoled.cpp \
-    ArchiveTools/qlibarchive.cpp \
-    settingsdialog.cpp \
-    ArchiveTools/libachivesettingswidget.cpp \
-    Codecs/qenca.cpp \
-    QtExt/qclickablelabel.cpp \
-    Codecs/unzipreverseencoder.cpp \
-    QtExt/qbargraf.cpp \
-    propertiesdialog.cpp \
-    ArchiveTools/singlefilecompression.cpp \
-    QtExt/qcbmessagebox.cpp
-
-HEADERS  += mainwindow.h \
-    ArchiveTools/archiveinterface.h \
-    ArchiveTools/cliinterface.h \
-    ArchiveTools/clirarplugin.h \
-    ArchiveTools/cli7zplugin.h \
-    ArchiveTools/clizipplugin.h \
-    queries.h \
-    archivemodel.h \
-    QSizeFormater.h \
-    iconprovider.h \
-    Codecs/textencoder.h \
-    Codecs/qibm852codec.h \
-    jobs.h \
-    overwritedialog.h \
-    extractdialog.h \
-    openarguments.h \
-    progressdialog.h \
-    qstandarddirs.h \
-    QtExt/qled.h \
-    testresultdialog.h \
-    archivetoolmanager.h \
-    addtoarchive.h \
-    jobinterface.h \
-    adddialog.h \
-    qarchive.h \
-    QtExt/qrecentfilesmenu.h \
-    infoframe.h \
-    filesystemmodel.h \
-    dirfilterproxymodel.h \
-    QtExt/qduoled.h \
-    ArchiveTools/qlibarchive.h \
-    settingsdialog.h \
-    ArchiveTools/libachivesettingswidget.h \
-    Codecs/qenca.h \
-    QtExt/qclickablelabel.h \
-    Codecs/unzipreverseencoder.h \
-    QtExt/qbargraf.h \
-    propertiesdialog.h \
-    ArchiveTools/singlefilecompression.h \
-    QtExt/qcbmessagebox.h
-
-FORMS    += mainwindow.ui \
-    overwritedialog.ui \
-    extractdialog.ui \
-    progressdialog.ui \
-    testresultdialog.ui \
-    adddialog.ui \
-    infoframe.ui \
-    settingsdialog.ui \
-    propertiesdialog.ui
-
-RESOURCES += \
-    icons.qrc
+SOURCES += main.cpp
+
+include(QArchiver.pri)
 
 OTHER_FILES += \
     QArchiver.desktop \
@@ -145,10 +53,6 @@ OTHER_FILES += \
     icons/COPYING.icons.txt \
     ChangeLog.txt
 
-win32: LIBS += -lshell32 -lOle32 -lUser32
-
-unix: LIBS += -larchive -lenca -lQtMimeTypes
-
 unix {
 
 ## Spustitelny soubor aplikace
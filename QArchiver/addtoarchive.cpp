@@ -15,7 +15,8 @@
 #include "jobs.h"
 
 AddToArchive::AddToArchive(QObject *parent) :
-    QJob(parent)
+    QJob(parent),
+    m_addMode(AddReplace)
 {
 }
 
@@ -46,6 +47,12 @@ void AddToArchive::setStorePaths(bool value)
     m_storePaths = value;
 }
 
+// AddOptions: AddReplace, AddNew (update), AddExisting (freshen)
+void AddToArchive::setAddMode(int mode)
+{
+    m_addMode = mode;
+}
+
 void AddToArchive::connectDialog(ProgressDialog *dialog)
 {
     m_dialog = dialog;
@@ -181,6 +188,7 @@ void AddToArchive::slotStartJob(void)
 
     options[QLatin1String( "GlobalWorkDir" )] = stripDir.path();
     qDebug() << "Setting options[\"GlobalWorkDir\"] to " << stripDir.path();
+    options[QLatin1String( "AddMode" )] = m_addMode;
 
 
     AddJob *job = archive->addFiles(m_inputs, options);
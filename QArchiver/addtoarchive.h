@@ -18,6 +18,7 @@ public:
 
     bool showAddDialog();
     void setStorePaths(bool value);
+    void setAddMode(int mode);
     void connectDialog(ProgressDialog *dialog);
 
 signals:
@@ -43,6 +44,7 @@ private:
     QString m_mimeType;
     QStringList m_inputs;
     bool m_storePaths;
+    int m_addMode;
 };
 
 #endif // ADDTOARCHIVE_H
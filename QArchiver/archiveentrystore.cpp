@@ -0,0 +1,450 @@
+#include "archiveentrystore.h"
+
+#include <QDataStream>
+#include <QDateTime>
+#include <QStringList>
+
+/* CRC as the CLI programs print it, it can be stored as a number */
+static bool isHexCrc(const QString &crc)
+{
+    if (crc.length() != 8) {
+        return false;
+    }
+    for (int i = 0; i < 8; ++i) {
+        const ushort c = crc.at(i).unicode();
+        if (!((c >= '0' && c <= '9') || (c >= 'A' && c <= 'F'))) {
+            return false;
+        }
+    }
+    return true;
+}
+
+StringPool::StringPool()
+{
+    clear();
+}
+
+quint32 StringPool::intern(const QString &str)
+{
+    if (str.isEmpty()) {
+        return 0;
+    }
+
+    QHash<QString, quint32>::const_iterator it = m_ids.constFind(str);
+    if (it != m_ids.constEnd()) {
+        return it.value();
+    }
+
+    const quint32 id = m_strings.size();
+    m_strings.append(str);
+    m_ids.insert(str, id);
+    return id;
+}
+
+int StringPool::find(const QString &str) const
+{
+    if (str.isEmpty()) {
+        return 0;
+    }
+    return m_ids.value(str, -1);
+}
+
+void StringPool::clear()
+{
+    m_strings.clear();
+    m_ids.clear();
+    m_strings.append(QString());
+}
+
+void StringPool::swap(StringPool &other)
+{
+    qSwap(m_strings, other.m_strings);
+    qSwap(m_ids, other.m_ids);
+}
+
+void StringPool::save(QDataStream &out) const
+{
+    out << m_strings;
+}
+
+bool StringPool::load(QDataStream &in)
+{
+    QVector<QString> strings;
+    in >> strings;
+    if (in.status() != QDataStream::Ok || strings.isEmpty() || !strings.first().isEmpty()) {
+        return false;
+    }
+
+    QHash<QString, quint32> ids;
+    ids.reserve(strings.size());
+    for (int id = 1; id < strings.size(); ++id) {
+        ids.insert(strings.at(id), id);
+    }
+
+    qSwap(m_strings, strings);
+    qSwap(m_ids, ids);
+    return true;
+}
+
+
+ArchiveEntryStore::ArchiveEntryStore()
+{
+}
+
+int ArchiveEntryStore::append(const ArchiveEntry &entry)
+{
+    const int id = m_path.size();
+
+    m_path.append(QString());
+    m_name.append(0);
+    m_flags.append(0);
+    m_size.append(0);
+    m_compressedSize.append(0);
+    m_mtime.append(0);
+    m_permissions.append(0);
+    m_owner.append(0);
+    m_group.append(0);
+    m_method.append(0);
+    m_version.append(0);
+    m_crc.append(0);
+    m_ratio.append(0);
+
+    set(id, entry);
+    return id;
+}
+
+void ArchiveEntryStore::update(int id, const ArchiveEntry &entry)
+{
+    m_extra.remove(id);
+    set(id, entry);
+}
+
+void ArchiveEntryStore::set(int id, const ArchiveEntry &entry)
+{
+    quint32 flags = 0;
+    ArchiveEntry extra;
+
+    ArchiveEntry::const_iterator it = entry.constBegin();
+    for (; it != entry.constEnd(); ++it) {
+        const QVariant &v = it.value();
+        switch (it.key()) {
+        case FileName: {
+            m_path[id] = v.toString();
+            const QStringList pieces = m_path.at(id).split(QLatin1Char( '/' ), QString::SkipEmptyParts);
+            m_name[id] = m_names.intern(pieces.isEmpty() ? QString() : pieces.last());
+            break;
+        }
+        case IsDirectory:
+            flags |= HasIsDirectory;
+            if (v.toBool()) {
+                flags |= IsDirFlag;
+            }
+            break;
+        case IsPasswordProtected:
+            flags |= HasIsPassword;
+            if (v.toBool()) {
+                flags |= IsPasswordFlag;
+            }
+            break;
+        case Size:
+            flags |= HasSize;
+            m_size[id] = v.toLongLong();
+            break;
+        case CompressedSize:
+            flags |= HasCompressedSize;
+            m_compressedSize[id] = v.toLongLong();
+            break;
+        case Timestamp:
+            flags |= HasTimestamp;
+            m_mtime[id] = v.toDateTime().toMSecsSinceEpoch();
+            break;
+        case Permissions:
+            flags |= HasPermissions;
+            m_permissions[id] = m_strings.intern(v.toString());
+            break;
+        case Owner:
+            flags |= HasOwner;
+            m_owner[id] = m_strings.intern(v.toString());
+            break;
+        case Group:
+            flags |= HasGroup;
+            m_group[id] = m_strings.intern(v.toString());
+            break;
+        case Method:
+            flags |= HasMethod;
+            m_method[id] = m_strings.intern(v.toString());
+            break;
+        case Version:
+            flags |= HasVersion;
+            m_version[id] = m_strings.intern(v.toString());
+            break;
+        case CRC: {
+            flags |= HasCRC;
+            const QString crc = v.toString();
+            if (isHexCrc(crc)) {
+                m_crc[id] = crc.toUInt(0, 16);
+            } else {
+                flags |= CrcIsString;
+                m_crc[id] = m_strings.intern(crc);
+            }
+            break;
+        }
+        case Ratio:
+            flags |= HasRatio;
+            m_ratio[id] = m_strings.intern(v.toString());
+            break;
+        case Link:
+            flags |= HasLink;
+            extra.insert(it.key(), v);
+            break;
+        case InternalID:
+            flags |= HasInternalID;
+            if (v.type() != QVariant::String || v.toString() != entry.value(FileName).toString()) {
+                extra.insert(it.key(), v);
+            }
+            break;
+        default:
+            extra.insert(it.key(), v);
+            break;
+        }
+    }
+
+    m_flags[id] = flags;
+    if (!extra.isEmpty()) {
+        m_extra.insert(id, extra);
+    }
+}
+
+ArchiveEntry ArchiveEntryStore::entry(int id) const
+{
+    ArchiveEntry e = m_extra.value(id);
+    const quint32 flags = m_flags.at(id);
+
+    if (!m_path.at(id).isEmpty()) {
+        e[FileName] = m_path.at(id);
+    }
+    if ((flags & HasInternalID) && !e.contains(InternalID)) {
+        e[InternalID] = m_path.at(id);
+    }
+    if (flags & HasIsDirectory) {
+        e[IsDirectory] = bool(flags & IsDirFlag);
+    }
+    if (flags & HasIsPassword) {
+        e[IsPasswordProtected] = bool(flags & IsPasswordFlag);
+    }
+    if (flags & HasSize) {
+        e[Size] = m_size.at(id);
+    }
+    if (flags & HasCompressedSize) {
+        e[CompressedSize] = m_compressedSize.at(id);
+    }
+    if (flags & HasTimestamp) {
+        e[Timestamp] = QDateTime::fromMSecsSinceEpoch(m_mtime.at(id));
+    }
+    if (flags & HasPermissions) {
+        e[Permissions] = m_strings.string(m_permissions.at(id));
+    }
+    if (flags & HasOwner) {
+        e[Owner] = m_strings.string(m_owner.at(id));
+    }
+    if (flags & HasGroup) {
+        e[Group] = m_strings.string(m_group.at(id));
+    }
+    if (flags & HasMethod) {
+        e[Method] = m_strings.string(m_method.at(id));
+    }
+    if (flags & HasVersion) {
+        e[Version] = m_strings.string(m_version.at(id));
+    }
+    if (flags & HasCRC) {
+        e[CRC] = crc(id);
+    }
+    if (flags & HasRatio) {
+        e[Ratio] = m_strings.string(m_ratio.at(id));
+    }
+
+    return e;
+}
+
+QString ArchiveEntryStore::crc(int id) const
+{
+    if (m_flags.at(id) & CrcIsString) {
+        return m_strings.string(m_crc.at(id));
+    }
+    return QString::fromLatin1("%1").arg(m_crc.at(id), 8, 16, QLatin1Char('0')).toUpper();
+}
+
+QVariant ArchiveEntryStore::value(int id, int column) const
+{
+    if (!contains(id, column)) {
+        return QVariant();
+    }
+
+    switch (column) {
+    case FileName:
+        return m_path.at(id);
+    case IsDirectory:
+        return isDir(id);
+    case IsPasswordProtected:
+        return isPasswordProtected(id);
+    case Size:
+        return m_size.at(id);
+    case CompressedSize:
+        return m_compressedSize.at(id);
+    case Timestamp:
+        return QDateTime::fromMSecsSinceEpoch(m_mtime.at(id));
+    case Permissions:
+        return m_strings.string(m_permissions.at(id));
+    case Owner:
+        return m_strings.string(m_owner.at(id));
+    case Group:
+        return m_strings.string(m_group.at(id));
+    case Method:
+        return m_strings.string(m_method.at(id));
+    case Version:
+        return m_strings.string(m_version.at(id));
+    case CRC:
+        return crc(id);
+    case Ratio:
+        return m_strings.string(m_ratio.at(id));
+    case InternalID:
+        return m_extra.value(id).value(InternalID, m_path.at(id));
+    default:
+        return m_extra.value(id).value(column);
+    }
+}
+
+bool ArchiveEntryStore::contains(int id, int column) const
+{
+    const quint32 flags = m_flags.at(id);
+
+    switch (column) {
+    case FileName:
+        return !m_path.at(id).isEmpty();
+    case IsDirectory:
+        return flags & HasIsDirectory;
+    case IsPasswordProtected:
+        return flags & HasIsPassword;
+    case Size:
+        return flags & HasSize;
+    case CompressedSize:
+        return flags & HasCompressedSize;
+    case Timestamp:
+        return flags & HasTimestamp;
+    case Permissions:
+        return flags & HasPermissions;
+    case Owner:
+        return flags & HasOwner;
+    case Group:
+        return flags & HasGroup;
+    case Method:
+        return flags & HasMethod;
+    case Version:
+        return flags & HasVersion;
+    case CRC:
+        return flags & HasCRC;
+    case Ratio:
+        return flags & HasRatio;
+    case InternalID:
+        return flags & HasInternalID;
+    case Link:
+        return flags & HasLink;
+    default:
+        return m_extra.value(id).contains(column);
+    }
+}
+
+int ArchiveEntryStore::count() const
+{
+    return m_path.size();
+}
+
+void ArchiveEntryStore::clear()
+{
+    m_path.clear();
+    m_name.clear();
+    m_flags.clear();
+    m_size.clear();
+    m_compressedSize.clear();
+    m_mtime.clear();
+    m_permissions.clear();
+    m_owner.clear();
+    m_group.clear();
+    m_method.clear();
+    m_version.clear();
+    m_crc.clear();
+    m_ratio.clear();
+    m_names.clear();
+    m_strings.clear();
+    m_extra.clear();
+}
+
+/* Exchange the contents, containers are shared so no data is copied */
+void ArchiveEntryStore::swap(ArchiveEntryStore &other)
+{
+    qSwap(m_path, other.m_path);
+    qSwap(m_name, other.m_name);
+    qSwap(m_flags, other.m_flags);
+    qSwap(m_size, other.m_size);
+    qSwap(m_compressedSize, other.m_compressedSize);
+    qSwap(m_mtime, other.m_mtime);
+    qSwap(m_permissions, other.m_permissions);
+    qSwap(m_owner, other.m_owner);
+    qSwap(m_group, other.m_group);
+    qSwap(m_method, other.m_method);
+    qSwap(m_version, other.m_version);
+    qSwap(m_crc, other.m_crc);
+    qSwap(m_ratio, other.m_ratio);
+    m_names.swap(other.m_names);
+    m_strings.swap(other.m_strings);
+    qSwap(m_extra, other.m_extra);
+}
+
+void ArchiveEntryStore::save(QDataStream &out) const
+{
+    m_names.save(out);
+    m_strings.save(out);
+    out << m_path << m_name << m_flags << m_size << m_compressedSize << m_mtime
+        << m_permissions << m_owner << m_group << m_method << m_version << m_crc << m_ratio
+        << m_extra;
+}
+
+/* Ids of the string columns are checked, the file may be damaged */
+bool ArchiveEntryStore::load(QDataStream &in)
+{
+    ArchiveEntryStore store;
+    if (!store.m_names.load(in) || !store.m_strings.load(in)) {
+        return false;
+    }
+    in >> store.m_path >> store.m_name >> store.m_flags >> store.m_size >> store.m_compressedSize >> store.m_mtime
+       >> store.m_permissions >> store.m_owner >> store.m_group >> store.m_method >> store.m_version >> store.m_crc >> store.m_ratio
+       >> store.m_extra;
+    if (in.status() != QDataStream::Ok) {
+        return false;
+    }
+
+    const int count = store.m_path.size();
+    if (store.m_name.size() != count || store.m_flags.size() != count || store.m_size.size() != count
+            || store.m_compressedSize.size() != count || store.m_mtime.size() != count
+            || store.m_permissions.size() != count || store.m_owner.size() != count
+            || store.m_group.size() != count || store.m_method.size() != count
+            || store.m_version.size() != count || store.m_crc.size() != count
+            || store.m_ratio.size() != count) {
+        return false;
+    }
+
+    const quint32 names = store.m_names.count();
+    const quint32 strings = store.m_strings.count();
+    for (int id = 0; id < count; ++id) {
+        if (store.m_name.at(id) >= names || store.m_permissions.at(id) >= strings
+                || store.m_owner.at(id) >= strings || store.m_group.at(id) >= strings
+                || store.m_method.at(id) >= strings || store.m_version.at(id) >= strings
+                || store.m_ratio.at(id) >= strings
+                || ((store.m_flags.at(id) & CrcIsString) && store.m_crc.at(id) >= strings)) {
+            return false;
+        }
+    }
+
+    swap(store);
+    return true;
+}
@@ -0,0 +1,163 @@
+#ifndef ARCHIVEENTRYSTORE_H
+#define ARCHIVEENTRYSTORE_H
+
+#include <QHash>
+#include <QString>
+#include <QVector>
+
+#include "qarchive.h"
+
+class QDataStream;
+
+/* Interned strings, id 0 is an empty string */
+class StringPool
+{
+public:
+    StringPool();
+
+    quint32 intern(const QString &str);
+    int find(const QString &str) const;
+    const QString &string(quint32 id) const
+    {
+        return m_strings.at(id);
+    }
+    int count() const
+    {
+        return m_strings.size();
+    }
+    void clear();
+    void swap(StringPool &other);
+    void save(QDataStream &out) const;
+    bool load(QDataStream &in);
+
+private:
+    QVector<QString> m_strings;
+    QHash<QString, quint32> m_ids;
+};
+
+
+/*
+ * Column (struct-of-arrays) store of the archive entries used by ArchiveModel.
+ * Entry is addressed by row id, ArchiveEntry is only a view created on demand.
+ */
+class ArchiveEntryStore
+{
+public:
+    enum Flag {
+        IsDirFlag           = 0x0001,
+        IsPasswordFlag      = 0x0002,
+        HasSize             = 0x0004,
+        HasCompressedSize   = 0x0008,
+        HasTimestamp        = 0x0010,
+        HasPermissions      = 0x0020,
+        HasOwner            = 0x0040,
+        HasGroup            = 0x0080,
+        HasMethod           = 0x0100,
+        HasVersion          = 0x0200,
+        HasIsDirectory      = 0x0400,
+        HasIsPassword       = 0x0800,
+        HasInternalID       = 0x1000,
+        HasLink             = 0x2000,
+        HasCRC              = 0x4000,
+        HasRatio            = 0x8000,
+        CrcIsString         = 0x10000  // m_crc is an id in m_strings
+    };
+
+    ArchiveEntryStore();
+
+    int append(const ArchiveEntry &entry);
+    void update(int id, const ArchiveEntry &entry);
+    ArchiveEntry entry(int id) const;
+    QVariant value(int id, int column) const;
+    bool contains(int id, int column) const;
+    int count() const;
+    void clear();
+    void swap(ArchiveEntryStore &other);
+    // String tables and columns as they are (listing cache)
+    void save(QDataStream &out) const;
+    bool load(QDataStream &in);
+
+    const QString &fileName(int id) const
+    {
+        return m_path.at(id);
+    }
+
+    const QString &name(int id) const
+    {
+        return m_names.string(m_name.at(id));
+    }
+
+    quint32 nameId(int id) const
+    {
+        return m_name.at(id);
+    }
+
+    // -1 if no entry has this name
+    int findNameId(const QString &name) const
+    {
+        return m_names.find(name);
+    }
+
+    bool isDir(int id) const
+    {
+        return m_flags.at(id) & IsDirFlag;
+    }
+
+    bool isPasswordProtected(int id) const
+    {
+        return m_flags.at(id) & IsPasswordFlag;
+    }
+
+    bool hasLink(int id) const
+    {
+        return m_flags.at(id) & HasLink;
+    }
+
+    qint64 size(int id) const
+    {
+        return m_size.at(id);
+    }
+
+    qint64 compressedSize(int id) const
+    {
+        return m_compressedSize.at(id);
+    }
+
+    void setCompressedSize(int id, qint64 size)
+    {
+        m_flags[id] |= HasCompressedSize;
+        m_compressedSize[id] = size;
+    }
+
+    // ms since epoch
+    qint64 mtime(int id) const
+    {
+        return m_mtime.at(id);
+    }
+
+private:
+    void set(int id, const ArchiveEntry &entry);
+    QString crc(int id) const;
+
+    QVector<QString> m_path;
+    QVector<quint32> m_name;
+    QVector<quint32> m_flags;
+    QVector<qint64>  m_size;
+    QVector<qint64>  m_compressedSize;
+    QVector<qint64>  m_mtime;
+    QVector<quint32> m_permissions;
+    QVector<quint32> m_owner;
+    QVector<quint32> m_group;
+    QVector<quint32> m_method;
+    QVector<quint32> m_version;
+    QVector<quint32> m_crc;     // 8 hex digits as a number
+    QVector<quint32> m_ratio;
+
+    StringPool m_names;
+    StringPool m_strings; // permissions, owner, group, method, version, ratio
+
+    // InternalID (if different from FileName), Link, Comment, Custom...
+    QHash<int, ArchiveEntry> m_extra;
+};
+
+#endif // ARCHIVEENTRYSTORE_H
@@ -3,6 +3,7 @@
 #include "ArchiveTools/archiveinterface.h"
 #include "jobs.h"
 #include "iconprovider.h"
+#include "archiveentrystore.h"
 
 #include <QUrl>
 #include <QDir>
@@ -15,41 +16,101 @@
 #include <QPersistentModelIndex>
 #include <QPixmap>
 #include <QFileIconProvider>
+#include <QElapsedTimer>
+#include <QTimer>
+#include <QThread>
+#include <QMutex>
+#include <QFuture>
+#include <QtConcurrentRun>
+#include <QtConcurrentMap>
+#if (QT_VERSION >= QT_VERSION_CHECK(5, 2, 0))
+#include <QCollator>
+#endif
 #include <QDebug>
 
+#include <algorithm>
+#include <vector>
+
+// Time spent on adding queued entries before the views get control back (ms)
+static const int c_populateSliceTime = 15;
+// Listings with more entries are built by ArchiveTreeBuilder
+static const int c_treeBuilderMinEntries = 20000;
+// Smallest part of the path list sorted by one thread
+static const int c_sortChunkMinEntries = 16384;
+// Nodes in the model to sort directories on more threads
+static const int c_parallelSortMinEntries = 10000;
+
 class ArchiveDirNode;
 
+/* Counts and sizes of a subtree */
+struct DirTotals
+{
+    DirTotals()
+        : dirs(0)
+        , files(0)
+        , size(0)
+        , compressedSize(0)
+    {
+    }
+
+    void add(const DirTotals &other)
+    {
+        dirs += other.dirs;
+        files += other.files;
+        size += other.size;
+        compressedSize += other.compressedSize;
+    }
+
+    void subtract(const DirTotals &other)
+    {
+        dirs -= other.dirs;
+        files -= other.files;
+        size -= other.size;
+        compressedSize -= other.compressedSize;
+    }
+
+    int    dirs;
+    int    files;
+    qint64 size;
+    qint64 compressedSize;
+};
+
 class ArchiveNode
 {
 public:
-    ArchiveNode(ArchiveDirNode *parent, const ArchiveEntry & entry)
+    ArchiveNode(ArchiveDirNode *parent, ArchiveEntryStore *store, const ArchiveEntry & entry)
         : m_parent(parent)
+        , m_store(store)
+        , m_id(store->append(entry))
+        , m_row(0)
     {
-        setEntry(entry);
     }
 
-    virtual ~ArchiveNode()
+    // Node of an entry already in the store
+    ArchiveNode(ArchiveDirNode *parent, ArchiveEntryStore *store, int id)
+        : m_parent(parent)
+        , m_store(store)
+        , m_id(id)
+        , m_row(0)
     {
     }
 
-    const ArchiveEntry &entry() const
+    virtual ~ArchiveNode()
     {
-        return m_entry;
     }
 
-    void setEntry(const ArchiveEntry& entry)
+    // View of the entry data stored in the ArchiveEntryStore
+    ArchiveEntry entry() const
     {
-        m_entry = entry;
+        return m_store->entry(m_id);
+    }
 
-        const QStringList pieces = entry[FileName].toString().split(QLatin1Char( '/' ), QString::SkipEmptyParts);
-        m_name = pieces.isEmpty() ? QString() : pieces.last();
+    void setEntry(const ArchiveEntry& entry);
 
-        if (entry[IsDirectory].toBool()) {
-            // Singleton IconProvider -> cached icons, icons of nonexisting files
-            m_icon = IconProvider::Instance()->dirIcon().pixmap(16, 16);
-        } else {
-            m_icon = IconProvider::Instance()->fileIcon(m_entry[FileName].toString()).pixmap(16, 16);
-        }
+    // Row id in the ArchiveEntryStore
+    int id() const
+    {
+        return m_id;
     }
 
     ArchiveDirNode *parent() const
@@ -57,42 +118,68 @@ public:
         return m_parent;
     }
 
-    int row() const;
+    // Row in the parent node, kept up to date by ArchiveDirNode
+    int row() const
+    {
+        return m_row;
+    }
+
+    void setRow(int row)
+    {
+        m_row = row;
+    }
 
     virtual bool isDir() const
     {
         return false;
     }
 
-    QPixmap icon() const
+    QString name() const
     {
-        return m_icon;
+        return m_store->name(m_id);
     }
 
-    QString name() const
+    // What the node adds to the totals of its parent directories
+    virtual DirTotals totals() const
     {
-        return m_name;
+        DirTotals t;
+        t.files = 1;
+        t.size = m_store->size(m_id);
+        t.compressedSize = m_store->compressedSize(m_id);
+        return t;
     }
 
 protected:
-    void setIcon(const QPixmap &icon)
+    ArchiveEntryStore *store() const
     {
-        m_icon = icon;
+        return m_store;
     }
 
 private:
-    ArchiveEntry    m_entry;
-    QPixmap         m_icon;
-    QString         m_name;
-    ArchiveDirNode *m_parent;
+    ArchiveDirNode    *m_parent;
+    ArchiveEntryStore *m_store;
+    int                m_id;
+    int                m_row;
 };
 
 
 class ArchiveDirNode: public ArchiveNode
 {
 public:
-    ArchiveDirNode(ArchiveDirNode *parent, const ArchiveEntry & entry)
-        : ArchiveNode(parent, entry)
+    ArchiveDirNode(ArchiveDirNode *parent, ArchiveEntryStore *store, const ArchiveEntry & entry)
+        : ArchiveNode(parent, store, entry)
+        , m_dirCount(0)
+        , m_fileCount(0)
+        , m_fetched(true)
+    {
+    }
+
+    // Children are created by ArchiveModel::fetchMore()
+    ArchiveDirNode(ArchiveDirNode *parent, ArchiveEntryStore *store, int id)
+        : ArchiveNode(parent, store, id)
+        , m_dirCount(0)
+        , m_fileCount(0)
+        , m_fetched(false)
     {
     }
 
@@ -101,7 +188,7 @@ public:
         clear();
     }
 
-    QList<ArchiveNode*> entries()
+    const QList<ArchiveNode*> &entries() const
     {
         return m_entries;
     }
@@ -109,16 +196,62 @@ public:
     void setEntryAt(int index, ArchiveNode* value)
     {
         m_entries[index] = value;
+        value->setRow(index);
     }
 
     void appendEntry(ArchiveNode* entry)
     {
+        entry->setRow(m_entries.count());
         m_entries.append(entry);
+        indexEntry(entry);
+
+        countChild(entry->isDir(), 1);
+        addToTotals(entry->totals());
+    }
+
+    // Name id given by the caller, the store of the node is not used
+    // and the child is not counted (see countChild() and addToTotals())
+    void appendEntry(ArchiveNode* entry, quint32 nameId)
+    {
+        entry->setRow(m_entries.count());
+        m_entries.append(entry);
+        if (!m_index.contains(nameId)) {
+            m_index.insert(nameId, entry);
+        }
+    }
+
+    // Children from the row on, the name index is kept
+    QList<ArchiveNode*> takeEntriesFrom(int row)
+    {
+        const QList<ArchiveNode*> tail = m_entries.mid(row);
+        m_entries.erase(m_entries.begin() + row, m_entries.end());
+        return tail;
+    }
+
+    // Put back children taken by takeEntriesFrom()
+    void restoreEntries(const QList<ArchiveNode*> &tail)
+    {
+        m_entries.append(tail);
     }
 
     void removeEntryAt(int index)
     {
-        delete m_entries.takeAt(index);
+        ArchiveNode *entry = m_entries.takeAt(index);
+        unindexEntry(entry, store()->nameId(entry->id()));
+        countChild(entry->isDir(), -1);
+        removeFromTotals(entry->totals());
+        delete entry;
+
+        for (int i = index; i < m_entries.count(); ++i) {
+            m_entries.at(i)->setRow(i);
+        }
+    }
+
+    // Name of the child node has been changed
+    void reindexEntry(ArchiveNode* entry, quint32 oldNameId)
+    {
+        unindexEntry(entry, oldNameId);
+        indexEntry(entry);
     }
 
     virtual bool isDir() const
@@ -126,14 +259,82 @@ public:
         return true;
     }
 
-    ArchiveNode* find(const QString & name)
+    bool isFetched() const
     {
-        foreach(ArchiveNode *node, m_entries) {
-            if (node && (node->name() == name)) {
-                return node;
-            }
+        return m_fetched;
+    }
+
+    // Direct children
+    int dirCount() const
+    {
+        return m_dirCount;
+    }
+
+    int fileCount() const
+    {
+        return m_fileCount;
+    }
+
+    void setCounts(int dirs, int files)
+    {
+        m_dirCount = dirs;
+        m_fileCount = files;
+    }
+
+    void countChild(bool isDir, int count)
+    {
+        if (isDir) {
+            m_dirCount += count;
+        } else {
+            m_fileCount += count;
+        }
+    }
+
+    // Whole subtree, kept when the children are released
+    const DirTotals &subtreeTotals() const
+    {
+        return m_totals;
+    }
+
+    void setSubtreeTotals(const DirTotals &totals)
+    {
+        m_totals = totals;
+    }
+
+    // Change the totals of this directory and all its parents
+    void addToTotals(const DirTotals &delta)
+    {
+        for (ArchiveDirNode *dir = this; dir; dir = dir->parent()) {
+            dir->m_totals.add(delta);
+        }
+    }
+
+    void removeFromTotals(const DirTotals &delta)
+    {
+        for (ArchiveDirNode *dir = this; dir; dir = dir->parent()) {
+            dir->m_totals.subtract(delta);
         }
-        return 0;
+    }
+
+    virtual DirTotals totals() const
+    {
+        DirTotals t = m_totals;
+        t.dirs += 1;
+        return t;
+    }
+
+    void setFetched(bool fetched)
+    {
+        m_fetched = fetched;
+    }
+
+    ArchiveNode* find(const QString & name) const
+    {
+        const int nameId = store()->findNameId(name);
+        if (nameId < 0) {
+            return 0;
+        }
+        return m_index.value(nameId, 0);
     }
 
     ArchiveNode* findByPath(const QStringList & pieces, int index = 0)
@@ -167,93 +368,564 @@ public:
     {
         qDeleteAll(m_entries);
         m_entries.clear();
+        m_index.clear();
     }
 
 private:
+    void indexEntry(ArchiveNode* entry)
+    {
+        // The first child with the name wins (as in linear search)
+        const quint32 nameId = store()->nameId(entry->id());
+        if (!m_index.contains(nameId)) {
+            m_index.insert(nameId, entry);
+        }
+    }
+
+    void unindexEntry(ArchiveNode* entry, quint32 nameId)
+    {
+        if (m_index.value(nameId, 0) != entry) {
+            return;
+        }
+        m_index.remove(nameId);
+
+        // Another child with the same name
+        foreach(ArchiveNode *node, m_entries) {
+            if (node != entry && store()->nameId(node->id()) == nameId) {
+                m_index.insert(nameId, node);
+                break;
+            }
+        }
+    }
+
     QList<ArchiveNode*> m_entries;
+    QHash<quint32, ArchiveNode*> m_index; // name id -> child
+    int m_dirCount;
+    int m_fileCount;
+    DirTotals m_totals;
+    bool m_fetched;
+};
+
+/*
+ * Path order of the lazy index, '/' sorts before any other character,
+ * so a directory entry is followed by its whole subtree.
+ */
+static int comparePaths(const QString &left, const QString &right)
+{
+    const int length = qMin(left.length(), right.length());
+    const QChar *l = left.unicode();
+    const QChar *r = right.unicode();
+
+    for (int i = 0; i < length; ++i) {
+        if (l[i] != r[i]) {
+            const ushort lc = (l[i] == QLatin1Char('/')) ? 0 : l[i].unicode();
+            const ushort rc = (r[i] == QLatin1Char('/')) ? 0 : r[i].unicode();
+            return lc < rc ? -1 : 1;
+        }
+    }
+    return left.length() - right.length();
+}
+
+/* The path is in the directory or in its subdirectory */
+static bool isParentPath(const QString &dir, const QString &path)
+{
+    return path.length() > dir.length() && path.at(dir.length()) == QLatin1Char('/') && path.startsWith(dir);
+}
+
+class PathLessThan
+{
+public:
+    explicit PathLessThan(const ArchiveEntryStore *store) :
+        m_store(store)
+    {
+    }
+
+    inline bool operator()(int left, int right) const
+    {
+        return comparePaths(m_store->fileName(left), m_store->fileName(right)) < 0;
+    }
+
+private:
+    const ArchiveEntryStore *m_store;
 };
 
+/* "file2" before "file10", digit runs are compared by value */
+static int naturalCompare(const QString &left, const QString &right)
+{
+    int l = 0;
+    int r = 0;
+    while (l < left.length() && r < right.length()) {
+        if (left.at(l).isDigit() && right.at(r).isDigit()) {
+            // Skip leading zeros, longer number is bigger
+            while (l < left.length() && left.at(l) == QLatin1Char('0')) ++l;
+            while (r < right.length() && right.at(r) == QLatin1Char('0')) ++r;
+            int lEnd = l;
+            int rEnd = r;
+            while (lEnd < left.length() && left.at(lEnd).isDigit()) ++lEnd;
+            while (rEnd < right.length() && right.at(rEnd).isDigit()) ++rEnd;
+            if (lEnd - l != rEnd - r) {
+                return (lEnd - l) - (rEnd - r);
+            }
+            for (; l < lEnd; ++l, ++r) {
+                if (left.at(l) != right.at(r)) {
+                    return left.at(l).unicode() - right.at(r).unicode();
+                }
+            }
+        } else {
+            if (left.at(l) != right.at(r)) {
+                return left.at(l).unicode() - right.at(r).unicode();
+            }
+            ++l;
+            ++r;
+        }
+    }
+    return (left.length() - l) - (right.length() - r);
+}
+
 /*
- * Helper functor used by qStableSort.
+ * Typed keys of the sorted column, computed once for every sorted node.
+ * Numbers are compared as qint64, names by collation keys.
+ */
+class SortKeys
+{
+public:
+    SortKeys(const ArchiveEntryStore *store, int column, bool naturalOrder)
+        : m_store(store)
+        , m_column(column)
+        , m_naturalOrder(naturalOrder)
+        , m_count(0)
+    {
+        switch (column) {
+        case FileName:
+            m_type = NameKey;
+            break;
+        case Size:
+        case CompressedSize:
+        case Timestamp:
+        case Ratio:
+            m_type = NumberKey;
+            break;
+        default:
+            m_type = TextKey;
+            break;
+        }
+
+#if (QT_VERSION >= QT_VERSION_CHECK(5, 2, 0))
+        m_collator.setNumericMode(m_naturalOrder);
+        m_collator.setCaseSensitivity(Qt::CaseInsensitive);
+#endif
+    }
+
+    // Position of the key of the node
+    int append(const ArchiveNode *node)
+    {
+        switch (m_type) {
+        case NumberKey:
+            m_numbers.append(numberKey(node));
+            break;
+        case NameKey:
+#if (QT_VERSION >= QT_VERSION_CHECK(5, 2, 0))
+            m_collationKeys.push_back(m_collator.sortKey(node->name()));
+#else
+            m_texts.append(node->name().toCaseFolded());
+#endif
+            break;
+        case TextKey:
+            m_texts.append(m_store->value(node->id(), m_column).toString());
+            break;
+        }
+        return m_count++;
+    }
+
+    int compare(int left, int right) const
+    {
+        switch (m_type) {
+        case NumberKey: {
+            const qint64 l = m_numbers.at(left);
+            const qint64 r = m_numbers.at(right);
+            return (l < r) ? -1 : (l > r);
+        }
+        case NameKey:
+#if (QT_VERSION >= QT_VERSION_CHECK(5, 2, 0))
+            return m_collationKeys.at(left).compare(m_collationKeys.at(right));
+#else
+            return m_naturalOrder ? naturalCompare(m_texts.at(left), m_texts.at(right))
+                                  : m_texts.at(left).compare(m_texts.at(right));
+#endif
+        default:
+            return m_texts.at(left).compare(m_texts.at(right));
+        }
+    }
+
+private:
+    enum KeyType { NumberKey, NameKey, TextKey };
+
+    qint64 numberKey(const ArchiveNode *node) const
+    {
+        const int id = node->id();
+        const bool isDir = node->isDir();
+
+        switch (m_column) {
+        case Size:
+            // Folders by the size of their content
+            return isDir ? static_cast<const ArchiveDirNode*>(node)->subtreeTotals().size : m_store->size(id);
+        case CompressedSize:
+            return isDir ? static_cast<const ArchiveDirNode*>(node)->subtreeTotals().compressedSize : m_store->compressedSize(id);
+        case Timestamp:
+            return m_store->mtime(id);
+        default: {
+            // Ratio as shown by ArchiveModel::data()
+            const qint64 size = m_store->size(id);
+            const qint64 compressedSize = m_store->compressedSize(id);
+            if (isDir || m_store->hasLink(id) || size == 0 || compressedSize == 0) {
+                return -1;
+            }
+            return qint64(100 * ((double)size - compressedSize) / size);
+        }
+        }
+    }
+
+    const ArchiveEntryStore *m_store;
+    int m_column;
+    bool m_naturalOrder;
+    KeyType m_type;
+    int m_count;
+    QVector<qint64> m_numbers;
+    QVector<QString> m_texts;
+#if (QT_VERSION >= QT_VERSION_CHECK(5, 2, 0))
+    QCollator m_collator;
+    std::vector<QCollatorSortKey> m_collationKeys; // no default constructor
+#endif
+};
+
+struct SortItem
+{
+    ArchiveNode *node;
+    int key;    // position in SortKeys
+    bool isDir;
+};
+
+/*
+ * Helper functor used by std::stable_sort.
  * It always sorts folders before files.
  * http://stackoverflow.com/questions/356950/c-functors-and-their-uses
  */
 class ArchiveModelSorter
 {
 public:
-    ArchiveModelSorter(int column, Qt::SortOrder order) :
-        m_sortColumn(column),
+    ArchiveModelSorter(const SortKeys *keys, Qt::SortOrder order) :
+        m_keys(keys),
         m_sortOrder(order)
     {
     }
 
-    virtual ~ArchiveModelSorter()
+    inline bool operator()(const SortItem &left, const SortItem &right) const
     {
-    }
+        // Sort folders before files
+        if (left.isDir != right.isDir) {
+            return left.isDir;
+        }
 
-    inline bool operator()(const QPair<ArchiveNode*, int> &left, const QPair<ArchiveNode*, int> &right) const
-    {
         if (m_sortOrder == Qt::AscendingOrder) {
-            return lessThan(left, right);
+            return m_keys->compare(left.key, right.key) < 0;
         } else {
-            return !lessThan(left, right);
+            return m_keys->compare(right.key, left.key) < 0;
         }
     }
 
+private:
+    const SortKeys *m_keys;
+    Qt::SortOrder m_sortOrder;
+};
+
+/* Children of one directory in the sorted items */
+struct SortRange
+{
+    ArchiveDirNode *dir;
+    SortItem *begin;
+    SortItem *end;
+    const ArchiveModelSorter *sorter;
+};
+
+static void sortRange(SortRange &range)
+{
+    std::stable_sort(range.begin, range.end, *range.sorter);
+}
+
+/* Order of the path keys, equal paths keep the order of arrival */
+class KeyLessThan
+{
+public:
+    explicit KeyLessThan(const QVector<QString> *keys) :
+        m_keys(keys)
+    {
+    }
+
+    inline bool operator()(int left, int right) const
+    {
+        const int result = comparePaths(m_keys->at(left), m_keys->at(right));
+        return result < 0 || (result == 0 && left < right);
+    }
+
+private:
+    const QVector<QString> *m_keys;
+};
+
+static void sortKeys(int *begin, int *end, KeyLessThan lessThan)
+{
+    std::sort(begin, end, lessThan);
+}
+
+static void mergeKeys(int *begin, int *middle, int *end, KeyLessThan lessThan)
+{
+    std::inplace_merge(begin, middle, end, lessThan);
+}
+
+/*
+ * Builds the whole tree from the listed entries on its own thread:
+ * the paths are sorted in parallel and the nodes are created in one sweep,
+ * where the sorted order lets consecutive entries share their parent directories.
+ *
+ * Entries are kept in a private store. The nodes already point to the store
+ * of the model (they do not touch it while being built), the model takes
+ * the root and swaps the stores contents on the GUI thread.
+ */
+class ArchiveTreeBuilder : public QThread
+{
+public:
+    ArchiveTreeBuilder(const ArchiveEntryList &entries, ArchiveEntryStore *target)
+        : m_entries(entries)
+        , m_target(target)
+        , m_root(0)
+        , m_cancel(false)
+    {
+    }
+
+    ~ArchiveTreeBuilder()
+    {
+        cancel();
+        wait();
+        delete m_root;
+    }
+
+    void cancel()
+    {
+        QMutexLocker locker(&m_mutex);
+        m_cancel = true;
+    }
+
+    ArchiveDirNode *takeRoot()
+    {
+        ArchiveDirNode *root = m_root;
+        m_root = 0;
+        return root;
+    }
+
+    ArchiveEntryStore &store()
+    {
+        return m_store;
+    }
+
 protected:
-    bool lessThan(const QPair<ArchiveNode*, int> &left, const QPair<ArchiveNode*, int> &right) const
+    void run()
     {
-        const ArchiveNode * const leftNode = left.first;
-        const ArchiveNode * const rightNode = right.first;
+        const int count = m_entries.count();
+
+        // Cleaned paths without empty pieces are the sort keys
+        QVector<QString> keys(count);
+        QVector<int> order;
+        order.reserve(count);
+        for (int i = 0; i < count; ++i) {
+            QString key = ArchiveModel::cleanFileName(m_entries.at(i).value(FileName).toString());
+            if (key.startsWith(QLatin1Char('/')) || key.endsWith(QLatin1Char('/'))
+                    || key.contains(QLatin1String("//"))) {
+                key = key.split(QLatin1Char('/'), QString::SkipEmptyParts).join(QLatin1String("/"));
+            }
+            if (!key.isEmpty()) {
+                keys[i] = key;
+                order.append(i);
+            }
+        }
 
-        // Sort folders before files
-        if ((leftNode->isDir()) && (!rightNode->isDir())) {
-            return (m_sortOrder == Qt::AscendingOrder);
-        } else if ((!leftNode->isDir()) && (rightNode->isDir())) {
-            return !(m_sortOrder == Qt::AscendingOrder);
+        sortOrder(&order, KeyLessThan(&keys));
+        if (isCanceled()) {
+            return;
         }
 
-        const QVariant &leftEntry = leftNode->entry()[m_sortColumn];
-        const QVariant &rightEntry = rightNode->entry()[m_sortColumn];
+        m_root = new ArchiveDirNode(0, m_target, m_store.append(ArchiveEntry()));
+        m_root->setFetched(true);
 
-        switch (m_sortColumn) {
-        case FileName:
-            return leftNode->name() < rightNode->name();
-        case Size:
-        case CompressedSize:
-            return leftEntry.toInt() < rightEntry.toInt();
-        default:
-            return leftEntry.toString() < rightEntry.toString();
+        // Directories from the root to the parent of the current entry
+        QVector<ArchiveDirNode*> dirs;
+        QVector<QString> dirPaths;
+        dirs.append(m_root);
+        dirPaths.append(QString());
+
+        const int n = order.count();
+        for (int k = 0; k < n; ++k) {
+            if ((k & 1023) == 0 && isCanceled()) {
+                return;
+            }
+
+            const QString &key = keys.at(order.at(k));
+            ArchiveEntry entry = m_entries.at(order.at(k));
+
+            // Multi-volume files are repeated at least in RAR archives,
+            // the last entry wins with the compressed size summed up
+            while (k + 1 < n && keys.at(order.at(k + 1)) == key) {
+                const qulonglong compressedSize = entry.value(CompressedSize).toULongLong();
+                entry = m_entries.at(order.at(++k));
+                entry[CompressedSize] = compressedSize + entry.value(CompressedSize).toULongLong();
+            }
+            entry[FileName] = ArchiveModel::cleanFileName(entry.value(FileName).toString());
+
+            // Leave directories which are not a prefix of the path
+            while (dirs.count() > 1 && !isParentPath(dirPaths.last(), key)) {
+                dirs.pop_back();
+                dirPaths.pop_back();
+            }
+
+            // Create directories without their own entry
+            int from = dirPaths.last().isEmpty() ? 0 : dirPaths.last().length() + 1;
+            int slash;
+            while ((slash = key.indexOf(QLatin1Char('/'), from)) >= 0) {
+                ArchiveEntry e;
+                e[ FileName ] = key.left(slash);
+                e[ IsDirectory ] = true;
+                dirs.append(static_cast<ArchiveDirNode*>(appendNode(dirs.last(), e, true)));
+                dirPaths.append(e[ FileName ].toString());
+                from = slash + 1;
+            }
+
+            // The entry is a directory, or its subtree follows
+            const bool hasChildren = (k + 1 < n) && isParentPath(key, keys.at(order.at(k + 1)));
+            const bool isDir = hasChildren || entry[ FileName ].toString().endsWith(QLatin1Char('/'))
+                    || entry.value(IsDirectory).toBool();
+
+            ArchiveNode *node = appendNode(dirs.last(), entry, isDir);
+            if (hasChildren) {
+                dirs.append(static_cast<ArchiveDirNode*>(node));
+                dirPaths.append(key);
+            }
         }
 
-        // Sem by se to nikdy nemělo dostat
-        Q_ASSERT(false);
-        return false;
+        // Entries are in the store now
+        m_entries.clear();
     }
 
 private:
-    int m_sortColumn;
-    Qt::SortOrder m_sortOrder;
+    bool isCanceled()
+    {
+        QMutexLocker locker(&m_mutex);
+        return m_cancel;
+    }
+
+    ArchiveNode *appendNode(ArchiveDirNode *parent, const ArchiveEntry &entry, bool isDir)
+    {
+        const int id = m_store.append(entry);
+
+        ArchiveNode *node;
+        if (isDir) {
+            ArchiveDirNode *dir = new ArchiveDirNode(parent, m_target, id);
+            dir->setFetched(true);
+            node = dir;
+        } else {
+            node = new ArchiveNode(parent, m_target, id);
+        }
+        parent->appendEntry(node, m_store.nameId(id));
+
+        // The new directory is empty, its files are added later
+        DirTotals t;
+        if (isDir) {
+            t.dirs = 1;
+        } else {
+            t.files = 1;
+            t.size = m_store.size(id);
+            t.compressedSize = m_store.compressedSize(id);
+        }
+        parent->countChild(isDir, 1);
+        parent->addToTotals(t);
+        return node;
+    }
+
+    // Chunks are sorted by the thread pool and merged pairwise
+    void sortOrder(QVector<int> *order, const KeyLessThan &lessThan)
+    {
+        const int count = order->count();
+        const int chunks = qBound(1, QThread::idealThreadCount(), count / c_sortChunkMinEntries);
+        int *data = order->data();
+
+        QVector<int> bounds;
+        for (int c = 0; c <= chunks; ++c) {
+            bounds.append(int(qint64(count) * c / chunks));
+        }
+
+        QList<QFuture<void> > futures;
+        for (int c = 0; c < chunks; ++c) {
+            futures.append(QtConcurrent::run(sortKeys, data + bounds.at(c), data + bounds.at(c + 1), lessThan));
+        }
+        foreach (QFuture<void> future, futures) {
+            future.waitForFinished();
+        }
+
+        for (int width = 1; width < chunks; width *= 2) {
+            futures.clear();
+            for (int c = 0; c + width < chunks; c += 2 * width) {
+                const int end = qMin(c + 2 * width, chunks);
+                futures.append(QtConcurrent::run(mergeKeys, data + bounds.at(c), data + bounds.at(c + width),
+                                                 data + bounds.at(end), lessThan));
+            }
+            foreach (QFuture<void> future, futures) {
+                future.waitForFinished();
+            }
+        }
+    }
+
+    ArchiveEntryList   m_entries;
+    ArchiveEntryStore *m_target;
+    ArchiveEntryStore  m_store;
+    ArchiveDirNode    *m_root;
+    QMutex             m_mutex;
+    bool               m_cancel;
 };
 
-int ArchiveNode::row() const
+void ArchiveNode::setEntry(const ArchiveEntry& entry)
 {
-    if (parent()) {
-        return parent()->entries().indexOf(const_cast<ArchiveNode*>(this));
+    const quint32 oldNameId = m_store->nameId(m_id);
+    const DirTotals oldTotals = totals();
+    m_store->update(m_id, entry);
+
+    if (m_parent && oldNameId != m_store->nameId(m_id)) {
+        m_parent->reindexEntry(this, oldNameId);
+    }
+    if (m_parent && !isDir()) {
+        m_parent->removeFromTotals(oldTotals);
+        m_parent->addToTotals(totals());
     }
-    return 0;
 }
 
 ArchiveModel::ArchiveModel(QObject *parent)
     : QAbstractItemModel(parent)
-    , m_rootNode(new ArchiveDirNode(0, ArchiveEntry()))
+    , m_queuePos(0)
+    , m_listedCount(0)
+    , m_populateTimer(new QTimer(this))
+    , m_treeBuilder(0)
+    , m_loadingJob(0)
+    , m_rootNode(new ArchiveDirNode(0, &m_store, ArchiveEntry()))
+    , m_sortColumn(-1)
+    , m_sortOrder(Qt::AscendingOrder)
+    , m_naturalSorting(true)
+    , m_lazyLoading(false)
+    , m_lazyTree(false)
 {
     //used to speed up the loading of large archives
     m_previousMatch = NULL;
+
+    connect(m_populateTimer, SIGNAL(timeout()), this, SLOT(processQueuedEntries()));
 }
 
 ArchiveModel::~ArchiveModel()
 {
+    stopPopulating();
     delete m_rootNode;
     m_rootNode = 0;
 }
@@ -262,6 +934,7 @@ QVariant ArchiveModel::data(const QModelIndex &index, int role) const
 {
     if (index.isValid()) {
         ArchiveNode *node = static_cast<ArchiveNode*>(index.internalPointer());
+        const int id = node->id();
         switch (role) {
         case Qt::DisplayRole: {
             int columnId = m_showColumns.at(index.column());
@@ -274,16 +947,16 @@ QVariant ArchiveModel::data(const QModelIndex &index, int role) const
                     int files;
                     const int children = childCount(index, dirs, files);
                     return QSizeFormater::itemsSummaryString(children, files, dirs, 0, false);
-                } else if (node->entry().contains(Link)) {
+                } else if (m_store.hasLink(id)) {
                     return QVariant();
                 } else {
-                    return QSizeFormater::convertSize(node->entry()[ Size ].toULongLong());
+                    return QSizeFormater::convertSize(m_store.size(id));
                 }
             case CompressedSize:
-                if (node->isDir() || node->entry().contains(Link)) {
+                if (node->isDir() || m_store.hasLink(id)) {
                     return QVariant();
                 } else {
-                    qulonglong compressedSize = node->entry()[ CompressedSize ].toULongLong();
+                    qulonglong compressedSize = m_store.compressedSize(id);
                     if (compressedSize != 0) {
                         return QSizeFormater::convertSize(compressedSize);
                     } else {
@@ -292,11 +965,11 @@ QVariant ArchiveModel::data(const QModelIndex &index, int role) const
                 }
             case Ratio:
                 // TODO: Použít node->entry()[Ratio] pokud dostupné
-                if (node->isDir() || node->entry().contains(Link)) {
+                if (node->isDir() || m_store.hasLink(id)) {
                     return QVariant();
                 } else {
-                    qulonglong compressedSize = node->entry()[ CompressedSize ].toULongLong();
-                    qulonglong size = node->entry()[ Size ].toULongLong();
+                    qulonglong compressedSize = m_store.compressedSize(id);
+                    qulonglong size = m_store.size(id);
                     if (compressedSize == 0 || size == 0) {
                         return QVariant();
                     } else {
@@ -306,25 +979,51 @@ QVariant ArchiveModel::data(const QModelIndex &index, int role) const
                 }
 
             case Timestamp: {
-                const QDateTime timeStamp = node->entry().value(Timestamp).toDateTime();
+                const QDateTime timeStamp = m_store.value(id, Timestamp).toDateTime();
                 return QLocale().toString(timeStamp, "d. MMMM yyyy hh:mm:ss");
             }
 
             default:
-                return node->entry().value(columnId);
+                return m_store.value(id, columnId);
             }
             break;
         }
         case Qt::DecorationRole:
             if (index.column() == 0) {
-                return node->icon();
+                // Resolved lazily, one shared pixmap per file type
+                return IconProvider::entryPixmap(m_store.fileName(id), node->isDir() || m_store.isDir(id));
             }
             return QVariant();
         case Qt::FontRole: {
             QFont f;
-            f.setItalic(node->entry()[ IsPasswordProtected ].toBool());
+            f.setItalic(m_store.isPasswordProtected(id));
             return f;
         }
+        case DirCountRole:
+        case FileCountRole:
+        case TotalDirCountRole:
+        case TotalFileCountRole:
+        case TotalSizeRole:
+        case TotalCompressedSizeRole: {
+            if (!node->isDir()) {
+                return QVariant();
+            }
+            const ArchiveDirNode *dir = static_cast<ArchiveDirNode*>(node);
+            switch (role) {
+            case DirCountRole:
+                return dir->dirCount();
+            case FileCountRole:
+                return dir->fileCount();
+            case TotalDirCountRole:
+                return dir->subtreeTotals().dirs;
+            case TotalFileCountRole:
+                return dir->subtreeTotals().files;
+            case TotalSizeRole:
+                return dir->subtreeTotals().size;
+            default:
+                return dir->subtreeTotals().compressedSize;
+            }
+        }
         default:
             return QVariant();
         }
@@ -339,174 +1038,619 @@ Qt::ItemFlags ArchiveModel::flags(const QModelIndex &index) const
     if (index.isValid()) {
         return Qt::ItemIsEnabled | Qt::ItemIsSelectable | Qt::ItemIsDragEnabled | defaultFlags;
     }
-
-    return 0;
+
+    return 0;
+}
+
+QVariant ArchiveModel::headerData(int section, Qt::Orientation, int role) const
+{
+    if (role == Qt::DisplayRole) {
+        if (section >= m_showColumns.size()) {
+            //qDebug() << "showColumns.size = " << m_showColumns.size() << " and section = " << section;
+            return QVariant();
+        }
+
+        int columnId = m_showColumns.at(section);
+
+        switch (columnId) {
+        case FileName:
+            return tr("Name", "Name of a file inside an archive");
+        case Size:
+            return tr("Size", "Uncompressed size of a file inside an archive");
+        case CompressedSize:
+            return tr("Compressed", "Compressed size of a file inside an archive");
+        case Ratio:
+            return tr("Rate", "Compression rate of file");
+        case Owner:
+            return tr("Owner", "File's owner username");
+        case Group:
+            return tr("Group", "File's group");
+        case Permissions:
+            return tr("Mode", "File permissions");
+        case CRC:
+            return tr("CRC", "CRC hash code");
+        case Method:
+            return tr("Method", "Compression method");
+        case Version:
+            // Verze programu pro rozbalení
+            return tr("Version", "Archive/Program version");
+        case Timestamp:
+            return tr("Date Modified", "Timestamp");
+        case Comment:
+            return tr("Comment", "File comment");
+        default:
+            return tr("??", "Unnamed column");
+        }
+    }
+    return QVariant();
+}
+
+QModelIndex ArchiveModel::index(int row, int column, const QModelIndex &parent) const
+{
+    if (hasIndex(row, column, parent)) {
+        ArchiveDirNode *parentNode = parent.isValid() ? static_cast<ArchiveDirNode*>(parent.internalPointer()) : m_rootNode;
+
+        Q_ASSERT(parentNode->isDir());
+
+        ArchiveNode *item = parentNode->entries().value(row, 0);
+        if (item) {
+            return createIndex(row, column, item);
+        }
+    }
+
+    return QModelIndex();
+}
+
+QModelIndex ArchiveModel::parent(const QModelIndex &index) const
+{
+    if (index.isValid()) {
+        ArchiveNode *item = static_cast<ArchiveNode*>(index.internalPointer());
+        Q_ASSERT(item);
+        if (item->parent() && (item->parent() != m_rootNode)) {
+            return createIndex(item->parent()->row(), 0, item->parent());
+        }
+    }
+    return QModelIndex();
+}
+
+ArchiveEntry ArchiveModel::entryForIndex(const QModelIndex &index)
+{
+    if (index.isValid()) {
+        ArchiveNode *item = static_cast<ArchiveNode*>(index.internalPointer());
+        Q_ASSERT(item);
+        return item->entry();
+    }
+    return ArchiveEntry();
+}
+
+int ArchiveModel::childCount(const QModelIndex &index, int &dirs, int &files) const
+{
+    if (index.isValid()) {
+        dirs = files = 0;
+        ArchiveNode *item = static_cast<ArchiveNode*>(index.internalPointer());
+        Q_ASSERT(item);
+        if (item->isDir()) {
+            // Kept up to date by ArchiveDirNode
+            dirs = static_cast<ArchiveDirNode*>(item)->dirCount();
+            files = static_cast<ArchiveDirNode*>(item)->fileCount();
+            return dirs + files;
+        }
+        return 0;
+    }
+    return -1;
+}
+
+int ArchiveModel::rowCount(const QModelIndex &parent) const
+{
+    if (parent.column() <= 0) {
+        ArchiveNode *parentNode = parent.isValid() ? static_cast<ArchiveNode*>(parent.internalPointer()) : m_rootNode;
+
+        if (parentNode && parentNode->isDir()) {
+            return static_cast<ArchiveDirNode*>(parentNode)->entries().count();
+        }
+    }
+    return 0;
+}
+
+int ArchiveModel::columnCount(const QModelIndex &parent) const
+{
+    return m_showColumns.size();
+    if (parent.isValid()) {
+        return static_cast<ArchiveNode*>(parent.internalPointer())->entry().size();
+    }
+}
+
+void ArchiveModel::sort(int column, Qt::SortOrder order)
+{
+    if (m_showColumns.size() <= column) {
+        return;
+    }
+
+    // Children fetched later are sorted the same way
+    m_sortColumn = m_showColumns.at(column);
+    m_sortOrder = order;
+
+    emit layoutAboutToBeChanged();
+    const QModelIndexList oldIndexes = persistentIndexList();
+
+    QList<ArchiveDirNode*> dirNodes;
+    m_rootNode->returnDirNodes(&dirNodes);
+    dirNodes.append(m_rootNode);
+
+    // Keys of all nodes first, the directories are sorted independently
+    SortKeys keys(&m_store, m_sortColumn, m_naturalSorting);
+    const ArchiveModelSorter modelSorter(&keys, order);
+
+    QVector<SortItem> items;
+    QVector<int> bounds;
+    foreach(ArchiveDirNode* dir, dirNodes) {
+        bounds.append(items.count());
+        foreach(ArchiveNode *node, dir->entries()) {
+            SortItem item;
+            item.node = node;
+            item.key = keys.append(node);
+            item.isDir = node->isDir();
+            items.append(item);
+        }
+    }
+    bounds.append(items.count());
+
+    QList<SortRange> ranges;
+    SortItem *data = items.data();
+    for (int d = 0; d < dirNodes.count(); ++d) {
+        if (bounds.at(d + 1) - bounds.at(d) > 1) {
+            SortRange range;
+            range.dir = dirNodes.at(d);
+            range.begin = data + bounds.at(d);
+            range.end = data + bounds.at(d + 1);
+            range.sorter = &modelSorter;
+            ranges.append(range);
+        }
+    }
+
+    if (items.count() >= c_parallelSortMinEntries) {
+        QtConcurrent::blockingMap(ranges, sortRange);
+    } else {
+        for (int i = 0; i < ranges.count(); ++i) {
+            sortRange(ranges[i]);
+        }
+    }
+
+    foreach(const SortRange &range, ranges) {
+        for (SortItem *item = range.begin; item != range.end; ++item) {
+            range.dir->setEntryAt(item - range.begin, item->node);
+        }
+    }
+
+    // Nodes know their new rows
+    QModelIndexList newIndexes;
+    foreach(const QModelIndex &oldIndex, oldIndexes) {
+        ArchiveNode *node = static_cast<ArchiveNode*>(oldIndex.internalPointer());
+        newIndexes.append(createIndex(node->row(), oldIndex.column(), node));
+    }
+    changePersistentIndexList(oldIndexes, newIndexes);
+
+    emit layoutChanged();
+}
+
+bool ArchiveModel::hasChildren(const QModelIndex &parent) const
+{
+    ArchiveNode *parentNode = parent.isValid() ? static_cast<ArchiveNode*>(parent.internalPointer()) : m_rootNode;
+
+    if (parent.column() <= 0 && parentNode->isDir() && !static_cast<ArchiveDirNode*>(parentNode)->isFetched()) {
+        const QString prefix = m_store.fileName(parentNode->id()) + QLatin1Char('/');
+        // Deleted entries stay in the index, only live ones count
+        for (int i = lowerBound(prefix); i < m_pathIndex.count(); ++i) {
+            const int id = m_pathIndex.at(i);
+            if (!m_store.fileName(id).startsWith(prefix)) {
+                break;
+            }
+            if (!m_removedIds.contains(id)) {
+                return true;
+            }
+        }
+        return false;
+    }
+    return QAbstractItemModel::hasChildren(parent);
+}
+
+bool ArchiveModel::canFetchMore(const QModelIndex &parent) const
+{
+    if (!parent.isValid() || parent.column() > 0) {
+        // Root is filled when the listing is finished
+        return false;
+    }
+
+    ArchiveNode *parentNode = static_cast<ArchiveNode*>(parent.internalPointer());
+    return parentNode->isDir() && !static_cast<ArchiveDirNode*>(parentNode)->isFetched();
+}
+
+void ArchiveModel::fetchMore(const QModelIndex &parent)
+{
+    if (canFetchMore(parent)) {
+        fetchChildren(static_cast<ArchiveDirNode*>(parent.internalPointer()));
+    }
+}
+
+void ArchiveModel::setLazyLoading(bool lazy)
+{
+    m_lazyLoading = lazy;
+}
+
+bool ArchiveModel::lazyLoading() const
+{
+    return m_lazyLoading;
+}
+
+void ArchiveModel::setNaturalSorting(bool natural)
+{
+    m_naturalSorting = natural;
+}
+
+bool ArchiveModel::naturalSorting() const
+{
+    return m_naturalSorting;
+}
+
+QModelIndex ArchiveModel::indexForPath(const QString &path)
+{
+    const QStringList pieces = path.split(QLatin1Char('/'), QString::SkipEmptyParts);
+    ArchiveDirNode *parent = m_rootNode;
+    ArchiveNode *node = 0;
+
+    foreach (const QString &piece, pieces) {
+        if (!parent) {
+            return QModelIndex();
+        }
+        if (!parent->isFetched()) {
+            fetchChildren(parent);
+        }
+        node = parent->find(piece);
+        if (!node) {
+            return QModelIndex();
+        }
+        parent = node->isDir() ? static_cast<ArchiveDirNode*>(node) : 0;
+    }
+
+    return node ? indexForNode(node) : QModelIndex();
+}
+
+void ArchiveModel::collectPaths(QVector<QString> *paths, QBitArray *dirs)
+{
+    paths->clear();
+
+    if (m_lazyTree) {
+        // Not fetched entries are only in the path index
+        mergeUnindexed();
+        paths->reserve(m_pathIndex.count());
+        dirs->fill(false, m_pathIndex.count());
+        foreach (int id, m_pathIndex) {
+            if (m_removedIds.contains(id)) {
+                continue;
+            }
+            if (m_store.isDir(id)) {
+                dirs->setBit(paths->count());
+            }
+            paths->append(m_store.fileName(id));
+        }
+        dirs->truncate(paths->count());
+        return;
+    }
+
+    dirs->fill(false, m_store.count());
+    QVector<const ArchiveDirNode*> stack;
+    stack.append(m_rootNode);
+    while (!stack.isEmpty()) {
+        const ArchiveDirNode *dir = stack.last();
+        stack.pop_back();
+        foreach (ArchiveNode *node, dir->entries()) {
+            if (node->isDir()) {
+                dirs->setBit(paths->count());
+                stack.append(static_cast<ArchiveDirNode*>(node));
+            }
+            paths->append(m_store.fileName(node->id()));
+        }
+    }
+    dirs->truncate(paths->count());
 }
 
-QVariant ArchiveModel::headerData(int section, Qt::Orientation, int role) const
+/* Drop the nodes of a collapsed directory, they will be fetched again */
+void ArchiveModel::releaseChildren(const QModelIndex &parent)
 {
-    if (role == Qt::DisplayRole) {
-        if (section >= m_showColumns.size()) {
-            //qDebug() << "showColumns.size = " << m_showColumns.size() << " and section = " << section;
-            return QVariant();
-        }
+    if (!m_lazyTree || !parent.isValid()) {
+        return;
+    }
 
-        int columnId = m_showColumns.at(section);
+    ArchiveNode *parentNode = static_cast<ArchiveNode*>(parent.internalPointer());
+    if (!parentNode->isDir() || !static_cast<ArchiveDirNode*>(parentNode)->isFetched()) {
+        return;
+    }
+    ArchiveDirNode *dir = static_cast<ArchiveDirNode*>(parentNode);
 
-        switch (columnId) {
-        case FileName:
-            return tr("Name", "Name of a file inside an archive");
-        case Size:
-            return tr("Size", "Uncompressed size of a file inside an archive");
-        case CompressedSize:
-            return tr("Compressed", "Compressed size of a file inside an archive");
-        case Ratio:
-            return tr("Rate", "Compression rate of file");
-        case Owner:
-            return tr("Owner", "File's owner username");
-        case Group:
-            return tr("Group", "File's group");
-        case Permissions:
-            return tr("Mode", "File permissions");
-        case CRC:
-            return tr("CRC", "CRC hash code");
-        case Method:
-            return tr("Method", "Compression method");
-        case Version:
-            // Verze programu pro rozbalení
-            return tr("Version", "Archive/Program version");
-        case Timestamp:
-            return tr("Date Modified", "Timestamp");
-        case Comment:
-            return tr("Comment", "File comment");
-        default:
-            return tr("??", "Unnamed column");
-        }
+    // Entries added to the directory must be found by the next fetch
+    mergeUnindexed();
+    m_previousMatch = 0;
+    m_previousPieces.clear();
+
+    if (!dir->entries().isEmpty()) {
+        beginRemoveRows(parent, 0, dir->entries().count() - 1);
+        dir->clear();
+        endRemoveRows();
     }
-    return QVariant();
+    dir->setFetched(false);
 }
 
-QModelIndex ArchiveModel::index(int row, int column, const QModelIndex &parent) const
+/* Add the entry to the store only, nodes are created by fetchChildren() */
+void ArchiveModel::appendLazyEntry(const ArchiveEntry& receivedEntry)
 {
-    if (hasIndex(row, column, parent)) {
-        ArchiveDirNode *parentNode = parent.isValid() ? static_cast<ArchiveDirNode*>(parent.internalPointer()) : m_rootNode;
+    if (receivedEntry[FileName].toString().isEmpty()) {
+        qDebug() << "Received empty entry (no filename) - skipping";
+        return;
+    }
 
-        Q_ASSERT(parentNode->isDir());
+    setupColumns(receivedEntry);
 
-        ArchiveNode *item = parentNode->entries().value(row, 0);
-        if (item) {
-            return createIndex(row, column, item);
+    QString entryFileName = cleanFileName(receivedEntry[FileName].toString());
+    if (entryFileName.isEmpty()) {
+        return;
+    }
+
+    ArchiveEntry entry = receivedEntry;
+
+    // Paths in the index have no empty pieces, "dir/" is the same node as "dir"
+    if (entryFileName.startsWith(QLatin1Char('/')) || entryFileName.endsWith(QLatin1Char('/'))
+            || entryFileName.contains(QLatin1String("//"))) {
+        if (entryFileName.endsWith(QLatin1Char('/'))) {
+            entry[IsDirectory] = true;
+        }
+        entryFileName = entryFileName.split(QLatin1Char('/'), QString::SkipEmptyParts).join(QLatin1String("/"));
+        if (entryFileName.isEmpty()) {
+            return;
         }
     }
+    entry[FileName] = entryFileName;
 
-    return QModelIndex();
+    m_unindexedIds.append(m_store.append(entry));
 }
 
-QModelIndex ArchiveModel::parent(const QModelIndex &index) const
+/* Sort new store ids into the path index */
+void ArchiveModel::mergeUnindexed()
 {
-    if (index.isValid()) {
-        ArchiveNode *item = static_cast<ArchiveNode*>(index.internalPointer());
-        Q_ASSERT(item);
-        if (item->parent() && (item->parent() != m_rootNode)) {
-            return createIndex(item->parent()->row(), 0, item->parent());
+    if (m_unindexedIds.isEmpty()) {
+        return;
+    }
+
+    const PathLessThan lessThan(&m_store);
+    qStableSort(m_unindexedIds.begin(), m_unindexedIds.end(), lessThan);
+
+    QVector<int> merged(m_pathIndex.count() + m_unindexedIds.count());
+    std::merge(m_pathIndex.constBegin(), m_pathIndex.constEnd(),
+               m_unindexedIds.constBegin(), m_unindexedIds.constEnd(),
+               merged.begin(), lessThan);
+    m_unindexedIds.clear();
+
+    // Repeated entries (multi-volume RAR), the last one wins
+    // and the compressed size is summed up as in addEntry()
+    int count = 0;
+    for (int i = 0; i < merged.count(); ++i) {
+        const int id = merged.at(i);
+        if (count > 0 && m_store.fileName(merged.at(count - 1)) == m_store.fileName(id)) {
+            const int previous = merged.at(count - 1);
+            m_store.setCompressedSize(id, m_store.compressedSize(previous) + m_store.compressedSize(id));
+            merged[count - 1] = id;
+        } else {
+            merged[count++] = id;
         }
     }
-    return QModelIndex();
+    merged.resize(count);
+
+    m_pathIndex = merged;
 }
 
-ArchiveEntry ArchiveModel::entryForIndex(const QModelIndex &index)
+/* First position in the path index not less than the path */
+int ArchiveModel::lowerBound(const QString &path) const
 {
-    if (index.isValid()) {
-        ArchiveNode *item = static_cast<ArchiveNode*>(index.internalPointer());
-        Q_ASSERT(item);
-        return item->entry();
+    int first = 0;
+    int count = m_pathIndex.count();
+
+    while (count > 0) {
+        const int step = count / 2;
+        if (comparePaths(m_store.fileName(m_pathIndex.at(first + step)), path) < 0) {
+            first += step + 1;
+            count -= step + 1;
+        } else {
+            count = step;
+        }
     }
-    return ArchiveEntry();
+    return first;
 }
 
-int ArchiveModel::childCount(const QModelIndex &index, int &dirs, int &files) const
+/* End of the block of paths starting with the prefix, the block begins at from */
+int ArchiveModel::subtreeEnd(const QString &prefix, int from, int to) const
 {
-    if (index.isValid()) {
-        dirs = files = 0;
-        ArchiveNode *item = static_cast<ArchiveNode*>(index.internalPointer());
-        Q_ASSERT(item);
-        if (item->isDir()) {
-            const QList<ArchiveNode*> entries = static_cast<ArchiveDirNode*>(item)->entries();
-            foreach(const ArchiveNode *node, entries) {
-                if (node->isDir()) {
-                    dirs++;
-                } else {
-                    files++;
-                }
-            }
-            return entries.count();
+    int count = to - from;
+
+    while (count > 0) {
+        const int step = count / 2;
+        if (m_store.fileName(m_pathIndex.at(from + step)).startsWith(prefix)) {
+            from += step + 1;
+            count -= step + 1;
+        } else {
+            count = step;
         }
-        return 0;
     }
-    return -1;
+    return from;
 }
 
-int ArchiveModel::rowCount(const QModelIndex &parent) const
+/* Children of the directory found in the path index, subtrees are skipped */
+QList<ArchiveModel::IndexedChild> ArchiveModel::indexedChildren(ArchiveDirNode *dir) const
 {
-    if (parent.column() <= 0) {
-        ArchiveNode *parentNode = parent.isValid() ? static_cast<ArchiveNode*>(parent.internalPointer()) : m_rootNode;
+    QList<IndexedChild> children;
+
+    QString prefix;
+    int i = 0;
+    int end = m_pathIndex.count();
+    if (dir != m_rootNode) {
+        prefix = m_store.fileName(dir->id()) + QLatin1Char('/');
+        i = lowerBound(prefix);
+        end = subtreeEnd(prefix, i, end);
+    }
 
-        if (parentNode && parentNode->isDir()) {
-            return static_cast<ArchiveDirNode*>(parentNode)->entries().count();
+    while (i < end) {
+        const int id = m_pathIndex.at(i);
+        const QString &path = m_store.fileName(id);
+        const int slash = path.indexOf(QLatin1Char('/'), prefix.length());
+
+        IndexedChild child;
+        if (slash < 0) {
+            // Entry of the child itself, its subtree follows
+            const int subEnd = subtreeEnd(path + QLatin1Char('/'), i + 1, end);
+            child.id = id;
+            child.isDir = (subEnd > i + 1) || m_store.isDir(id);
+            i = subEnd;
+            if (m_removedIds.contains(id)) {
+                continue;
+            }
+        } else {
+            // Directory without its own entry
+            child.id = -1;
+            child.dirPath = path.left(slash);
+            child.isDir = true;
+            i = subtreeEnd(child.dirPath + QLatin1Char('/'), i, end);
         }
+        children.append(child);
     }
-    return 0;
+
+    return children;
 }
 
-int ArchiveModel::columnCount(const QModelIndex &parent) const
+int ArchiveModel::implicitDirId(const QString &path)
 {
-    return m_showColumns.size();
-    if (parent.isValid()) {
-        return static_cast<ArchiveNode*>(parent.internalPointer())->entry().size();
+    QHash<QString, int>::const_iterator it = m_implicitDirIds.constFind(path);
+    if (it != m_implicitDirIds.constEnd()) {
+        return it.value();
     }
+
+    ArchiveEntry e;
+    e[ FileName ] = path;
+    e[ IsDirectory ] = true;
+    const int id = m_store.append(e);
+    m_implicitDirIds.insert(path, id);
+    return id;
 }
 
-void ArchiveModel::sort(int column, Qt::SortOrder order)
+/* Counts and sizes of a directory from its block of the path index */
+void ArchiveModel::computeIndexedTotals(ArchiveDirNode *dir)
 {
-    if (m_showColumns.size() <= column) {
-        return;
+    int dirCount = 0;
+    int fileCount = 0;
+    foreach (const IndexedChild &child, indexedChildren(dir)) {
+        if (child.isDir) {
+            dirCount++;
+        } else {
+            fileCount++;
+        }
+    }
+    dir->setCounts(dirCount, fileCount);
+
+    QString prefix;
+    int i = 0;
+    int end = m_pathIndex.count();
+    if (dir != m_rootNode) {
+        prefix = m_store.fileName(dir->id()) + QLatin1Char('/');
+        i = lowerBound(prefix);
+        end = subtreeEnd(prefix, i, end);
     }
 
-    emit layoutAboutToBeChanged();
+    DirTotals totals;
+    QString previous = prefix;
+    for (; i < end; ++i) {
+        const int id = m_pathIndex.at(i);
+        const QString &path = m_store.fileName(id);
+
+        // Parent directories not shared with the previous path
+        // (the sorted order puts the whole subtree together)
+        int common = 0;
+        const int length = qMin(previous.length(), path.length());
+        while (common < length && previous.at(common) == path.at(common)) {
+            ++common;
+        }
+        for (int slash = path.indexOf(QLatin1Char('/'), qMax(common, prefix.length()));
+             slash >= 0; slash = path.indexOf(QLatin1Char('/'), slash + 1)) {
+            totals.dirs++;
+        }
+        previous = path;
 
-    QList<ArchiveDirNode*> dirNodes;
-    m_rootNode->returnDirNodes(&dirNodes);
-    dirNodes.append(m_rootNode);
+        // Directory with children was counted as a parent of the next path
+        if (m_removedIds.contains(id) || (i + 1 < end && isParentPath(path, m_store.fileName(m_pathIndex.at(i + 1))))) {
+            continue;
+        }
+        if (m_store.isDir(id)) {
+            totals.dirs++;
+        } else {
+            totals.files++;
+            totals.size += m_store.size(id);
+            totals.compressedSize += m_store.compressedSize(id);
+        }
+    }
+    dir->setSubtreeTotals(totals);
+}
 
-    const ArchiveModelSorter modelSorter(m_showColumns.at(column), order);
+/* Sort nodes not in the model yet by the current sort column */
+void ArchiveModel::sortNodes(QVector<ArchiveNode*> *nodes) const
+{
+    SortKeys keys(&m_store, m_sortColumn, m_naturalSorting);
 
-    foreach(ArchiveDirNode* dir, dirNodes) {
-        QVector < QPair<ArchiveNode*,int> > sorting(dir->entries().count());
-        for (int i = 0; i < dir->entries().count(); ++i) {
-            ArchiveNode *item = dir->entries().at(i);
-            sorting[i].first = item;
-            sorting[i].second = i;
-        }
+    QVector<SortItem> items(nodes->count());
+    for (int i = 0; i < nodes->count(); ++i) {
+        items[i].node = nodes->at(i);
+        items[i].key = keys.append(nodes->at(i));
+        items[i].isDir = nodes->at(i)->isDir();
+    }
 
-        qStableSort(sorting.begin(), sorting.end(), modelSorter);
+    std::stable_sort(items.begin(), items.end(), ArchiveModelSorter(&keys, m_sortOrder));
+
+    for (int i = 0; i < items.count(); ++i) {
+        (*nodes)[i] = items.at(i).node;
+    }
+}
 
-        QModelIndexList fromIndexes;
-        QModelIndexList toIndexes;
-        for (int r = 0; r < sorting.count(); ++r) {
-            ArchiveNode *item = sorting.at(r).first;
-            toIndexes.append(createIndex(r, 0, item));
-            fromIndexes.append(createIndex(sorting.at(r).second, 0, sorting.at(r).first));
-            dir->setEntryAt(r, sorting.at(r).first);
+/* Create nodes of the directory children from the path index */
+void ArchiveModel::fetchChildren(ArchiveDirNode *dir)
+{
+    mergeUnindexed();
+
+    const QList<IndexedChild> children = indexedChildren(dir);
+
+    QVector<ArchiveNode*> nodes(children.count());
+    for (int i = 0; i < children.count(); ++i) {
+        const IndexedChild &child = children.at(i);
+        const int id = (child.id < 0) ? implicitDirId(child.dirPath) : child.id;
+        if (child.isDir) {
+            ArchiveDirNode *childDir = new ArchiveDirNode(dir, &m_store, id);
+            computeIndexedTotals(childDir);
+            nodes[i] = childDir;
+        } else {
+            nodes[i] = new ArchiveNode(dir, &m_store, id);
         }
+    }
 
-        changePersistentIndexList(fromIndexes, toIndexes);
+    if (m_sortColumn >= 0) {
+        sortNodes(&nodes);
+    }
 
-        emit dataChanged(
-            index(0, 0, indexForNode(dir)),
-            index(dir->entries().size() - 1, 0, indexForNode(dir)));
+    dir->setFetched(true);
+    if (nodes.isEmpty()) {
+        return;
     }
 
-    emit layoutChanged();
+    const int first = dir->entries().count();
+    beginInsertRows(indexForNode(dir), first, first + nodes.count() - 1);
+    for (int i = 0; i < nodes.count(); ++i) {
+        // Totals of the directory are already known from the index
+        dir->appendEntry(nodes.at(i), m_store.nameId(nodes.at(i)->id()));
+    }
+    endInsertRows();
 }
 
 QString ArchiveModel::cleanFileName(const QString& fileName)
@@ -522,7 +1666,7 @@ QString ArchiveModel::cleanFileName(const QString& fileName)
     return fileName;
 }
 
-ArchiveDirNode* ArchiveModel::parentFor(const ArchiveEntry& entry)
+ArchiveDirNode* ArchiveModel::parentFor(const ArchiveEntry& entry, InsertBehaviour behaviour)
 {
     QStringList pieces = entry[ FileName ].toString().split(QLatin1Char( '/' ), QString::SkipEmptyParts);
     if (pieces.isEmpty()) {
@@ -553,19 +1697,22 @@ ArchiveDirNode* ArchiveModel::parentFor(const ArchiveEntry& entry)
     ArchiveDirNode *parent = m_rootNode;
 
     foreach(const QString &piece, pieces) {
+        if (!parent->isFetched()) {
+            fetchChildren(parent);
+        }
         ArchiveNode *node = parent->find(piece);
         if (!node) {
             ArchiveEntry e;
             e[ FileName ] = (parent == m_rootNode) ?
-                            piece : parent->entry()[ FileName ].toString() + QLatin1Char( '/' ) + piece;
+                            piece : m_store.fileName(parent->id()) + QLatin1Char( '/' ) + piece;
             e[ IsDirectory ] = true;
-            node = new ArchiveDirNode(parent, e);
-            insertNode(node);
+            node = new ArchiveDirNode(parent, &m_store, e);
+            insertNode(node, behaviour);
         }
         if (!node->isDir()) {
             ArchiveEntry e(node->entry());
-            node = new ArchiveDirNode(parent, e);
-            insertNode(node);
+            node = new ArchiveDirNode(parent, &m_store, e);
+            insertNode(node, behaviour);
         }
         parent = static_cast<ArchiveDirNode*>(node);
     }
@@ -598,6 +1745,43 @@ void ArchiveModel::onEntryRemoved(const QString & path)
         return;
     }
 
+    if (m_lazyTree) {
+        // The entry may have no node, it must not be fetched again
+        mergeUnindexed();
+        const int i = lowerBound(entryFileName);
+        if (i < m_pathIndex.count() && m_store.fileName(m_pathIndex.at(i)) == entryFileName
+                && !m_removedIds.contains(m_pathIndex.at(i))) {
+            const int id = m_pathIndex.at(i);
+            m_removedIds.insert(id);
+
+            // Without node the totals of the nearest created parent are updated here
+            const QStringList pieces = entryFileName.split(QLatin1Char( '/' ), QString::SkipEmptyParts);
+            ArchiveDirNode *dir = m_rootNode;
+            int depth = 0;
+            for (; depth < pieces.count() - 1; ++depth) {
+                ArchiveNode *child = dir->find(pieces.at(depth));
+                if (!child || !child->isDir()) {
+                    break;
+                }
+                dir = static_cast<ArchiveDirNode*>(child);
+            }
+            if (!dir->find(pieces.last()) || depth < pieces.count() - 1) {
+                DirTotals t;
+                if (m_store.isDir(id)) {
+                    t.dirs = 1;
+                } else {
+                    t.files = 1;
+                    t.size = m_store.size(id);
+                    t.compressedSize = m_store.compressedSize(id);
+                }
+                if (depth == pieces.count() - 1) {
+                    dir->countChild(m_store.isDir(id), -1);
+                }
+                dir->removeFromTotals(t);
+            }
+        }
+    }
+
     ArchiveNode *entry = m_rootNode->findByPath(entryFileName.split(QLatin1Char( '/' ), QString::SkipEmptyParts));
     if (entry) {
         ArchiveDirNode *parent = entry->parent();
@@ -627,28 +1811,151 @@ void ArchiveModel::onUserQuery(Query *query)
     query->execute(NULL);
 }
 
-void ArchiveModel::addEntryToQueue(const ArchiveEntry& entry)
+void ArchiveModel::addEntriesToQueue(const ArchiveEntryList &batch)
 {
-    //qDebug() << "ArchiveModel::addEntryToQueue()";
+    // cache all entries, first batch is only shared
+    m_newArchiveEntries.append(batch);
+    m_listedCount += batch.count();
+
+    // Large listing waits for ArchiveTreeBuilder, the nodes added so far are shown meanwhile
+    if (!m_lazyTree && m_listedCount >= c_treeBuilderMinEntries) {
+        m_populateTimer->stop();
+        return;
+    }
 
-    // cache all entries
-    m_newArchiveEntries.push_back(entry);
+    if (!m_populateTimer->isActive()) {
+        m_populateTimer->start(0);
+    }
 }
 
-void ArchiveModel::onNewEntry(const ArchiveEntry& entry)
+/*
+ * Add queued entries until the time slice runs out. New rows are announced
+ * to the views once per slice, so the tree grows while the archive is listed.
+ */
+void ArchiveModel::processQueuedEntries()
 {
-    addEntry(entry, NotifyViews);
+    QElapsedTimer elapsed;
+    elapsed.start();
+
+    while (m_queuePos < m_newArchiveEntries.count()) {
+        if (m_lazyTree) {
+            appendLazyEntry(m_newArchiveEntries.at(m_queuePos++));
+        } else {
+            addEntry(m_newArchiveEntries.at(m_queuePos++), Deferred);
+        }
+        if ((m_queuePos & 63) == 0 && elapsed.elapsed() >= c_populateSliceTime) {
+            break;
+        }
+    }
+
+    // Entries are copied to the store, ArchiveTreeBuilder takes them from there
+    m_newArchiveEntries.erase(m_newArchiveEntries.begin(), m_newArchiveEntries.begin() + m_queuePos);
+    m_queuePos = 0;
+
+    publishDeferredRows();
+
+    if (m_queuePos == m_newArchiveEntries.count()) {
+        m_populateTimer->stop();
+
+        if (m_loadingJob) {
+            finishLoading();
+        }
+    }
 }
 
-void ArchiveModel::addEntry(const ArchiveEntry& receivedEntry, InsertBehaviour behaviour)
+void ArchiveModel::finishLoading()
 {
-    //qDebug()<<"ArchiveModel::addEntry()";
+    QJob *job = m_loadingJob;
+    m_loadingJob = 0;
+
+    if (m_lazyTree) {
+        // Build the path index, only top level nodes are created
+        mergeUnindexed();
+        computeIndexedTotals(m_rootNode);
+        fetchChildren(m_rootNode);
+    }
 
-    if (receivedEntry[FileName].toString().isEmpty()) {
-        qDebug() << "Received empty entry (no filename) - skipping";
+    m_newArchiveEntries.clear();
+    m_queuePos = 0;
+    m_listedCount = 0;
+
+    emit loadingFinished(job);
+    job->deleteLater();
+}
+
+/* Replace the tree with the one built by ArchiveTreeBuilder */
+void ArchiveModel::onTreeBuilt()
+{
+    if (!m_treeBuilder || !m_treeBuilder->isFinished()) {
         return;
     }
+    ArchiveTreeBuilder *builder = m_treeBuilder;
+    m_treeBuilder = 0;
+
+    beginResetModel();
+    delete m_rootNode;
+    m_rootNode = builder->takeRoot();
+    m_store.swap(builder->store());
+    m_previousMatch = 0;
+    m_previousPieces.clear();
+    endResetModel();
+
+    delete builder;
+
+    finishLoading();
+}
+
+/* Announce rows added with the Deferred behaviour */
+void ArchiveModel::publishDeferredRows()
+{
+    QHash<ArchiveDirNode*, int>::const_iterator it = m_deferredRows.constBegin();
+    for (; it != m_deferredRows.constEnd(); ++it) {
+        ArchiveDirNode *parent = it.key();
+        const int first = it.value();
+
+        // The view must see the old row count in beginInsertRows()
+        const QList<ArchiveNode*> tail = parent->takeEntriesFrom(first);
+        beginInsertRows(indexForNode(parent), first, first + tail.count() - 1);
+        parent->restoreEntries(tail);
+        endInsertRows();
+    }
+
+    m_deferredRows.clear();
+    m_deferredNodes.clear();
+}
+
+/* Drop the queued entries and the pending loading job */
+void ArchiveModel::stopPopulating()
+{
+    m_populateTimer->stop();
+    m_newArchiveEntries.clear();
+    m_queuePos = 0;
+    m_listedCount = 0;
+    m_deferredRows.clear();
+    m_deferredNodes.clear();
+
+    if (m_treeBuilder) {
+        disconnect(m_treeBuilder, 0, this, 0);
+        delete m_treeBuilder;
+        m_treeBuilder = 0;
+    }
+
+    if (m_loadingJob) {
+        m_loadingJob->deleteLater();
+        m_loadingJob = 0;
+    }
+}
+
+void ArchiveModel::onNewEntries(const ArchiveEntryList &batch)
+{
+    foreach (const ArchiveEntry &entry, batch) {
+        addEntry(entry, NotifyViews);
+    }
+}
 
+/* Create columns to show from the first entry */
+void ArchiveModel::setupColumns(const ArchiveEntry& entry)
+{
     // Pokud seznam zobrazovaných sloupců prázdny, vytvořit na základě aktualní položky
     if (m_showColumns.isEmpty()) {
         // these are the columns we are interested in showing in the display
@@ -670,7 +1977,7 @@ void ArchiveModel::addEntry(const ArchiveEntry& receivedEntry, InsertBehaviour b
         QList<int> toInsert;
 
         foreach(int column, columnsForDisplay) {
-            if (receivedEntry.contains(column)) {
+            if (entry.contains(column)) {
                 toInsert << column;
             }
         }
@@ -680,6 +1987,18 @@ void ArchiveModel::addEntry(const ArchiveEntry& receivedEntry, InsertBehaviour b
 
         //qDebug() << "Show columns detected: " << m_showColumns;
     }
+}
+
+void ArchiveModel::addEntry(const ArchiveEntry& receivedEntry, InsertBehaviour behaviour)
+{
+    //qDebug()<<"ArchiveModel::addEntry()";
+
+    if (receivedEntry[FileName].toString().isEmpty()) {
+        qDebug() << "Received empty entry (no filename) - skipping";
+        return;
+    }
+
+    setupColumns(receivedEntry);
 
     // Make a copy
     ArchiveEntry entry = receivedEntry;
@@ -690,21 +2009,28 @@ void ArchiveModel::addEntry(const ArchiveEntry& receivedEntry, InsertBehaviour b
     if (entryFileName.isEmpty()) { // The entry contains only "." or "./"
         return;
     }
+    if (m_lazyTree && entryFileName.endsWith(QLatin1Char('/'))) {
+        // Same path as in the lazy index
+        entryFileName = entryFileName.split(QLatin1Char('/'), QString::SkipEmptyParts).join(QLatin1String("/"));
+        entry[IsDirectory] = true;
+    }
     entry[FileName] = entryFileName;
 
     // 1. Skip already created nodes
     if (m_rootNode) {
         ArchiveNode *existing = m_rootNode->findByPath(entry[ FileName ].toString().split(QLatin1Char( '/' )));
         if (existing) {
-            qDebug() << "Refreshing entry for" << entry[FileName].toString();
-
             // Multi-volume files are repeated at least in RAR archives.
             // In that case, we need to sum the compressed size for each volume
-            qulonglong currentCompressedSize = existing->entry()[CompressedSize].toULongLong();
+            qulonglong currentCompressedSize = m_store.compressedSize(existing->id());
             entry[CompressedSize] = currentCompressedSize + entry[CompressedSize].toULongLong();
 
             // Update entry
             existing->setEntry(entry);
+            if (m_deferredNodes.contains(existing)) {
+                // Not announced to the views yet
+                return;
+            }
             // Notify GUI
             QModelIndex iFrom = createIndex(existing->row(), 0, existing);
             QModelIndex iTo = createIndex(existing->row(), m_showColumns.size()-1, existing);
@@ -714,7 +2040,7 @@ void ArchiveModel::addEntry(const ArchiveEntry& receivedEntry, InsertBehaviour b
     }
 
     // 2. Find Parent Node, creating missing ArchiveDirNodes in the process
-    ArchiveDirNode *parent = parentFor(entry);
+    ArchiveDirNode *parent = parentFor(entry, behaviour);
 
     // 3. Create an ArchiveNode
     QString name = entry[ FileName ].toString().split(QLatin1Char( '/' ), QString::SkipEmptyParts).last();
@@ -723,9 +2049,9 @@ void ArchiveModel::addEntry(const ArchiveEntry& receivedEntry, InsertBehaviour b
         node->setEntry(entry);
     } else {
         if (entry[ FileName ].toString().endsWith(QLatin1Char( '/' )) || (entry.contains(IsDirectory) && entry[ IsDirectory ].toBool())) {
-            node = new ArchiveDirNode(parent, entry);
+            node = new ArchiveDirNode(parent, &m_store, entry);
         } else {
-            node = new ArchiveNode(parent, entry);
+            node = new ArchiveNode(parent, &m_store, entry);
         }
         insertNode(node, behaviour);
     }
@@ -735,14 +2061,66 @@ void ArchiveModel::onLoadingFinished(QJob *job)
 {
     //qDebug() << "ArchiveModel::onLoadingFinished()" << m_newArchiveEntries.count() << "New entrys";
 
-    foreach(const ArchiveEntry &entry, m_newArchiveEntries)
-    {
-        addEntry(entry, DoNotNotifyViews);
+    // loadingFinished is emitted when the rest of the queue is added
+    m_loadingJob = job;
+
+    if (!m_lazyTree && m_listedCount >= c_treeBuilderMinEntries) {
+        // Too many entries for the GUI thread, build the whole tree
+        // on another thread, the current nodes are shown meanwhile
+        m_populateTimer->stop();
+
+        // Entries already added to the tree and the rest of the queue
+        ArchiveEntryList entries;
+        entries.reserve(m_store.count() + m_newArchiveEntries.count() - m_queuePos);
+        for (int id = 0; id < m_store.count(); ++id) {
+            if (!m_store.fileName(id).isEmpty()) {
+                entries.append(m_store.entry(id));
+            }
+        }
+        for (int i = m_queuePos; i < m_newArchiveEntries.count(); ++i) {
+            entries.append(m_newArchiveEntries.at(i));
+        }
+        m_newArchiveEntries.clear();
+        m_queuePos = 0;
+        setupColumns(entries.first());
+
+        m_treeBuilder = new ArchiveTreeBuilder(entries, &m_store);
+        connect(m_treeBuilder, SIGNAL(finished()), this, SLOT(onTreeBuilt()));
+        m_treeBuilder->start();
+        return;
     }
-    reset();
-    m_newArchiveEntries.clear();
 
-    emit loadingFinished(job);
+    if (!m_populateTimer->isActive()) {
+        m_populateTimer->start(0);
+    }
+}
+
+void ArchiveModel::onOpenFinished(QJob *job)
+{
+    OpenJob *openJob = qobject_cast<OpenJob*>(job);
+    if (job->error() || !openJob || !openJob->entriesListed()) {
+        // Error is reported by the caller of openArchive(),
+        // archive without entries will be listed by ListJob
+        stopPopulating();
+        job->deleteLater();
+        return;
+    }
+
+    onLoadingFinished(job);
+}
+
+/* Remove all nodes and their entries from the store */
+void ArchiveModel::clearNodes()
+{
+    delete m_rootNode;
+    m_store.clear();
+    m_rootNode = new ArchiveDirNode(0, &m_store, ArchiveEntry());
+
+    m_pathIndex.clear();
+    m_unindexedIds.clear();
+    m_removedIds.clear();
+    m_implicitDirIds.clear();
+    m_lazyTree = m_lazyLoading;
 }
 
 /* Insert the node into the model.*/
@@ -753,6 +2131,17 @@ void ArchiveModel::insertNode(ArchiveNode *node, InsertBehaviour behaviour)
     Q_ASSERT(parent);
     if (behaviour == NotifyViews) {
         beginInsertRows(indexForNode(parent), parent->entries().count(), parent->entries().count());
+    } else if (behaviour == Deferred) {
+        // Rows of visible parents are announced at the end of the slice,
+        // children of new nodes come along with them
+        if (!m_deferredNodes.contains(parent) && !m_deferredRows.contains(parent)) {
+            m_deferredRows.insert(parent, parent->entries().count());
+        }
+        m_deferredNodes.insert(node);
+    }
+    if (m_lazyTree) {
+        // Keep the node when its parent is released
+        m_unindexedIds.append(node->id());
     }
     parent->appendEntry(node);
     if (behaviour == NotifyViews) {
@@ -767,17 +2156,19 @@ Archive* ArchiveModel::archive() const
 
 void ArchiveModel::listArchive()
 {
-    m_rootNode->clear();
+    stopPopulating();
+    clearNodes();
     m_previousMatch = 0;
     m_previousPieces.clear();
 
     ListJob *job = NULL;
 
-    m_newArchiveEntries.clear();
     if (m_archive && m_archive->exists()) {
         job = m_archive->list();
+        // Deleted after the model is populated
+        job->setAutoDelete(false);
 
-        connect(job, SIGNAL(newEntry(ArchiveEntry)), this, SLOT(addEntryToQueue(ArchiveEntry)));
+        connect(job, SIGNAL(newEntries(ArchiveEntryList)), this, SLOT(addEntriesToQueue(ArchiveEntryList)));
         connect(job, SIGNAL(result(QJob*)), this, SLOT(onLoadingFinished(QJob*)));
         connect(job, SIGNAL(userQuery(Query*)), this, SLOT(onUserQuery(Query*)));
 
@@ -801,8 +2192,8 @@ void ArchiveModel::setArchive(Archive *archive)
 
     m_previousMatch = 0;
     m_previousPieces.clear();
-    m_newArchiveEntries.clear();
-    m_rootNode->clear();
+    stopPopulating();
+    clearNodes();
     m_showColumns.clear();
 
     endResetModel();
@@ -845,7 +2236,7 @@ OpenJob *ArchiveModel::openArchive()
 
     m_previousMatch = 0;
     m_previousPieces.clear();
-    m_newArchiveEntries.clear();
+    stopPopulating();
 
     // removeColumnsAll
     beginRemoveColumns(indexForNode(m_rootNode), 0, m_showColumns.count() > 0 ? m_showColumns.count()-1 : 0);
@@ -854,11 +2245,15 @@ OpenJob *ArchiveModel::openArchive()
     // endRemoveColumnsAll
 
     beginResetModel();
-    m_rootNode->clear();
+    clearNodes();
 
     if (m_archive /*&& m_archive->exists()*/) {
         job = m_archive->open();
-        connect(job, SIGNAL(newEntry(ArchiveEntry)), this, SLOT(onNewEntry(ArchiveEntry)));
+        // Deleted after the model is populated
+        job->setAutoDelete(false);
+        // Entries may be delivered by the open job (backend or listing cache)
+        connect(job, SIGNAL(newEntries(ArchiveEntryList)), this, SLOT(addEntriesToQueue(ArchiveEntryList)));
+        connect(job, SIGNAL(result(QJob*)), this, SLOT(onOpenFinished(QJob*)));
         connect(job, SIGNAL(userQuery(Query*)), this, SLOT(onUserQuery(Query*)));
         connect(job, SIGNAL(error(QString,QString)), this, SIGNAL(error(QString,QString)));
         connect(job, SIGNAL(info(QString)), this, SIGNAL(info(QString)));
@@ -915,7 +2310,7 @@ AddJob* ArchiveModel::addFiles(const QStringList & filenames, const CompressionO
     if (!m_archive->isReadOnly()) {
         AddJob *job = m_archive->addFiles(filenames, options);
 
-        connect(job, SIGNAL(newEntry(ArchiveEntry)), this, SLOT(onNewEntry(ArchiveEntry)));
+        connect(job, SIGNAL(newEntries(ArchiveEntryList)), this, SLOT(onNewEntries(ArchiveEntryList)));
         connect(job, SIGNAL(userQuery(Query*)), this, SLOT(onUserQuery(Query*)));
 
         return job;
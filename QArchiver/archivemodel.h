@@ -2,19 +2,37 @@
 #define ARCHIVEMODEL_H
 
 #include <QAbstractItemModel>
+#include <QBitArray>
+#include <QHash>
 #include <QScopedPointer>
+#include <QSet>
+#include <QVector>
 
 #include "qarchive.h"
 #include "QSizeFormater.h"
+#include "archiveentrystore.h"
 
+class QTimer;
 class Query;
 class ArchiveNode;
 class ArchiveDirNode;
+class ArchiveTreeBuilder;
 
 class ArchiveModel: public QAbstractItemModel
 {
     Q_OBJECT
+    friend class ArchiveTreeBuilder;
 public:
+    // Aggregates of a directory node, invalid QVariant for files
+    enum DirectoryRoles {
+        DirCountRole = Qt::UserRole + 1, // direct subdirectories
+        FileCountRole,                   // direct files
+        TotalDirCountRole,               // all subdirectories
+        TotalFileCountRole,              // all files in the subtree
+        TotalSizeRole,                   // uncompressed size of the subtree
+        TotalCompressedSizeRole
+    };
+
     explicit ArchiveModel(QObject *parent = 0);
     virtual ~ArchiveModel();
 
@@ -26,6 +44,18 @@ public:
     virtual int rowCount(const QModelIndex &parent = QModelIndex()) const;
     virtual int columnCount(const QModelIndex &parent = QModelIndex()) const;
     virtual void sort(int column, Qt::SortOrder order = Qt::AscendingOrder);
+    virtual bool hasChildren(const QModelIndex &parent = QModelIndex()) const;
+    virtual bool canFetchMore(const QModelIndex &parent) const;
+    virtual void fetchMore(const QModelIndex &parent);
+
+    // Nodes of directory children are created when the directory is expanded,
+    // takes effect with the next listing
+    void setLazyLoading(bool lazy);
+    bool lazyLoading() const;
+
+    // Numbers in names are compared by value when sorting
+    void setNaturalSorting(bool natural);
+    bool naturalSorting() const;
 
     Archive *archive() const;
     void setArchive(Archive *archive);
@@ -40,6 +70,10 @@ public:
     void setCodePage(const QString &codepage);
 
     ArchiveEntry entryForIndex(const QModelIndex &index);
+    // Index of the entry with the path, directories on the way are fetched
+    QModelIndex indexForPath(const QString &path);
+    // Paths of all entries in the tree (for ArchiveSearchIndex), shared with the store
+    void collectPaths(QVector<QString> *paths, QBitArray *dirs);
     int childCount(const QModelIndex &index, int &dirs, int &files) const;
 
     ExtractJob* extractFile(const QVariant& fileName, const QString & destinationDir, const ExtractionOptions options = ExtractionOptions()) const;
@@ -51,6 +85,7 @@ public:
 
 public slots:
     void listArchive();
+    void releaseChildren(const QModelIndex &parent);
 
 signals:
     void loadingStarted(QJob *);
@@ -62,32 +97,74 @@ signals:
     void archiveChanged();
 
 private slots:
-    void addEntryToQueue(const ArchiveEntry& entry);
-    void onNewEntry(const ArchiveEntry& entry);
+    void addEntriesToQueue(const ArchiveEntryList &batch);
+    void onNewEntries(const ArchiveEntryList &batch);
+    void processQueuedEntries();
+    void onTreeBuilt();
     void onEntryRemoved(const QString & path);
     void onLoadingFinished(QJob *job);
+    void onOpenFinished(QJob *job);
     void onUserQuery(Query *query);
     void cleanupEmptyDirs();
     void onArchCodePageChanged(const QString &codepage);
 
 private:
-    QString cleanFileName(const QString& fileName);
+    static QString cleanFileName(const QString& fileName);
 
-    ArchiveDirNode* parentFor(const ArchiveEntry& entry);
+    enum InsertBehaviour { NotifyViews, DoNotNotifyViews, Deferred };
+    ArchiveDirNode* parentFor(const ArchiveEntry& entry, InsertBehaviour behaviour = NotifyViews);
     QModelIndex indexForNode(ArchiveNode *node);
     static bool compareAscending(const QModelIndex& a, const QModelIndex& b);
     static bool compareDescending(const QModelIndex& a, const QModelIndex& b);
 
-    enum InsertBehaviour { NotifyViews, DoNotNotifyViews };
     void insertNode(ArchiveNode *node, InsertBehaviour behaviour = NotifyViews);
+    void clearNodes();
     void addEntry(const ArchiveEntry& entry, InsertBehaviour behaviour);
-
-    QList<ArchiveEntry> m_newArchiveEntries; // holds entries from opening
+    void publishDeferredRows();
+    void stopPopulating();
+    void finishLoading();
+    void setupColumns(const ArchiveEntry& entry);
+
+    // Lazy mode
+    struct IndexedChild {
+        int id;          // -1 for a directory without its own entry
+        QString dirPath; // path of such directory
+        bool isDir;
+    };
+    void appendLazyEntry(const ArchiveEntry& entry);
+    void mergeUnindexed();
+    int lowerBound(const QString &path) const;
+    int subtreeEnd(const QString &prefix, int from, int to) const;
+    QList<IndexedChild> indexedChildren(ArchiveDirNode *dir) const;
+    int implicitDirId(const QString &path);
+    void computeIndexedTotals(ArchiveDirNode *dir);
+    void fetchChildren(ArchiveDirNode *dir);
+    void sortNodes(QVector<ArchiveNode*> *nodes) const;
+
+    ArchiveEntryList m_newArchiveEntries; // holds entries from opening
+    int m_queuePos; // first entry not added to the tree
+    int m_listedCount; // entries received from the running listing
+    QTimer *m_populateTimer; // adds queued entries in time slices
+    ArchiveTreeBuilder *m_treeBuilder;
+    QJob *m_loadingJob; // finished job, waiting for the queue to be emptied
+    QHash<ArchiveDirNode*, int> m_deferredRows; // visible parent -> first not announced row
+    QSet<ArchiveNode*> m_deferredNodes; // nodes created in the current slice
     QList<int> m_showColumns;
     QScopedPointer<Archive> m_archive;
+    ArchiveEntryStore m_store; // entries of all nodes
     ArchiveDirNode *m_rootNode;
     ArchiveNode* m_previousMatch;
     QStringList m_previousPieces;
+    int m_sortColumn; // column id, -1 if not sorted
+    Qt::SortOrder m_sortOrder;
+    bool m_naturalSorting;
+
+    bool m_lazyLoading;
+    bool m_lazyTree; // current tree is loaded lazily
+    QVector<int> m_pathIndex; // store ids sorted by path, subtrees are contiguous
+    QVector<int> m_unindexedIds; // store ids not merged to m_pathIndex yet
+    QSet<int> m_removedIds;
+    QHash<QString, int> m_implicitDirIds; // path -> store id of created directory entry
 };
 
 #endif // ARCHIVEMODEL_H
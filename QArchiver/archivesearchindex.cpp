@@ -0,0 +1,511 @@
+#include "archivesearchindex.h"
+
+#include <QMutex>
+#include <QMutexLocker>
+#include <QRegExp>
+#include <QThread>
+#include <QDebug>
+
+#include <algorithm>
+
+static inline int varintSize(quint32 value)
+{
+    int size = 1;
+    while (value >= 0x80) {
+        value >>= 7;
+        ++size;
+    }
+    return size;
+}
+
+static inline uchar *writeVarint(uchar *p, quint32 value)
+{
+    while (value >= 0x80) {
+        *p++ = uchar(value | 0x80);
+        value >>= 7;
+    }
+    *p++ = uchar(value);
+    return p;
+}
+
+static inline quint32 readVarint(const uchar **p)
+{
+    quint32 value = 0;
+    int shift = 0;
+    uchar byte;
+    do {
+        byte = *(*p)++;
+        value |= quint32(byte & 0x7f) << shift;
+        shift += 7;
+    } while (byte & 0x80);
+    return value;
+}
+
+/* Builds posting lists of ArchiveSearchIndex in a worker thread */
+class ArchiveSearchIndexBuilder : public QThread
+{
+public:
+    explicit ArchiveSearchIndexBuilder(const QVector<QString> &paths)
+        : m_paths(paths)
+        , m_cancel(false)
+    {
+    }
+
+    ~ArchiveSearchIndexBuilder()
+    {
+        cancel();
+        wait();
+    }
+
+    void cancel()
+    {
+        QMutexLocker locker(&m_mutex);
+        m_cancel = true;
+    }
+
+    QHash<quint64, ArchiveSearchIndex::Postings> &postings()
+    {
+        return m_postings;
+    }
+
+    std::vector<uchar> &postingData()
+    {
+        return m_postingData;
+    }
+
+protected:
+    void run()
+    {
+        const int count = m_paths.count();
+        QHash<quint64, ArchiveSearchIndex::Postings> postings;
+        QVector<quint64> keys;
+
+        // First pass counts the paths and the encoded size of each trigram
+        for (int id = 0; id < count; ++id) {
+            if ((id & 1023) == 0 && isCanceled()) {
+                return;
+            }
+            ArchiveSearchIndex::trigrams(m_paths.at(id), &keys);
+            for (int k = 0; k < keys.count(); ++k) {
+                QHash<quint64, ArchiveSearchIndex::Postings>::iterator it = postings.find(keys.at(k));
+                if (it == postings.end()) {
+                    ArchiveSearchIndex::Postings p;
+                    p.offset = 0;
+                    p.bytes = varintSize(id + 1);
+                    p.count = 1;
+                    p.last = id;
+                    postings.insert(keys.at(k), p);
+                } else {
+                    ArchiveSearchIndex::Postings &p = it.value();
+                    p.bytes += varintSize(id - p.last);
+                    ++p.count;
+                    p.last = id;
+                }
+            }
+        }
+
+        // All posting lists share one array
+        qint64 offset = 0;
+        QHash<quint64, ArchiveSearchIndex::Postings>::iterator it = postings.begin();
+        for (; it != postings.end(); ++it) {
+            it.value().offset = offset;
+            offset += it.value().bytes;
+            it.value().bytes = 0;
+            it.value().last = -1;
+        }
+
+        // Second pass fills the lists, ids are appended in ascending order
+        std::vector<uchar> data(offset);
+        for (int id = 0; id < count; ++id) {
+            if ((id & 1023) == 0 && isCanceled()) {
+                return;
+            }
+            ArchiveSearchIndex::trigrams(m_paths.at(id), &keys);
+            for (int k = 0; k < keys.count(); ++k) {
+                ArchiveSearchIndex::Postings &p = postings[keys.at(k)];
+                uchar *begin = &data[p.offset + p.bytes];
+                p.bytes += writeVarint(begin, id - p.last) - begin;
+                p.last = id;
+            }
+        }
+
+        qSwap(m_postings, postings);
+        m_postingData.swap(data);
+    }
+
+private:
+    bool isCanceled()
+    {
+        QMutexLocker locker(&m_mutex);
+        return m_cancel;
+    }
+
+    const QVector<QString> m_paths;
+    QHash<quint64, ArchiveSearchIndex::Postings> m_postings;
+    std::vector<uchar> m_postingData;
+    QMutex m_mutex;
+    bool m_cancel;
+};
+
+
+ArchiveSearchIndex::ArchiveSearchIndex(QObject *parent)
+    : QObject(parent)
+    , m_builder(0)
+    , m_ready(false)
+{
+}
+
+ArchiveSearchIndex::~ArchiveSearchIndex()
+{
+    delete m_builder;
+}
+
+void ArchiveSearchIndex::build(const QVector<QString> &paths, const QBitArray &dirs)
+{
+    clear();
+
+    m_paths = paths;
+    m_dirs = dirs;
+
+    m_builder = new ArchiveSearchIndexBuilder(paths);
+    connect(m_builder, SIGNAL(finished()), this, SLOT(onBuilt()));
+    m_builder->start(QThread::LowPriority);
+}
+
+void ArchiveSearchIndex::clear()
+{
+    if (m_builder) {
+        disconnect(m_builder, 0, this, 0);
+        delete m_builder;
+        m_builder = 0;
+    }
+
+    m_paths.clear();
+    m_dirs.clear();
+    m_postings.clear();
+    std::vector<uchar>().swap(m_postingData);
+    m_ready = false;
+}
+
+bool ArchiveSearchIndex::isReady() const
+{
+    return m_ready;
+}
+
+bool ArchiveSearchIndex::isBuilding() const
+{
+    return m_builder != 0;
+}
+
+int ArchiveSearchIndex::count() const
+{
+    return m_paths.count();
+}
+
+const QString &ArchiveSearchIndex::path(int id) const
+{
+    return m_paths.at(id);
+}
+
+bool ArchiveSearchIndex::isDir(int id) const
+{
+    return id < m_dirs.size() && m_dirs.testBit(id);
+}
+
+void ArchiveSearchIndex::onBuilt()
+{
+    if (!m_builder || !m_builder->isFinished()) {
+        return;
+    }
+    ArchiveSearchIndexBuilder *builder = m_builder;
+    m_builder = 0;
+
+    qSwap(m_postings, builder->postings());
+    m_postingData.swap(builder->postingData());
+    m_ready = true;
+    delete builder;
+
+    qDebug() << "ArchiveSearchIndex: indexed" << m_paths.count() << "paths," << m_postings.count() << "trigrams,"
+             << qint64(m_postingData.size()) << "bytes of postings";
+    emit ready();
+}
+
+quint64 ArchiveSearchIndex::trigramKey(const QChar *s)
+{
+    return (quint64(s[0].unicode()) << 32) | (quint64(s[1].unicode()) << 16) | s[2].unicode();
+}
+
+/* Sorted unique trigrams of the case folded text */
+void ArchiveSearchIndex::trigrams(const QString &text, QVector<quint64> *keys)
+{
+    keys->clear();
+    if (text.length() < 3) {
+        return;
+    }
+
+    const QString folded = text.toCaseFolded();
+    for (int i = 0; i + 3 <= folded.length(); ++i) {
+        keys->append(trigramKey(folded.constData() + i));
+    }
+
+    std::sort(keys->begin(), keys->end());
+    keys->erase(std::unique(keys->begin(), keys->end()), keys->end());
+}
+
+bool ArchiveSearchIndex::shorterPostings(const Postings &a, const Postings &b)
+{
+    return a.count < b.count;
+}
+
+/*
+ * Literal parts every matching path contains. An empty list means
+ * the pattern gives no hint and all paths have to be checked.
+ */
+QStringList ArchiveSearchIndex::requiredLiterals(const QString &pattern, Syntax syntax)
+{
+    QStringList literals;
+    if (syntax == Substring) {
+        literals << pattern;
+        return literals;
+    }
+
+    QString current;
+    int depth = 0; // literals inside groups are optional or alternatives
+    const int len = pattern.length();
+
+    for (int i = 0; i < len; ++i) {
+        const QChar c = pattern.at(i);
+
+        if (syntax == Wildcard) {
+            if (c == QLatin1Char('*') || c == QLatin1Char('?')) {
+                literals << current;
+                current.clear();
+            } else if (c == QLatin1Char('[')) {
+                literals << current;
+                current.clear();
+                const int end = pattern.indexOf(QLatin1Char(']'), i + 2);
+                if (end < 0) {
+                    break;
+                }
+                i = end;
+            } else {
+                current += c;
+            }
+            continue;
+        }
+
+        switch (c.unicode()) {
+        case '\\':
+            if (i + 1 < len && !pattern.at(i + 1).isLetterOrNumber()) {
+                if (depth == 0) {
+                    current += pattern.at(i + 1);
+                }
+            } else {
+                // Character class or back reference
+                literals << current;
+                current.clear();
+            }
+            ++i;
+            break;
+        case '*':
+        case '?':
+            // The previous character may be missing
+            current.chop(1);
+            literals << current;
+            current.clear();
+            break;
+        case '{': {
+            current.chop(1);
+            literals << current;
+            current.clear();
+            const int end = pattern.indexOf(QLatin1Char('}'), i + 1);
+            if (end < 0) {
+                return QStringList();
+            }
+            i = end;
+            break;
+        }
+        case '[': {
+            literals << current;
+            current.clear();
+            int end = i + 1;
+            if (end < len && pattern.at(end) == QLatin1Char('^')) {
+                ++end;
+            }
+            end = pattern.indexOf(QLatin1Char(']'), end + 1);
+            if (end < 0) {
+                return QStringList();
+            }
+            i = end;
+            break;
+        }
+        case '(':
+            ++depth;
+            literals << current;
+            current.clear();
+            break;
+        case ')':
+            --depth;
+            literals << current;
+            current.clear();
+            break;
+        case '|':
+            if (depth == 0) {
+                return QStringList();
+            }
+            break;
+        case '+':
+        case '.':
+        case '^':
+        case '$':
+            literals << current;
+            current.clear();
+            break;
+        default:
+            if (depth == 0) {
+                current += c;
+            }
+            break;
+        }
+    }
+    literals << current;
+
+    return literals;
+}
+
+/*
+ * Ids of paths containing all trigrams of the literals, sorted.
+ * If the literals are too short, all is set and nothing is returned.
+ */
+QVector<int> ArchiveSearchIndex::candidates(const QStringList &literals, bool *all) const
+{
+    *all = true;
+    if (!m_ready) {
+        return QVector<int>();
+    }
+
+    QVector<quint64> keys;
+    QVector<quint64> literalKeys;
+    foreach (const QString &literal, literals) {
+        trigrams(literal, &literalKeys);
+        keys += literalKeys;
+    }
+    if (keys.isEmpty()) {
+        return QVector<int>();
+    }
+    *all = false;
+
+    QVector<Postings> lists;
+    foreach (quint64 key, keys) {
+        QHash<quint64, Postings>::const_iterator it = m_postings.constFind(key);
+        if (it == m_postings.constEnd()) {
+            // No path has the trigram
+            return QVector<int>();
+        }
+        lists.append(it.value());
+    }
+
+    // Intersect from the shortest list
+    std::sort(lists.begin(), lists.end(), shorterPostings);
+
+    const uchar *data = &m_postingData[0];
+    QVector<int> result;
+    result.reserve(lists.first().count);
+    const uchar *p = data + lists.first().offset;
+    int id = -1;
+    for (int n = 0; n < lists.first().count; ++n) {
+        id += readVarint(&p);
+        result.append(id);
+    }
+
+    QVector<int> merged;
+    for (int i = 1; i < lists.count() && !result.isEmpty(); ++i) {
+        merged.clear();
+        p = data + lists.at(i).offset;
+        id = -1;
+        int r = 0;
+        for (int n = 0; n < lists.at(i).count && r < result.count(); ++n) {
+            id += readVarint(&p);
+            while (r < result.count() && result.at(r) < id) {
+                ++r;
+            }
+            if (r < result.count() && result.at(r) == id) {
+                merged.append(id);
+                ++r;
+            }
+        }
+        qSwap(result, merged);
+    }
+
+    return result;
+}
+
+ArchiveSearchIndex::Query ArchiveSearchIndex::query(const QString &pattern, Syntax syntax) const
+{
+    Query query;
+    query.pattern = pattern;
+    query.syntax = syntax;
+    query.paths = m_paths;
+    query.all = false;
+    query.canceled = QSharedPointer<QAtomicInt>(new QAtomicInt(0));
+    if (!pattern.isEmpty()) {
+        query.ids = candidates(requiredLiterals(pattern, syntax), &query.all);
+    }
+    return query;
+}
+
+QVector<int> ArchiveSearchIndex::match(const Query &query)
+{
+    QVector<int> result;
+    const QString &pattern = query.pattern;
+    const Syntax syntax = query.syntax;
+    if (pattern.isEmpty()) {
+        return result;
+    }
+
+    QRegExp rx;
+    bool nameOnly = false;
+    if (syntax == Wildcard) {
+        rx = QRegExp(pattern, Qt::CaseInsensitive, QRegExp::Wildcard);
+        nameOnly = !pattern.contains(QLatin1Char('/'));
+    } else if (syntax == RegExp) {
+        rx = QRegExp(pattern, Qt::CaseInsensitive, QRegExp::RegExp2);
+    }
+    if (syntax != Substring && !rx.isValid()) {
+        return result;
+    }
+
+    const bool all = query.all;
+    const QVector<int> &ids = query.ids;
+    const int n = all ? query.paths.count() : ids.count();
+
+    for (int i = 0; i < n; ++i) {
+        if ((i & 4095) == 0 && query.canceled && query.canceled->fetchAndAddRelaxed(0) != 0) {
+            return QVector<int>();
+        }
+        const int id = all ? i : ids.at(i);
+        const QString &path = query.paths.at(id);
+        if (path.isEmpty()) {
+            continue;
+        }
+
+        bool match;
+        switch (syntax) {
+        case Substring:
+            match = path.contains(pattern, Qt::CaseInsensitive);
+            break;
+        case Wildcard:
+            match = rx.exactMatch(nameOnly ? path.mid(path.lastIndexOf(QLatin1Char('/')) + 1) : path);
+            break;
+        default:
+            match = rx.indexIn(path) != -1;
+            break;
+        }
+
+        if (match) {
+            result.append(id);
+        }
+    }
+
+    return result;
+}
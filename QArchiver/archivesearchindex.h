@@ -0,0 +1,93 @@
+#ifndef ARCHIVESEARCHINDEX_H
+#define ARCHIVESEARCHINDEX_H
+
+#include <QObject>
+#include <QAtomicInt>
+#include <QBitArray>
+#include <QHash>
+#include <QSharedPointer>
+#include <QString>
+#include <QStringList>
+#include <QVector>
+
+#include <vector>
+
+class ArchiveSearchIndexBuilder;
+
+/*
+ * Trigram index over full paths of the archive entries.
+ * Built on a worker thread, query() runs in the GUI thread: candidates are
+ * the intersection of posting lists of the pattern trigrams. match()
+ * verifies every candidate by the matcher and may run in any thread, the
+ * query holds its own copy of the paths. Matching is case insensitive.
+ * Posting lists are delta encoded path ids (7 bits per byte).
+ */
+class ArchiveSearchIndex : public QObject
+{
+    Q_OBJECT
+    friend class ArchiveSearchIndexBuilder;
+public:
+    enum Syntax {
+        Substring,  // part of the path
+        Wildcard,   // *, ? and [...], file name only unless the pattern contains '/'
+        RegExp      // matched anywhere in the path
+    };
+
+    explicit ArchiveSearchIndex(QObject *parent = 0);
+    virtual ~ArchiveSearchIndex();
+
+    // Paths are shared with the caller, indexing is started in background
+    void build(const QVector<QString> &paths, const QBitArray &dirs);
+    void clear();
+
+    // Until the index is ready search() scans all paths
+    bool isReady() const;
+    bool isBuilding() const;
+
+    int count() const;
+    const QString &path(int id) const;
+    bool isDir(int id) const;
+
+    struct Query {
+        QString pattern;
+        Syntax syntax;
+        QVector<QString> paths;
+        QVector<int> ids;   // candidates, unless all is set
+        bool all;           // the pattern gives no hint, every path is checked
+        QSharedPointer<QAtomicInt> canceled;
+    };
+
+    Query query(const QString &pattern, Syntax syntax) const;
+    // Ids of matching paths in the order given to build(),
+    // empty for an invalid pattern or a canceled query
+    static QVector<int> match(const Query &query);
+
+signals:
+    void ready();
+
+private slots:
+    void onBuilt();
+
+private:
+    struct Postings {
+        qint64 offset;  // in m_postingData
+        qint64 bytes;
+        int count;
+        int last;       // last id, used by the builder
+    };
+
+    static quint64 trigramKey(const QChar *s);
+    static void trigrams(const QString &text, QVector<quint64> *keys);
+    static bool shorterPostings(const Postings &a, const Postings &b);
+    static QStringList requiredLiterals(const QString &pattern, Syntax syntax);
+    QVector<int> candidates(const QStringList &literals, bool *all) const;
+
+    ArchiveSearchIndexBuilder *m_builder;
+    QVector<QString> m_paths;
+    QBitArray m_dirs;
+    QHash<quint64, Postings> m_postings;    // trigram -> range in m_postingData
+    std::vector<uchar> m_postingData;       // ascending path ids of each trigram
+    bool m_ready;
+};
+
+#endif // ARCHIVESEARCHINDEX_H
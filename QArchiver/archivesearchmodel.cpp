@@ -0,0 +1,124 @@
+#include "archivesearchmodel.h"
+#include "iconprovider.h"
+
+#if QT_VERSION >= QT_VERSION_CHECK(5, 0, 0)
+  #include <QtConcurrent/QtConcurrentRun>
+#else
+  #include <QtConcurrentRun>
+#endif
+
+// Full scans of more paths do not run in the GUI thread
+static const int c_syncScanLimit = 20000;
+
+ArchiveSearchModel::ArchiveSearchModel(ArchiveSearchIndex *index, QObject *parent)
+    : QAbstractListModel(parent)
+    , m_index(index)
+    , m_syntax(ArchiveSearchIndex::Substring)
+    , m_watcher(NULL)
+{
+    connect(m_index, SIGNAL(ready()), this, SLOT(refresh()));
+}
+
+int ArchiveSearchModel::rowCount(const QModelIndex &parent) const
+{
+    return parent.isValid() ? 0 : m_rows.count();
+}
+
+QVariant ArchiveSearchModel::data(const QModelIndex &index, int role) const
+{
+    if (!index.isValid() || index.row() >= m_rows.count()) {
+        return QVariant();
+    }
+
+    const int id = m_rows.at(index.row());
+    if (id >= m_index->count()) {
+        return QVariant();
+    }
+
+    switch (role) {
+    case Qt::DisplayRole:
+    case Qt::ToolTipRole:
+        return m_index->path(id);
+    case Qt::DecorationRole:
+        return IconProvider::entryPixmap(m_index->path(id), m_index->isDir(id));
+    default:
+        return QVariant();
+    }
+}
+
+QString ArchiveSearchModel::path(const QModelIndex &index) const
+{
+    return data(index, Qt::DisplayRole).toString();
+}
+
+QString ArchiveSearchModel::pattern() const
+{
+    return m_pattern;
+}
+
+ArchiveSearchIndex::Syntax ArchiveSearchModel::syntax() const
+{
+    return m_syntax;
+}
+
+void ArchiveSearchModel::setPattern(const QString &pattern, ArchiveSearchIndex::Syntax syntax)
+{
+    m_pattern = pattern;
+    m_syntax = syntax;
+    refresh();
+}
+
+bool ArchiveSearchModel::isSearching() const
+{
+    return m_watcher != NULL;
+}
+
+void ArchiveSearchModel::refresh()
+{
+    cancelSearch();
+
+    const ArchiveSearchIndex::Query query = m_index->query(m_pattern, m_syntax);
+    if (!query.all || query.paths.count() <= c_syncScanLimit) {
+        beginResetModel();
+        m_rows = ArchiveSearchIndex::match(query);
+        endResetModel();
+        return;
+    }
+
+    // Results are shown when the scan is finished
+    m_canceled = query.canceled;
+    m_watcher = new QFutureWatcher<QVector<int> >(this);
+    connect(m_watcher, SIGNAL(finished()), this, SLOT(onSearchFinished()));
+    m_watcher->setFuture(QtConcurrent::run(&ArchiveSearchIndex::match, query));
+
+    beginResetModel();
+    m_rows.clear();
+    endResetModel();
+}
+
+void ArchiveSearchModel::onSearchFinished()
+{
+    if (m_watcher == NULL || sender() != m_watcher) {
+        return;
+    }
+
+    beginResetModel();
+    m_rows = m_watcher->result();
+    m_watcher->deleteLater();
+    m_watcher = NULL;
+    m_canceled.clear();
+    endResetModel();
+}
+
+/* The scan stops at its next check, its result is not used */
+void ArchiveSearchModel::cancelSearch()
+{
+    if (m_watcher == NULL) {
+        return;
+    }
+    m_canceled->fetchAndStoreRelaxed(1);
+    m_canceled.clear();
+    disconnect(m_watcher, 0, this, 0);
+    m_watcher->deleteLater();
+    m_watcher = NULL;
+}
@@ -0,0 +1,48 @@
+#ifndef ARCHIVESEARCHMODEL_H
+#define ARCHIVESEARCHMODEL_H
+
+#include <QAbstractListModel>
+#include <QFutureWatcher>
+#include <QVector>
+
+#include "archivesearchindex.h"
+
+/*
+ * Flat list of the paths matching the pattern. A pattern without
+ * literals checks every path, on large archives in a worker thread.
+ */
+class ArchiveSearchModel : public QAbstractListModel
+{
+    Q_OBJECT
+public:
+    explicit ArchiveSearchModel(ArchiveSearchIndex *index, QObject *parent = 0);
+
+    virtual int rowCount(const QModelIndex &parent = QModelIndex()) const;
+    virtual QVariant data(const QModelIndex &index, int role) const;
+
+    QString path(const QModelIndex &index) const;
+
+    QString pattern() const;
+    ArchiveSearchIndex::Syntax syntax() const;
+    void setPattern(const QString &pattern, ArchiveSearchIndex::Syntax syntax);
+    bool isSearching() const;
+
+public slots:
+    // Search again, the index was changed
+    void refresh();
+
+private slots:
+    void onSearchFinished();
+
+private:
+    void cancelSearch();
+
+    ArchiveSearchIndex *m_index;
+    QString m_pattern;
+    ArchiveSearchIndex::Syntax m_syntax;
+    QVector<int> m_rows; // path ids in the index
+    QFutureWatcher<QVector<int> > *m_watcher;
+    QSharedPointer<QAtomicInt> m_canceled; // of the running search
+};
+
+#endif // ARCHIVESEARCHMODEL_H
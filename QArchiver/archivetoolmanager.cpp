@@ -5,6 +5,7 @@
 #include "ArchiveTools/clizipplugin.h"
 #include "ArchiveTools/qlibarchive.h"
 #include "ArchiveTools/singlefilecompression.h"
+#include "ArchiveTools/archivefilesource.h"
 
 #include <QFile>
 #include <QFileInfo>
@@ -313,12 +314,24 @@ bool ArchiveToolManager::laLhaEnabled()
     return m_LibarchiveLHA;
 }
 
+int ArchiveToolManager::laReadBlockSize()
+{
+    return m_LibarchiveBlockSize;
+}
+
+bool ArchiveToolManager::laMemoryMapEnabled()
+{
+    return m_LibarchiveMmap;
+}
+
 void ArchiveToolManager::writeSettings(QSettings &config)
 {
     config.beginGroup("LibArchive");
     config.setValue("LibarchiveZIP", this->m_LibarchiveZIP);
     config.setValue("LibarchiveRAR", this->m_LibarchiveRAR);
     config.setValue("LibarchiveLHA", this->m_LibarchiveLHA);
+    config.setValue("ReadBlockSize", this->m_LibarchiveBlockSize);
+    config.setValue("MemoryMap", this->m_LibarchiveMmap);
     config.endGroup();
 }
 
@@ -331,6 +344,8 @@ void ArchiveToolManager::readSettings(QSettings &config)
     this->m_LibarchiveRAR = false;
 #endif
     this->m_LibarchiveLHA = config.value("LibarchiveLHA", true).toBool();
+    setLaReadBlockSize(config.value("ReadBlockSize", 0).toInt());
+    setLaMemoryMapEnabled(config.value("MemoryMap", true).toBool());
     config.endGroup();
 }
 
@@ -349,6 +364,19 @@ void ArchiveToolManager::setLaLhaEnabled(bool value)
     m_LibarchiveLHA = value;
 }
 
+void ArchiveToolManager::setLaReadBlockSize(int size)
+{
+    // 0 = podle st_blksize
+    m_LibarchiveBlockSize = size;
+    ArchiveFileSource::setBlockSizeSetting(size);
+}
+
+void ArchiveToolManager::setLaMemoryMapEnabled(bool value)
+{
+    m_LibarchiveMmap = value;
+    ArchiveFileSource::setMemoryMapEnabled(value);
+}
+
 ArchiveInterface *ArchiveToolManager::createInterface(const QString &mimeType)
 {
     ArchiveInterface* iface = 0;
@@ -29,6 +29,8 @@ public:
     bool laZipEnabled();
     bool laRarEnabled();
     bool laLhaEnabled();
+    int laReadBlockSize();
+    bool laMemoryMapEnabled();
     void writeSettings(QSettings &config);
     void readSettings(QSettings &config);
 
@@ -46,6 +48,8 @@ public slots:
     void setLaZipEnabled(bool value);
     void setLaRarEnabled(bool value);
     void setLaLhaEnabled(bool value);
+    void setLaReadBlockSize(int size);
+    void setLaMemoryMapEnabled(bool value);
 
 private:
     explicit ArchiveToolManager(QObject *parent = 0);          // Private so that it can  not be called
@@ -56,6 +60,8 @@ private:
     bool m_LibarchiveZIP;
     bool m_LibarchiveRAR;
     bool m_LibarchiveLHA;
+    int m_LibarchiveBlockSize;
+    bool m_LibarchiveMmap;
 };
 
 #endif // ARCHIVETOOLMANAGER_H
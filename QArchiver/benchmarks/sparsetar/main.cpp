@@ -0,0 +1,226 @@
+#include <archive.h>
+#include <archive_entry.h>
+
+#include <sys/types.h>
+#include <sys/stat.h>
+
+#include <QCoreApplication>
+#include <QDir>
+#include <QElapsedTimer>
+#include <QFile>
+#include <QFileInfo>
+#include <QTextStream>
+
+// Synthetic image: 1 GB file with 1 MB of data every 16 MB
+static const qint64 c_imageSize = Q_INT64_C(1024) * 1024 * 1024;
+static const qint64 c_dataStep = 16 * 1024 * 1024;
+static const qint64 c_dataSize = 1024 * 1024;
+
+static const int c_rounds = 3;
+
+static bool createImage(const QString &path)
+{
+    QFile file(path);
+    if (!file.open(QIODevice::WriteOnly | QIODevice::Truncate) || !file.resize(c_imageSize)) {
+        return false;
+    }
+
+    QByteArray data(c_dataSize, 0);
+    for (int i = 0; i < data.size(); ++i) {
+        data[i] = char(1 + (i * 7) % 251);
+    }
+    for (qint64 offset = 0; offset < c_imageSize; offset += c_dataStep) {
+        if (!file.seek(offset) || file.write(data) != data.size()) {
+            return false;
+        }
+    }
+    return true;
+}
+
+/* Tar (pax) with the holes of the image in the sparse map, as bsdtar creates it */
+static bool createTar(const QString &image, const QString &tarPath)
+{
+    struct archive *disk = archive_read_disk_new();
+    struct archive *tar = archive_write_new();
+    struct archive_entry *entry = archive_entry_new();
+    bool ok = false;
+
+    archive_read_disk_set_standard_lookup(disk);
+    archive_write_set_format_pax_restricted(tar);
+    archive_write_add_filter_none(tar);
+
+    if (archive_read_disk_open(disk, QFile::encodeName(image).constData()) == ARCHIVE_OK
+            && archive_read_next_header2(disk, entry) == ARCHIVE_OK
+            && archive_write_open_filename(tar, QFile::encodeName(tarPath).constData()) == ARCHIVE_OK) {
+        archive_entry_set_pathname(entry, QFile::encodeName(QFileInfo(image).fileName()).constData());
+        ok = (archive_write_header(tar, entry) == ARCHIVE_OK);
+
+        static const char zeros[65536] = {0};
+        const void *buff;
+        size_t size;
+        __LA_INT64_T offset;
+        qint64 position = 0;
+        int r = ARCHIVE_OK;
+        while (ok && (r = archive_read_data_block(disk, &buff, &size, &offset)) == ARCHIVE_OK) {
+            // nuly v dírách ze sparse mapy zapisovač pax přeskočí
+            while (ok && position < offset) {
+                const qint64 bytes = qMin<qint64>(offset - position, sizeof(zeros));
+                ok = (archive_write_data(tar, zeros, bytes) == bytes);
+                position += bytes;
+            }
+            ok = ok && (archive_write_data(tar, buff, size) == qint64(size));
+            position = offset + size;
+        }
+        ok = ok && (r == ARCHIVE_EOF);
+        while (ok && position < archive_entry_size(entry)) {
+            const qint64 bytes = qMin<qint64>(archive_entry_size(entry) - position, sizeof(zeros));
+            ok = (archive_write_data(tar, zeros, bytes) == bytes);
+            position += bytes;
+        }
+        ok = (archive_write_close(tar) == ARCHIVE_OK) && ok;
+    }
+
+    archive_entry_free(entry);
+    archive_write_free(tar);
+    archive_read_free(disk);
+    return ok;
+}
+
+/* Původní kopírování přes 10 KB buffer, díry se zapíší jako nuly */
+static bool copyBuffered(struct archive *source, struct archive *dest)
+{
+    char buff[10240];
+    ssize_t len;
+    while ((len = archive_read_data(source, buff, sizeof(buff))) > 0) {
+        if (archive_write_data(dest, buff, len) < 0) {
+            return false;
+        }
+    }
+    return len == 0;
+}
+
+/* Bloky dekodéru bez kopírování, díry zůstanou dírami */
+static bool copyBlocks(struct archive *source, struct archive *dest)
+{
+    const void *buff;
+    size_t size;
+    __LA_INT64_T offset;
+    int r;
+    while ((r = archive_read_data_block(source, &buff, &size, &offset)) == ARCHIVE_OK) {
+        if (archive_write_data_block(dest, buff, size, offset) < ARCHIVE_OK) {
+            return false;
+        }
+    }
+    return r == ARCHIVE_EOF;
+}
+
+/* Extracts tarPath into outDir, returns the entry bytes or -1 */
+static qint64 extract(const QString &tarPath, const QString &outDir, bool blocks, qint64 *diskBytes)
+{
+    struct archive *source = archive_read_new();
+    struct archive *dest = archive_write_disk_new();
+    struct archive_entry *entry;
+    qint64 total = 0;
+    bool ok = true;
+
+    archive_read_support_format_tar(source);
+    archive_write_disk_set_options(dest, ARCHIVE_EXTRACT_TIME);
+    *diskBytes = 0;
+
+    if (archive_read_open_filename(source, QFile::encodeName(tarPath).constData(), 10240) != ARCHIVE_OK) {
+        ok = false;
+    }
+    while (ok && archive_read_next_header(source, &entry) == ARCHIVE_OK) {
+        const QByteArray target = QFile::encodeName(outDir + QLatin1Char('/')
+                                                    + QFile::decodeName(archive_entry_pathname(entry)));
+        archive_entry_set_pathname(entry, target.constData());
+        ok = (archive_write_header(dest, entry) == ARCHIVE_OK)
+                && (blocks ? copyBlocks(source, dest) : copyBuffered(source, dest))
+                && (archive_write_finish_entry(dest) == ARCHIVE_OK);
+        total += archive_entry_size(entry);
+
+        struct stat st;
+        if (ok && ::stat(target.constData(), &st) == 0) {
+            *diskBytes += qint64(st.st_blocks) * 512;
+        }
+    }
+
+    archive_write_free(dest);
+    archive_read_free(source);
+    return ok ? total : -1;
+}
+
+static void removeExtracted(const QString &outDir)
+{
+    QDir dir(outDir);
+    foreach (const QString &name, dir.entryList(QDir::Files)) {
+        dir.remove(name);
+    }
+}
+
+int main(int argc, char *argv[])
+{
+    QCoreApplication app(argc, argv);
+    QTextStream out(stdout);
+
+    const QString workDir = QDir::temp().absoluteFilePath(
+                QString::fromLatin1("sparsetar-%1").arg(QCoreApplication::applicationPid()));
+    QDir().mkpath(workDir);
+
+    // Argument: existing (sparse) VM image, otherwise a synthetic one is created
+    QString image = app.arguments().value(1);
+    const bool ownImage = image.isEmpty();
+    if (ownImage) {
+        image = workDir + QLatin1String("/disk.img");
+        if (!createImage(image)) {
+            out << "Cannot create " << image << "\n";
+            return 1;
+        }
+    }
+
+    const QString tarPath = workDir + QLatin1String("/image.tar");
+    if (!createTar(image, tarPath)) {
+        out << "Cannot create " << tarPath << "\n";
+        return 1;
+    }
+    out << QFileInfo(image).fileName() << ": " << QFileInfo(image).size() / (1024 * 1024)
+        << " MB, tar " << QFileInfo(tarPath).size() / (1024 * 1024) << " MB\n";
+    out.flush();
+
+    const QString outDir = workDir + QLatin1String("/out");
+    QDir().mkpath(outDir);
+
+    int result = 0;
+    for (int round = 0; round < c_rounds && result == 0; ++round) {
+        for (int method = 0; method < 2; ++method) {
+            const bool blocks = (method == 1);
+            removeExtracted(outDir);
+
+            QElapsedTimer timer;
+            timer.start();
+            qint64 diskBytes;
+            const qint64 bytes = extract(tarPath, outDir, blocks, &diskBytes);
+            const qint64 ms = qMax<qint64>(timer.elapsed(), 1);
+            if (bytes < 0) {
+                out << "Extraction failed\n";
+                result = 1;
+                break;
+            }
+
+            out << (blocks ? "archive_read_data_block: " : "archive_read_data:       ")
+                << ms << " ms, " << (bytes / (1024.0 * 1024.0)) / (ms / 1000.0) << " MB/s, "
+                << diskBytes / (1024 * 1024) << " MB on disk\n";
+            out.flush();
+        }
+    }
+
+    removeExtracted(outDir);
+    QDir().rmdir(outDir);
+    QFile::remove(tarPath);
+    if (ownImage) {
+        QFile::remove(image);
+    }
+    QDir().rmdir(workDir);
+
+    return result;
+}
@@ -0,0 +1,19 @@
+#-------------------------------------------------
+#
+# Benchmark of extracting a sparse VM image from a tar:
+# buffered archive_read_data() copy against the
+# archive_read_data_block() path used by QLibArchive
+#
+#-------------------------------------------------
+
+QT       += core
+QT       -= gui
+
+TARGET = sparsetar
+TEMPLATE = app
+CONFIG += console
+CONFIG -= app_bundle
+
+SOURCES += main.cpp
+
+unix: LIBS += -larchive
@@ -0,0 +1,75 @@
+#include "archivemodel.h"
+#include "jobinterface.h"
+
+#include <QApplication>
+#include <QElapsedTimer>
+#include <QEventLoop>
+#include <QStringList>
+#include <QTextStream>
+
+// Entries in one batch, as the listing jobs deliver them
+static const int c_batchSize = 1000;
+
+/* Finished listing job handed to the model */
+class BenchmarkJob : public QJob
+{
+public:
+    virtual void start() {}
+};
+
+/* 100 top directories with 100 subdirectories each, files below them */
+static ArchiveEntryList syntheticEntries(int count)
+{
+    ArchiveEntryList entries;
+    entries.reserve(count);
+    for (int i = 0; i < count; ++i) {
+        ArchiveEntry e;
+        e[ FileName ] = QString::fromLatin1("dir%1/sub%2/file%3.txt").arg(i % 100).arg((i / 100) % 100).arg(i);
+        e[ Size ] = qulonglong(i % 65536);
+        e[ CompressedSize ] = qulonglong(i % 32768);
+        entries.append(e);
+    }
+    return entries;
+}
+
+int main(int argc, char *argv[])
+{
+    // Qt 5: run with "-platform offscreen" without a display
+    QApplication app(argc, argv);
+
+    QList<int> counts;
+    foreach (const QString &arg, app.arguments().mid(1)) {
+        if (arg.toInt() > 0) {
+            counts.append(arg.toInt());
+        }
+    }
+    if (counts.isEmpty()) {
+        counts << 10000 << 1000000 << 5000000;
+    }
+
+    QTextStream out(stdout);
+    foreach (int count, counts) {
+        const ArchiveEntryList entries = syntheticEntries(count);
+
+        ArchiveModel model;
+        QEventLoop loop;
+        QObject::connect(&model, SIGNAL(loadingFinished(QJob*)), &loop, SLOT(quit()));
+
+        // Batches and the finished job are passed the same way as from the listing
+        QElapsedTimer timer;
+        timer.start();
+        for (int i = 0; i < count; i += c_batchSize) {
+            QMetaObject::invokeMethod(&model, "addEntriesToQueue", Qt::DirectConnection,
+                                      Q_ARG(ArchiveEntryList, entries.mid(i, c_batchSize)));
+        }
+        QMetaObject::invokeMethod(&model, "onLoadingFinished", Qt::DirectConnection,
+                                  Q_ARG(QJob*, new BenchmarkJob));
+        loop.exec();
+
+        out << count << " paths: " << timer.elapsed() << " ms, "
+            << model.rowCount() << " top level rows\n";
+        out.flush();
+    }
+
+    return 0;
+}
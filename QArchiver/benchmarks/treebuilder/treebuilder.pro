@@ -0,0 +1,19 @@
+#-------------------------------------------------
+#
+# Benchmark of ArchiveModel loading synthetic listings
+# of 10k, 1M and 5M paths (or the counts given as arguments)
+#
+#-------------------------------------------------
+
+QT       += core gui
+
+greaterThan(QT_MAJOR_VERSION, 4): QT += widgets concurrent
+
+TARGET = treebuilder
+TEMPLATE = app
+CONFIG += console
+CONFIG -= app_bundle
+
+SOURCES += main.cpp
+
+include(../../QArchiver.pri)
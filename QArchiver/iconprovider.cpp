@@ -92,5 +92,97 @@ QIcon IconProvider::icon(QFileIconProvider::IconType type)
     return Instance()->iconProvider.icon(type);
 }
 
+/* Icon type of a name, the icon is created once for every type */
+QString IconProvider::typeForName(const QString &name)
+{
+    IconProvider *p = Instance();
+
+#ifdef Q_OS_WIN
+    // Icons are provided by shell for the suffix
+    const QString type = QFileInfo(name).suffix().toLower();
+    if (!p->m_typeIcons.contains(type)) {
+        p->m_typeIcons.insert(type, fileIcon(QLatin1String("foo.") + type));
+    }
+#else
+    QMimeDatabase db;
+    const QMimeType mt = db.mimeTypeForFile(name, QMimeDatabase::MatchExtension);
+    const QString type = mt.name();
+    if (!p->m_typeIcons.contains(type)) {
+        p->m_typeIcons.insert(type, QIcon::fromTheme(mt.iconName(), QIcon::fromTheme(mt.genericIconName())));
+    }
+#endif
+    return type;
+}
+
+QString IconProvider::entryIconType(const QString &filename)
+{
+    IconProvider *p = Instance();
+
+    const QString name = filename.section(QLatin1Char('/'), -1, -1, QString::SectionSkipEmpty).toLower();
+    const int dot = name.lastIndexOf(QLatin1Char('.'));
+
+    // Bez přípony ("Makefile", ".bashrc") rozhoduje celé jméno, to se necachuje
+    if (dot <= 0) {
+        return typeForName(name);
+    }
+
+    // Compound suffix (".tar.gz") is cached as empty when it has no own type
+    const int dot2 = name.lastIndexOf(QLatin1Char('.'), dot - 1);
+    if (dot2 > 0) {
+        const QString compound = name.mid(dot2);
+        QHash<QString, QString>::const_iterator it = p->m_suffixTypes.constFind(compound);
+        if (it == p->m_suffixTypes.constEnd()) {
+            const QString type = typeForName(QLatin1String("x") + compound);
+            it = p->m_suffixTypes.insert(compound, type == suffixType(name.mid(dot)) ? QString() : type);
+        }
+        if (!it.value().isEmpty()) {
+            return it.value();
+        }
+    }
+
+    return suffixType(name.mid(dot));
+}
+
+QString IconProvider::suffixType(const QString &suffix)
+{
+    IconProvider *p = Instance();
+
+    QHash<QString, QString>::const_iterator it = p->m_suffixTypes.constFind(suffix);
+    if (it != p->m_suffixTypes.constEnd()) {
+        return it.value();
+    }
+    // Only the suffix is looked up, full name globs must not be cached for it
+    const QString type = typeForName(QLatin1String("x") + suffix);
+    p->m_suffixTypes.insert(suffix, type);
+    return type;
+}
+
+QIcon IconProvider::entryIcon(const QString &filename)
+{
+    return Instance()->m_typeIcons.value(entryIconType(filename));
+}
+
+QPixmap IconProvider::entryPixmap(const QString &filename, bool isDir)
+{
+    IconProvider *p = Instance();
+
+    if (isDir) {
+        if (p->m_dirPixmap.isNull()) {
+            p->m_dirPixmap = dirIcon().pixmap(16, 16);
+        }
+        return p->m_dirPixmap;
+    }
+
+    const QString type = entryIconType(filename);
+    QHash<QString, QPixmap>::const_iterator it = p->m_typePixmaps.constFind(type);
+    if (it != p->m_typePixmaps.constEnd()) {
+        return it.value();
+    }
+
+    const QPixmap pixmap = p->m_typeIcons.value(type).pixmap(16, 16);
+    p->m_typePixmaps.insert(type, pixmap);
+    return pixmap;
+}
+
 /***/
 
@@ -9,6 +9,7 @@
 #define ICONPROVIDER_H
 
 #include <QIcon>
+#include <QHash>
 #include <QPixmapCache>
 #include <QFileIconProvider>
 
@@ -19,15 +20,26 @@ public:
     static QIcon fileIcon(const QString &filename);
     static QIcon dirIcon();
     static QIcon icon(QFileIconProvider::IconType type);
+    /* Icons for entries inside an archive, no filesystem access, cached by type */
+    static QIcon entryIcon(const QString &filename);
+    static QPixmap entryPixmap(const QString &filename, bool isDir);
 private:
     IconProvider(){}    // Private so that it can  not be called
     IconProvider(IconProvider const&);             // copy constructor is private
     IconProvider& operator=(IconProvider const&);  // assignment operator is private
 
+    static QString entryIconType(const QString &filename);
+    static QString suffixType(const QString &suffix);
+    static QString typeForName(const QString &name);
+
 private:
     static IconProvider *self;
     QPixmapCache iconCache;
     QFileIconProvider iconProvider;
+    QHash<QString, QString> m_suffixTypes;  // lower-case suffix -> icon type (mime name)
+    QHash<QString, QIcon> m_typeIcons;
+    QHash<QString, QPixmap> m_typePixmaps;  // shared 16x16 pixmaps
+    QPixmap m_dirPixmap;
 };
 
 #endif // ICONPROVIDER_H
@@ -60,12 +60,17 @@ void InfoFrame::setIndex(const QModelIndex &index)
             }
 
             //ui->iconLabel->setPixmap(QIcon::fromTheme(mimeType.iconName()).pixmap(48));
-            ui->iconLabel->setPixmap(IconProvider::fileIcon(entry[ FileName ].toString()).pixmap(48));
             if (entry[ IsDirectory ].toBool()) {
-                int dirs;
-                int files;
-                const int children = m_model->childCount(index, dirs, files);
-                ui->additionalInfoLabel->setText(QSizeFormater::itemsSummaryString(children, files, dirs, 0, false));
+                ui->iconLabel->setPixmap(IconProvider::dirIcon().pixmap(48));
+            } else {
+                ui->iconLabel->setPixmap(IconProvider::entryIcon(entry[ FileName ].toString()).pixmap(48));
+            }
+            if (entry[ IsDirectory ].toBool()) {
+                // Aggregates kept by the model, the size is of the whole subtree
+                const int dirs = index.data(ArchiveModel::DirCountRole).toInt();
+                const int files = index.data(ArchiveModel::FileCountRole).toInt();
+                const qint64 totalSize = index.data(ArchiveModel::TotalSizeRole).toLongLong();
+                ui->additionalInfoLabel->setText(QSizeFormater::itemsSummaryString(dirs + files, files, dirs, totalSize, true));
             } else if (entry.contains(Link)) {
                 ui->additionalInfoLabel->setText(tr("Symbolic Link"));
             } else {
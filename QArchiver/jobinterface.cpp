@@ -32,7 +32,8 @@ QJob::QJob(QObject *parent) :
     m_error(0),
     m_autoDelete(true),
     m_finished(false),
-    m_percentage(-1)
+    m_percentage(-1),
+    m_progressChannel(0)
 {
     ;
 }
@@ -146,6 +147,16 @@ void QJob::setPercent(unsigned long percentage)
     }
 }
 
+ProgressChannel *QJob::progressChannel() const
+{
+    return m_progressChannel;
+}
+
+void QJob::setProgressChannel(ProgressChannel *channel)
+{
+    m_progressChannel = channel;
+}
+
 void QJob::setCapabilities(Capabilities capabilities)
 {
   m_capabilities = capabilities;
@@ -4,6 +4,8 @@
 #include <QObject>
 #include <QPair>
 
+class ProgressChannel;
+
 /**
  * QJob
  */
@@ -48,6 +50,9 @@ public:
     bool isAutoDelete() const;
     void setAutoDelete(bool autoDelete);
 
+    // Progress sampled by the GUI, 0 if the job does not report it
+    ProgressChannel *progressChannel() const;
+
 public slots:
     bool kill(KillVerbosity verbosity=Quietly);
 
@@ -57,6 +62,7 @@ protected:
     void setError(int errorCode);
     void setErrorText(const QString &errorText);
     void setPercent(unsigned long percentage);
+    void setProgressChannel(ProgressChannel *channel);
 
     void setCapabilities(Capabilities capabilities);
 
@@ -89,6 +95,7 @@ private:
     bool m_autoDelete;
     bool m_finished;
     unsigned long m_percentage;
+    ProgressChannel *m_progressChannel;
     
 };
 
@@ -2,9 +2,13 @@
 
 #include <QThread>
 #include <QFileInfo>
+#include <QElapsedTimer>
+#include <QTimer>
+#include <QQueue>
 #include <QDebug>
 
 #include "ArchiveTools/archiveinterface.h"
+#include "listingcache.h"
 
 class Job::JobThread : public QThread
 {
@@ -32,12 +36,67 @@ void Job::JobThread::run()
 }
 
 
+// Entries from the listing cache are sent in batches as from the backends
+static const int c_cacheBatchSize = 4096;
+
+// Interval of sampling the progress channel (ms)
+static const int c_progressInterval = 250;
+// Speed is averaged over this window (ms)
+static const int c_speedWindow = 3000;
+
+/* Moving window average of a growing byte counter */
+class Job::SpeedMeter
+{
+public:
+    void start()
+    {
+        m_samples.clear();
+        m_clock.start();
+    }
+
+    // Adds the current value of the counter, returns bytes per second
+    qint64 add(qint64 bytes)
+    {
+        Sample sample;
+        sample.time = m_clock.elapsed();
+        sample.bytes = bytes;
+        m_samples.enqueue(sample);
+
+        while (m_samples.count() > 2 && sample.time - m_samples.head().time > c_speedWindow) {
+            m_samples.dequeue();
+        }
+
+        const qint64 interval = sample.time - m_samples.head().time;
+        if (interval <= 0) {
+            return 0;
+        }
+        return (sample.bytes - m_samples.head().bytes) * 1000 / interval;
+    }
+
+private:
+    struct Sample {
+        qint64 time;
+        qint64 bytes;
+    };
+
+    QElapsedTimer m_clock;
+    QQueue<Sample> m_samples;
+};
+
+
 Job::Job(Archive *arch, QObject *parent)
     : QJob(parent)
     , m_archive(arch)
     , m_archiveInterface(arch->interface())
     , m_isRunning(false)
     , d(new JobThread(this))
+    , m_speedMeter(new SpeedMeter)
+    , m_progressTimer(new QTimer(this))
+    , m_archiveSize(0)
+    , m_totalSize(0)
+    , m_processedSize(0)
+    , m_totalEntries(0)
+    , m_processedEntries(0)
 {
     static bool onlyOnce = false;
     if (!onlyOnce) {
@@ -46,6 +105,12 @@ Job::Job(Archive *arch, QObject *parent)
     }
 
     setCapabilities(QJob::Killable);
+    setProgressChannel(m_archiveInterface->progressChannel());
+
+    m_progressTimer->setInterval(c_progressInterval);
+    connect(m_progressTimer, SIGNAL(timeout()), SLOT(sampleProgress()));
+    // finished() comes from the job thread, the timer lives in this one
+    connect(this, SIGNAL(finished(QJob*)), SLOT(stopSampling()));
 }
 
 Job::~Job()
@@ -58,6 +123,7 @@ Job::~Job()
     }
 
     delete d;
+    delete m_speedMeter;
 }
 
 ArchiveInterface *Job::archiveInterface()
@@ -83,6 +149,12 @@ Archive *Job::getArchive() const
 void Job::start()
 {
     m_isRunning = true;
+    progressChannel()->reset();
+    m_archiveSize = m_archive->archiveFileSize();
+    m_totalSize = m_processedSize = 0;
+    m_totalEntries = m_processedEntries = 0;
+    m_speedMeter->start();
+    m_progressTimer->start();
     d->start();
     emit started(this);
 }
@@ -97,14 +169,11 @@ void Job::connectToArchiveInterfaceSignals()
 {
     //qDebug()<<"Job::connectToArchiveInterfaceSignals(): archiveInterface: " << archiveInterface();
     connect(archiveInterface(), SIGNAL(error(QString,QString)), SLOT(onError(QString,QString)));
-    connect(archiveInterface(), SIGNAL(entry(ArchiveEntry)), SLOT(onEntry(ArchiveEntry)));
+    connect(archiveInterface(), SIGNAL(entries(ArchiveEntryList)), SLOT(onEntries(ArchiveEntryList)));
     connect(archiveInterface(), SIGNAL(entryRemoved(QString)), SLOT(onEntryRemoved(QString)));
-    connect(archiveInterface(), SIGNAL(totalProgress(int)), SLOT(onProgress(int)));
     connect(archiveInterface(), SIGNAL(encodingInfo(QString)), SLOT(onInfo(QString)));
     connect(archiveInterface(), SIGNAL(finished(bool)), SLOT(onFinished(bool)));
     connect(archiveInterface(), SIGNAL(userQuery(Query*)), SLOT(onUserQuery(Query*)));
-    connect(archiveInterface(), SIGNAL(currentFile(const QString &)), SIGNAL(currentFile(const QString &)));
-    connect(archiveInterface(), SIGNAL(currentFileProgress(int)), SIGNAL(currentFileProgress(int)));
 
     //archiveInterface()->moveToThread(this->d);
 }
@@ -119,15 +188,9 @@ void Job::onError(const QString & message, const QString & details)
     setErrorText(errTxt);
 }
 
-void Job::onEntry(const ArchiveEntry & archiveEntry)
-{
-    //qDebug() << "Job:onEntry \n\n";
-    emit newEntry(archiveEntry);
-}
-
-void Job::onProgress(int value)
+void Job::onEntries(const ArchiveEntryList &batch)
 {
-    setPercent(static_cast<unsigned long>(value));
+    emit newEntries(batch);
 }
 
 void Job::onInfo(const QString& _info)
@@ -144,6 +207,8 @@ void Job::onEntryRemoved(const QString & path)
 void Job::onFinished(bool result)
 {
     //qDebug() << "Job::onFinished(bool): " << result;
+    // zbývající dávka položek musí dorazit před result()
+    archiveInterface()->flushEntries();
     m_OK = result;
 
     //archiveInterface()->disconnect(this);
@@ -160,6 +225,70 @@ void Job::onThreadQuit()
     qDebug()<< "Job thread quit";
 }
 
+void Job::stopSampling()
+{
+    if (m_progressTimer->isActive()) {
+        m_progressTimer->stop();
+        sampleProgress();
+    }
+}
+
+/*
+ * Emits totalSize, processedSize, processedAmount, percent and speed from
+ * the counters of the backend. If the backend does not know the
+ * uncompressed size, the job is measured in bytes of the archive file:
+ * by its total percent (CLI backends, partial extraction) or by
+ * the compressed bytes read. Speed is always in the units of processedSize,
+ * so the time left is (totalSize - processedSize) / speed.
+ */
+void Job::sampleProgress()
+{
+    const ProgressChannel *channel = progressChannel();
+
+    qint64 total = channel->totalBytes();
+    qint64 processed = channel->processedBytes();
+    if (total <= 0) {
+        const int percent = channel->totalProgress();
+        total = m_archiveSize;
+        processed = percent >= 0 ? m_archiveSize * percent / 100 : channel->readBytes();
+    }
+
+    if (total != m_totalSize) {
+        // Other units, the old samples are useless
+        m_totalSize = total;
+        m_speedMeter->start();
+        emit totalSize(this, qMax(total, qint64(0)));
+    }
+    const qint64 bytesPerSecond = m_speedMeter->add(processed);
+
+    if (processed != m_processedSize) {
+        m_processedSize = processed;
+        emit processedSize(this, qBound(qint64(0), processed, qMax(total, qint64(0))));
+    }
+
+    // Backends without their own percent are measured by the bytes
+    int percent = channel->totalProgress();
+    if (percent < 0 && total > 0) {
+        percent = int(qBound(qint64(0), processed * 100 / total, qint64(100)));
+    }
+    if (percent >= 0) {
+        setPercent(percent);
+    }
+
+    const qint64 totalEntries = channel->totalEntries();
+    if (totalEntries != m_totalEntries) {
+        m_totalEntries = totalEntries;
+        emit totalAmount(this, QJob::Files, totalEntries);
+    }
+    const qint64 processedEntries = channel->processedEntries();
+    if (processedEntries != m_processedEntries) {
+        m_processedEntries = processedEntries;
+        emit processedAmount(this, QJob::Files, processedEntries);
+    }
+
+    emit speed(this, qMax(bytesPerSecond, qint64(0)));
+}
+
 bool Job::doKill()
 {
     qDebug();
@@ -175,8 +304,9 @@ ListJob::ListJob(Archive *arch, QObject *parent)
     , m_isSingleFolderArchive(true)
     , m_isPasswordProtected(false)
     , m_extractedFilesSize(0)
+    , m_collectEntries(false)
 {
-    connect(this, SIGNAL(newEntry(ArchiveEntry)), this, SLOT(onNewEntry(ArchiveEntry)));
+    connect(this, SIGNAL(newEntries(ArchiveEntryList)), this, SLOT(onNewEntries(ArchiveEntryList)));
 }
 
 ListJob::~ListJob()
@@ -189,14 +319,103 @@ void ListJob::doWork()
     emit description(this, tr("Loading archive"));
     emit currentArchive(archiveInterface()->filename());
     qDebug() << "ListJob::doWork(): Loading archive...";
+
+    if (listFromCache(true)) {
+        onFinished(true);
+        return;
+    }
+
+    collectEntriesForCache();
     connectToArchiveInterfaceSignals();
     bool ret = archiveInterface()->list();
 
     if (!archiveInterface()->waitForFinishedSignal()) {
+        saveCollectedEntries(ret);
         onFinished(ret);
     }
 }
 
+bool ListJob::listFromCache(bool keepCodePage)
+{
+    ArchiveEntryStore store;
+    if (!ListingCache::load(getArchive(), &store, keepCodePage)) {
+        return false;
+    }
+
+    // The backend does not detect the charset now, its info message is repeated
+    if (!archiveInterface()->detectedCharset().isEmpty()) {
+        onInfo(ArchiveInterface::charsetInfo(archiveInterface()->detectedCharsetDescription()));
+    }
+
+    // The model takes ArchiveEntryList, entries are created batch by batch
+    ArchiveEntryList batch;
+    batch.reserve(c_cacheBatchSize);
+    for (int id = 0; id < store.count(); ++id) {
+        batch.append(store.entry(id));
+        if (batch.count() == c_cacheBatchSize) {
+            onEntries(batch);
+            batch = ArchiveEntryList();
+            batch.reserve(c_cacheBatchSize);
+        }
+    }
+    if (!batch.isEmpty()) {
+        onEntries(batch);
+    }
+    return true;
+}
+
+/*
+ * DirectConnection: entries are collected and saved in the job thread.
+ * Must be connected before connectToArchiveInterfaceSignals(), so the cache
+ * is written before the queued finished() reaches the job.
+ */
+void ListJob::collectEntriesForCache()
+{
+    m_collectEntries = true;
+    ArchiveInterface *ifc = archiveInterface();
+    connect(ifc, SIGNAL(entries(ArchiveEntryList)), this, SLOT(collectEntries(ArchiveEntryList)), Qt::DirectConnection);
+    connect(ifc, SIGNAL(error(QString,QString)), this, SLOT(discardCollectedEntries()), Qt::DirectConnection);
+    connect(ifc, SIGNAL(finished(bool)), this, SLOT(saveCollectedEntries(bool)), Qt::DirectConnection);
+}
+
+void ListJob::stopCollectingEntries()
+{
+    m_collectEntries = false;
+    ArchiveInterface *ifc = archiveInterface();
+    ifc->disconnect(SIGNAL(entries(ArchiveEntryList)), this, SLOT(collectEntries(ArchiveEntryList)));
+    ifc->disconnect(SIGNAL(error(QString,QString)), this, SLOT(discardCollectedEntries()));
+    ifc->disconnect(SIGNAL(finished(bool)), this, SLOT(saveCollectedEntries(bool)));
+}
+
+void ListJob::collectEntries(const ArchiveEntryList &batch)
+{
+    foreach (const ArchiveEntry &entry, batch) {
+        m_listedEntries.append(entry);
+    }
+}
+
+/* Failed listing is not cached */
+void ListJob::discardCollectedEntries()
+{
+    stopCollectingEntries();
+    m_listedEntries.clear();
+}
+
+void ListJob::saveCollectedEntries(bool result)
+{
+    if (!m_collectEntries) {
+        return;
+    }
+
+    // zbývající dávka položek
+    archiveInterface()->flushEntries();
+    stopCollectingEntries();
+    if (result) {
+        ListingCache::save(getArchive(), m_listedEntries);
+    }
+    m_listedEntries.clear();
+}
+
 qlonglong ListJob::extractedFilesSize() const
 {
     return m_extractedFilesSize;
@@ -212,6 +431,13 @@ bool ListJob::isSingleFolderArchive() const
     return m_isSingleFolderArchive;
 }
 
+void ListJob::onNewEntries(const ArchiveEntryList &batch)
+{
+    foreach (const ArchiveEntry &entry, batch) {
+        onNewEntry(entry);
+    }
+}
+
 void ListJob::onNewEntry(const ArchiveEntry& entry)
 {
     m_extractedFilesSize += entry[ Size ].toLongLong();
@@ -422,7 +648,8 @@ void TestJob::onTestResult(const QString &line)
 
 
 OpenJob::OpenJob(Archive *arch, QObject *parent)
-    :Job(arch, parent)
+    :ListJob(arch, parent)
+    , m_entriesListed(false)
 {
 }
 
@@ -431,26 +658,34 @@ OpenJob::~OpenJob()
     qDebug("%s deleted...", metaObject()->className());
 }
 
-
-void OpenJob::onEntry(const ArchiveEntry &archiveEntry)
-{
-    Q_UNUSED(archiveEntry)
-    //    m_extractedFilesSize += entry[ Size ].toLongLong();
-    //    m_isPasswordProtected |= entry [ IsPasswordProtected ].toBool();
-}
-
 void OpenJob::doWork()
 {
     emit description(this, tr("Opening archive"));
     //emit infoMessage(this, tr("Please wait, QArchiver opening archive."));
     emit currentArchive(archiveInterface()->filename());
     //qDebug() << "OpenJob::doWork(): Opening archive...";
-    connectToArchiveInterfaceSignals();
+
+    if (listFromCache(false)) {
+        m_entriesListed = true;
+        onFinished(true);
+        return;
+    }
 
     ArchiveInterface *ifc = archiveInterface();
+    m_entriesListed = ifc->listsOnOpen();
+    if (m_entriesListed) {
+        collectEntriesForCache();
+    }
+    connectToArchiveInterfaceSignals();
     bool ret = ifc->open();
 
     if (!archiveInterface()->waitForFinishedSignal()) {
+        saveCollectedEntries(ret);
         onFinished(ret);
     }
 }
+
+bool OpenJob::entriesListed() const
+{
+    return m_entriesListed;
+}
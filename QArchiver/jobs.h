@@ -4,11 +4,13 @@
 #include "qarchive.h"
 #include "queries.h"
 #include "jobinterface.h"
+#include "archiveentrystore.h"
 #include <QObject>
 #include <QList>
 #include <QVariant>
 #include <QString>
 
+class QTimer;
 
 /*Jobs*/
 class Job : public QJob
@@ -37,21 +39,20 @@ public slots:
 protected slots:
     virtual void onError(const QString &message, const QString &details);
     virtual void onInfo(const QString &_info);
-    virtual void onEntry(const ArchiveEntry &archiveEntry);
-    virtual void onProgress(int progress);
+    virtual void onEntries(const ArchiveEntryList &batch);
     virtual void onEntryRemoved(const QString &path);
     virtual void onFinished(bool result);
     virtual void onUserQuery(Query *query);
     void onThreadQuit();
+    void sampleProgress();
+    void stopSampling();
 
 signals:
     void entryRemoved(const QString & entry);
     void error(const QString& errorMessage, const QString& details);
-    void newEntry(const ArchiveEntry &);
+    void newEntries(const ArchiveEntryList &);
     void userQuery(Query*);
     void currentArchive(const QString &fileName);
-    void currentFile(const QString &fileName);
-    void currentFileProgress(int progress);
     void info(const QString &plain);
 
 private:
@@ -63,6 +64,16 @@ private:
 
     class JobThread;
     JobThread * const d;
+
+    // Throughput of the backend, sampled from the progress channel
+    class SpeedMeter;
+    SpeedMeter * const m_speedMeter;
+    QTimer *m_progressTimer;
+    qint64 m_archiveSize;
+    qint64 m_totalSize;
+    qint64 m_processedSize;
+    qint64 m_totalEntries;
+    qint64 m_processedEntries;
 }; // END class Job
 
 
@@ -82,15 +93,29 @@ public:
 public slots:
     virtual void doWork();
 
+protected:
+    bool listFromCache(bool keepCodePage);
+    void collectEntriesForCache();
+
+protected slots:
+    void saveCollectedEntries(bool result);
+
 private:
+    void onNewEntry(const ArchiveEntry &entry);
+    void stopCollectingEntries();
+
     bool m_isSingleFolderArchive;
     bool m_isPasswordProtected;
     QString m_subfolderName;
     QString m_basePath;
     qlonglong m_extractedFilesSize;
+    bool m_collectEntries;
+    ArchiveEntryStore m_listedEntries; // entries for the listing cache
 
 private slots:
-    void onNewEntry(const ArchiveEntry&);
+    void onNewEntries(const ArchiveEntryList &batch);
+    void collectEntries(const ArchiveEntryList &batch);
+    void discardCollectedEntries();
 }; // END class ListJob
 
 class ExtractJob : public Job
@@ -170,18 +195,23 @@ private:
 }; // END class TestJob
 
 
-class OpenJob : public Job
+// Backends with listsOnOpen() emit the entries already while opening,
+// the listing can be loaded from the cache as well.
+// OpenJob then collects the same information as ListJob.
+class OpenJob : public ListJob
 {
     Q_OBJECT
 public:
     explicit OpenJob(Archive *arch, QObject *parent = 0);
     virtual ~OpenJob();
 
-protected slots:
-    virtual void onEntry(const ArchiveEntry &archiveEntry);
+    bool entriesListed() const;
 
 public slots:
     virtual void doWork();
+
+private:
+    bool m_entriesListed;
 }; // END class OpenJob
 
 
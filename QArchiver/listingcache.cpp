@@ -0,0 +1,219 @@
+#include "listingcache.h"
+
+#include <sys/types.h>
+#include <sys/stat.h>
+#ifdef Q_OS_WIN
+  #include <sys/utime.h>
+#else
+  #include <utime.h>
+#endif
+
+#include "qstandarddirs.h"
+#include "archiveentrystore.h"
+#include "ArchiveTools/archiveinterface.h"
+
+#include <QCryptographicHash>
+#include <QDataStream>
+#include <QDir>
+#include <QFile>
+#include <QFileInfo>
+#include <QDebug>
+
+static const quint32 c_cacheMagic = 0x51414c43; // "QALC"
+static const quint16 c_cacheVersion = 4;
+static const qint64 c_maxCacheSize = Q_INT64_C(512) * 1024 * 1024;
+
+bool ListingCache::fileKey(const QString &fileName, Key *key)
+{
+    const QString absPath = QFileInfo(fileName).absoluteFilePath();
+
+    struct stat st;
+    if (::stat(QFile::encodeName(absPath), &st) != 0) {
+        return false;
+    }
+
+    key->path = absPath;
+    key->size = st.st_size;
+    key->mtime = st.st_mtime;
+    key->ctime = st.st_ctime;
+    // In-place zápis zachová inode, sekundy nestačí
+#if defined(Q_OS_MAC)
+    key->mtimeNsec = st.st_mtimespec.tv_nsec;
+    key->ctimeNsec = st.st_ctimespec.tv_nsec;
+#elif defined(Q_OS_UNIX)
+    key->mtimeNsec = st.st_mtim.tv_nsec;
+    key->ctimeNsec = st.st_ctim.tv_nsec;
+#else
+    key->mtimeNsec = 0;
+    key->ctimeNsec = 0;
+#endif
+    key->inode = st.st_ino; // Windows: vždy 0
+    return true;
+}
+
+QString ListingCache::cacheFilePath(const QString &absPath)
+{
+    const QByteArray hash = QCryptographicHash::hash(absPath.toUtf8(), QCryptographicHash::Sha1).toHex();
+    return QStandardDirs::cacheLocation("listings") + QLatin1Char('/') + QString::fromLatin1(hash) + QLatin1String(".idx");
+}
+
+bool ListingCache::load(Archive *archive, ArchiveEntryStore *entries, bool keepCodePage)
+{
+    Key key;
+    if (!fileKey(archive->fileName(), &key)) {
+        return false;
+    }
+
+    QFile file(cacheFilePath(key.path));
+    if (!file.open(QIODevice::ReadOnly)) {
+        return false;
+    }
+
+    QDataStream in(&file);
+    in.setVersion(QDataStream::Qt_4_8);
+
+    quint32 magic;
+    quint16 version;
+    in >> magic >> version;
+    if (magic != c_cacheMagic || version != c_cacheVersion) {
+        return false;
+    }
+
+    Key cached;
+    in >> cached.path >> cached.size >> cached.mtime >> cached.mtimeNsec
+       >> cached.ctime >> cached.ctimeNsec >> cached.inode;
+    if (cached.path != key.path || cached.size != key.size
+            || cached.mtime != key.mtime || cached.mtimeNsec != key.mtimeNsec
+            || cached.ctime != key.ctime || cached.ctimeNsec != key.ctimeNsec
+            || cached.inode != key.inode) {
+        qDebug() << "ListingCache: archive changed, cached listing is out of date";
+        file.close();
+        remove(key.path);
+        return false;
+    }
+
+    qint32 entryCount;
+    qint64 extractedSize;
+    qint64 compressedSize;
+    QString codePage;
+    QString charset;
+    QString charsetDescription;
+    QVariantMap ifaceData;
+    in >> entryCount >> extractedSize >> compressedSize >> codePage
+       >> charset >> charsetDescription >> ifaceData;
+
+    if (keepCodePage && codePage != archive->codePage()) {
+        return false;
+    }
+
+    ArchiveEntryStore cachedEntries;
+    if (in.status() != QDataStream::Ok || !cachedEntries.load(in)) {
+        qDebug() << "ListingCache: corrupted cache file" << file.fileName();
+        return false;
+    }
+
+    archive->setEntryCount(entryCount);
+    archive->setExtractedSize(extractedSize);
+    archive->setCompressedSize(compressedSize);
+    if (!keepCodePage) {
+        archive->setCodePage(codePage);
+    }
+    archive->interface()->setDetectedCharset(charset, charsetDescription);
+    archive->interface()->setCacheData(ifaceData);
+
+    entries->swap(cachedEntries);
+    qDebug() << "ListingCache: loaded" << entries->count() << "entries for" << key.path;
+
+    // mtime of the cache file is the last use for trim()
+    file.close();
+    ::utime(QFile::encodeName(file.fileName()).constData(), NULL);
+    return true;
+}
+
+bool ListingCache::save(Archive *archive, const ArchiveEntryStore &entries)
+{
+    Key key;
+    if (!fileKey(archive->fileName(), &key)) {
+        return false;
+    }
+
+    // Names of encrypted archives must not be readable without the password
+    if (isEncrypted(archive, entries)) {
+        remove(key.path);
+        return false;
+    }
+
+    const QString cacheFile = cacheFilePath(key.path);
+    QFile file(cacheFile + QLatin1String(".Temp"));
+    if (!file.open(QIODevice::WriteOnly | QIODevice::Truncate)) {
+        qDebug() << "ListingCache: can't write" << file.fileName();
+        return false;
+    }
+
+    QDataStream out(&file);
+    out.setVersion(QDataStream::Qt_4_8);
+
+    out << c_cacheMagic << c_cacheVersion;
+    out << key.path << key.size << key.mtime << key.mtimeNsec
+        << key.ctime << key.ctimeNsec << key.inode;
+    out << qint32(archive->entryCount())
+        << qint64(archive->extractedSize())
+        << qint64(archive->compressedSize())
+        << archive->codePage()
+        << archive->interface()->detectedCharset()
+        << archive->interface()->detectedCharsetDescription()
+        << archive->interface()->cacheData();
+    entries.save(out);
+
+    file.close();
+    if (out.status() != QDataStream::Ok) {
+        file.remove();
+        return false;
+    }
+
+    QFile::remove(cacheFile);
+    if (!file.rename(cacheFile)) {
+        return false;
+    }
+
+    trim();
+    return true;
+}
+
+/* Password entered for listing means encrypted headers (7z -mhe, rar -hp) */
+bool ListingCache::isEncrypted(Archive *archive, const ArchiveEntryStore &entries)
+{
+    if (archive->isPasswordProtected() || !archive->password().isEmpty()
+            || !archive->interface()->password().isEmpty()) {
+        return true;
+    }
+    for (int id = 0; id < entries.count(); ++id) {
+        if (entries.isPasswordProtected(id)) {
+            return true;
+        }
+    }
+    return false;
+}
+
+/* Removes the least recently used listings above c_maxCacheSize */
+void ListingCache::trim()
+{
+    const QDir dir(QStandardDirs::cacheLocation("listings"));
+    const QFileInfoList files = dir.entryInfoList(QStringList() << QLatin1String("*.idx"), QDir::Files, QDir::Time);
+
+    qint64 total = 0;
+    for (int i = 0; i < files.count(); ++i) {
+        total += files.at(i).size();
+        // The newest one is kept even if it is bigger than the limit
+        if (i > 0 && total > c_maxCacheSize) {
+            qDebug() << "ListingCache: removing" << files.at(i).fileName();
+            QFile::remove(files.at(i).absoluteFilePath());
+        }
+    }
+}
+
+void ListingCache::remove(const QString &fileName)
+{
+    const QString absPath = QFileInfo(fileName).absoluteFilePath();
+    QFile::remove(cacheFilePath(absPath));
+}
@@ -0,0 +1,45 @@
+#ifndef LISTINGCACHE_H
+#define LISTINGCACHE_H
+
+#include <QString>
+
+#include "qarchive.h"
+
+class ArchiveEntryStore;
+
+/*
+ * Persistent cache of archive listings (entries + archive informations).
+ * Entries are stored as the string tables and columns of ArchiveEntryStore.
+ * Cached listing is valid only for the same path, size, mtime, ctime
+ * (with nanoseconds where available) and inode of the archive file.
+ * The charset detected by the backend is kept for its info message.
+ * Listings of password protected archives are not cached. The least
+ * recently used listings are removed above c_maxCacheSize.
+ */
+class ListingCache
+{
+public:
+    // keepCodePage: listing must match current codepage of the archive,
+    // otherwise codepage is restored from the cache
+    static bool load(Archive *archive, ArchiveEntryStore *entries, bool keepCodePage);
+    static bool save(Archive *archive, const ArchiveEntryStore &entries);
+    static void remove(const QString &fileName);
+
+private:
+    struct Key {
+        QString path;
+        qint64 size;
+        qint64 mtime;
+        qint64 mtimeNsec;
+        qint64 ctime;
+        qint64 ctimeNsec;
+        quint64 inode;
+    };
+
+    static bool fileKey(const QString &fileName, Key *key);
+    static QString cacheFilePath(const QString &absPath);
+    static bool isEncrypted(Archive *archive, const ArchiveEntryStore &entries);
+    static void trim();
+};
+
+#endif // LISTINGCACHE_H
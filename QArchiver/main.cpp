@@ -3,6 +3,7 @@
 #include "mainwindow.h"
 #include "addtoarchive.h"
 #include "progressdialog.h"
+#include "qarchive.h"
 #include "Codecs/qibm852codec.h"
 #include <QtMimeTypes/QMimeDatabase>
 #include <QDebug>
@@ -73,6 +74,12 @@ int main(int argc, char *argv[])
             addToArchiveJob->setAutoFilenameSuffix(args.value("autofilename").toString());
         }
 
+        if (args.contains("update")) {
+            addToArchiveJob->setAddMode(AddNew);
+        } else if (args.contains("freshen")) {
+            addToArchiveJob->setAddMode(AddExisting);
+        }
+
         if (args.contains("file")) {
             addToArchiveJob->addFiles(args.values("file"));
         }
@@ -123,12 +130,14 @@ void parseArgs(QMap<QString, QVariant> &args, int argc, char *argv[])
             {"add-to",          required_argument,  0, 't'},
             {"autofilename",    required_argument,  0, 'f'},
             {"dialog",          no_argument,        0, 'd'},
+            {"update",          no_argument,        0, 'u'},
+            {"freshen",         no_argument,        0, 'r'},
             {0, 0, 0, 0}
         };
         /* getopt_long stores the option index here. */
         int option_index = 0;
 
-        c = getopt_long(argc, argv, "ct:pf:bead", long_options, &option_index);
+        c = getopt_long(argc, argv, "ct:pf:beadur", long_options, &option_index);
 
         /* Detect the end of the options. */
         if (c == -1)
@@ -166,6 +175,16 @@ void parseArgs(QMap<QString, QVariant> &args, int argc, char *argv[])
             args.insert("dialog", (int)NULL);
             break;
 
+        case 'u':
+            qDebug ("option -u (--update)");
+            args.insert("update", (int)NULL);
+            break;
+
+        case 'r':
+            qDebug ("option -r (--freshen)");
+            args.insert("freshen", (int)NULL);
+            break;
+
         case '?':
             /* getopt_long already printed an error message. */
             break;
@@ -27,6 +27,8 @@
 #include "qstandarddirs.h"
 #include "Codecs/textencoder.h"
 #include "infoframe.h"
+#include "searchframe.h"
+#include "selectionmatcher.h"
 #include "filesystemmodel.h"
 
 #define DEFAULT_CP_TEXT ""
@@ -186,6 +188,7 @@ MainWindow::MainWindow(QWidget *parent) :
     readSettings();
 
     createInfoDockWindow();
+    createSearchDockWindow();
 
     // Enable drop operation on window
     setAcceptDrops(true);
@@ -458,6 +461,27 @@ void MainWindow::createInfoDockWindow()
     menuView->addAction(dockViewActtion);
 }
 
+void MainWindow::createSearchDockWindow()
+{
+    QDockWidget *dock = new QDockWidget(tr("Search"), this);
+    dock->setAllowedAreas(Qt::LeftDockWidgetArea | Qt::RightDockWidgetArea);
+    dock->hide();
+
+    m_searchFrame = new SearchFrame(dock);
+    m_searchFrame->setArchiveModel(m_archiveModel);
+    dock->setWidget(m_searchFrame);
+    addDockWidget(Qt::LeftDockWidgetArea, dock);
+    dock->setFeatures(QDockWidget::NoDockWidgetFeatures);
+
+    connect(m_searchFrame, SIGNAL(entryActivated(QString)), this, SLOT(showEntry(QString)));
+
+    // "View" -> "Search"
+    QAction *dockViewActtion = dock->toggleViewAction();
+    dockViewActtion->setShortcut(QKeySequence::Find);
+    dockViewActtion->setEnabled(true);
+    menuView->addAction(dockViewActtion);
+}
+
 bool MainWindow::isSingleEntryArchive() const
 {
     //return m_archiveModel->archive()->isSingleFolderArchive();
@@ -494,16 +518,35 @@ QList<QVariant> MainWindow::selectedFilesWithChildren()
 {
     Q_ASSERT(m_archiveModel);
 
-    QModelIndexList toIterate = ui->treeViewContent->selectionModel()->selectedRows();
+    const QModelIndexList selected = ui->treeViewContent->selectionModel()->selectedRows();
+
+    // Rows inside a selected folder are visited with the folder
+    SelectionMatcher selectedDirs;
+    QStringList paths;
+    foreach (const QModelIndex &index, selected) {
+        paths << m_archiveModel->entryForIndex(index)[ FileName ].toString();
+        if (m_archiveModel->hasChildren(index)) {
+            selectedDirs.addDirectory(paths.last());
+        }
+    }
+
+    QModelIndexList toIterate;
+    for (int i = 0; i < selected.size(); ++i) {
+        if (!selectedDirs.matchesParent(paths.at(i))) {
+            toIterate << selected.at(i);
+        }
+    }
 
     for (int i = 0; i < toIterate.size(); ++i) {
         QModelIndex index = toIterate.at(i);
 
+        // Children of not expanded folders in lazy mode
+        if (m_archiveModel->canFetchMore(index)) {
+            m_archiveModel->fetchMore(index);
+        }
+
         for (int j = 0; j < m_archiveModel->rowCount(index); ++j) {
-            QModelIndex child = m_archiveModel->index(j, 0, index);
-            if (!toIterate.contains(child)) {
-                toIterate << child;
-            }
+            toIterate << m_archiveModel->index(j, 0, index);
         }
     }
 
@@ -691,6 +734,7 @@ void MainWindow::closeArchive()
     delete m_archiveModel;
     m_archiveModel = NULL;
     m_infoFrame->setArchiveModel(m_archiveModel);
+    m_searchFrame->setArchiveModel(m_archiveModel);
 
     m_archiveMode = false;
     ui->actionClose_archive->setEnabled(m_archiveMode);
@@ -784,6 +828,7 @@ bool MainWindow::openFile(const QString &filePath)
     // ukazatel uvnitř QScopedPointer resetovan na NULL
     m_archiveModel->setArchive(archive.take());
 
+    readArchiveModelSettings();
     OpenJob* job = m_archiveModel->openArchive();
     registerJob(job);
     connect(job, SIGNAL(result(QJob*)), this, SLOT(slotOpenDone(QJob*)));
@@ -1019,6 +1064,7 @@ void MainWindow::on_treeViewContent_doubleClicked(const QModelIndex &index)
 
             m_archiveModel->setArchive(archive); // ToDo: nevolat před viewArchive();
 
+            readArchiveModelSettings();
             OpenJob* job = m_archiveModel->openArchive();
             registerJob(job);
             connect(job, SIGNAL(result(QJob*)), this, SLOT(slotOpenDone(QJob*)));
@@ -1084,6 +1130,7 @@ void MainWindow::viewArchive()
     ui->treeViewContent->setSortingEnabled(true);
 
     m_infoFrame->setArchiveModel(m_archiveModel);
+    m_searchFrame->setArchiveModel(m_archiveModel);
 
     delete sm_tvc;
     sm_tvc = NULL;
@@ -1104,6 +1151,8 @@ void MainWindow::viewArchive()
     connect(m_archiveModel, SIGNAL(loadingStarted(QJob*)), this, SLOT(slotLoadingStarted(QJob*))); //loadingStarted emited in setArchive() > nikdy se neprovede!! Connecty přesunout hned za vytvoření archiveModelu
     connect(m_archiveModel, SIGNAL(loadingFinished(QJob*)), this, SLOT(slotLoadingFinished(QJob*)));
     connect(m_archiveModel, SIGNAL(error(QString,QString)), this, SLOT(showErrorMessage(QString,QString)));
+    // Lazy mode: nodes of collapsed folders are released
+    connect(ui->treeViewContent, SIGNAL(collapsed(QModelIndex)), m_archiveModel, SLOT(releaseChildren(QModelIndex)), Qt::UniqueConnection);
     //debugArchiveModel();
 
     //qDebug() << "ReSeting wiew";
@@ -1175,6 +1224,14 @@ void MainWindow::readSettings()
     m_recentFilesMenu->loadEntries(settings);
 }
 
+/* Options applied by the model to the next opened archive */
+void MainWindow::readArchiveModelSettings()
+{
+    QSettings settings;
+    m_archiveModel->setLazyLoading(settings.value("lazyLoading", false).toBool());
+    m_archiveModel->setNaturalSorting(settings.value("naturalSorting", true).toBool());
+}
+
 /*
  * Kliknutí na akci "Test"
  */
@@ -1252,7 +1309,10 @@ void MainWindow::slotOpenDone(QJob *job)
     }
     OpenJob* openJob = qobject_cast<OpenJob *>(job);
     if(openJob->success()) {
-        QTimer::singleShot(0, m_archiveModel, SLOT(listArchive()));
+        // Backend may have listed the archive while opening
+        if (!m_archiveModel->isArchiveOpen()) {
+            QTimer::singleShot(0, m_archiveModel, SLOT(listArchive()));
+        }
         /*ListJob* job = m_archiveModel->listArchive();*/
     }else {
         // Nemazat hned, Nechat eventLoop dokončit události
@@ -1334,6 +1394,7 @@ void MainWindow::slotLoadingFinished(QJob *job)
     }
 
     updateActions();
+    m_searchFrame->updateIndex();
 
     if (m_openArgs.getOption(QLatin1String( "showExtractDialog" )) == QLatin1String( "true" )) {
         QTimer::singleShot(0, this, SLOT(slotExtractFiles()));
@@ -1564,6 +1625,7 @@ void MainWindow::slotAddFilesDone(QJob *job)
 
     ui->treeViewContent->sortByColumn(0, Qt::AscendingOrder);
     ui->treeViewContent->expandToDepth(0);
+    m_searchFrame->updateIndex();
 }
 
 
@@ -1593,6 +1655,7 @@ void MainWindow::slotDeleteFilesDone(QJob *job)
     if (job->error()) {
         QMessageBox::critical(this, tr("Error", "@title:window"), job->errorString());
     }
+    m_searchFrame->updateIndex();
 }
 
 
@@ -1746,6 +1809,26 @@ void MainWindow::slotChangeCodepage()
 }
 
 
+/* Select the entry found by the search */
+void MainWindow::showEntry(const QString &path)
+{
+    if (!m_archiveMode || isBusy()) {
+        return;
+    }
+
+    const QModelIndex index = m_archiveModel->indexForPath(path);
+    if (!index.isValid()) {
+        return;
+    }
+
+    for (QModelIndex parent = index.parent(); parent.isValid(); parent = parent.parent()) {
+        ui->treeViewContent->expand(parent);
+    }
+    ui->treeViewContent->scrollTo(index);
+    ui->treeViewContent->selectionModel()->setCurrentIndex(index, QItemSelectionModel::ClearAndSelect | QItemSelectionModel::Rows);
+}
+
+
 void MainWindow::smazan(QObject * obj)
 {
     qDebug() << "QObject:" << obj << "dealokován";
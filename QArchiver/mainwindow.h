@@ -19,6 +19,7 @@ class MainWindow;
 class QDuoLed;
 class QClickableLabel;
 class InfoFrame;
+class SearchFrame;
 class PropertiesDialog;
 class SettingsDialog;
 class ProgressDialog;
@@ -39,6 +40,7 @@ protected:
     void viewFileSystem();
     void writeSettings();
     void readSettings();
+    void readArchiveModelSettings();
 
     QStringList suffixesFromFilterStr(const QString& filterStr);
     QString suffixFromFilterStr(const QString& filterStr);
@@ -60,6 +62,7 @@ private:
     void createMenuView();
     void createMenuActions();
     void createInfoDockWindow();
+    void createSearchDockWindow();
     void setupModelsAndViews();
     bool isSingleEntryArchive() const;
     QString detectSubfolder() const;
@@ -116,6 +119,7 @@ private slots:
     void slotPreview(const QModelIndex & index);
     void slotPreviewExtracted(QJob *job);
     void slotChangeCodepage();
+    void showEntry(const QString &path);
 
 // debug:
     void smazan(QObject *obj);  // debug
@@ -140,6 +144,7 @@ private:
 
     QRecentFilesMenu *m_recentFilesMenu;
     InfoFrame *m_infoFrame;
+    SearchFrame *m_searchFrame;
 
     QByteArray m_treeViewContentHeaderState;
     OpenArguments m_openArgs;
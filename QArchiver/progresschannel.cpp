@@ -0,0 +1,176 @@
+#include "progresschannel.h"
+
+#include <QMutexLocker>
+
+// QAtomicInt has load()/store() since Qt 5
+static inline int loadInt(const QAtomicInt &value)
+{
+#if (QT_VERSION >= QT_VERSION_CHECK(5, 0, 0))
+    return value.load();
+#else
+    return value;
+#endif
+}
+
+static inline void storeInt(QAtomicInt &value, int newValue)
+{
+#if (QT_VERSION >= QT_VERSION_CHECK(5, 0, 0))
+    value.store(newValue);
+#else
+    value = newValue;
+#endif
+}
+
+
+ProgressCounter::ProgressCounter()
+    : m_value(0)
+{
+}
+
+#if (QT_VERSION >= QT_VERSION_CHECK(5, 3, 0))
+
+void ProgressCounter::store(qint64 value)
+{
+    m_value.store(value);
+}
+
+void ProgressCounter::add(qint64 delta)
+{
+    m_value.fetchAndAddRelaxed(delta);
+}
+
+qint64 ProgressCounter::load() const
+{
+    return m_value.load();
+}
+
+#else
+
+void ProgressCounter::store(qint64 value)
+{
+    QMutexLocker locker(&m_mutex);
+    m_value = value;
+}
+
+void ProgressCounter::add(qint64 delta)
+{
+    QMutexLocker locker(&m_mutex);
+    m_value += delta;
+}
+
+qint64 ProgressCounter::load() const
+{
+    QMutexLocker locker(&m_mutex);
+    return m_value;
+}
+
+#endif
+
+
+ProgressChannel::ProgressChannel()
+    : m_totalProgress(NoProgress)
+    , m_fileProgress(NoProgress)
+    , m_fileSerial(0)
+{
+}
+
+void ProgressChannel::reset()
+{
+    storeInt(m_totalProgress, NoProgress);
+    storeInt(m_fileProgress, NoProgress);
+    setCurrentFile(QString());
+
+    m_totalBytes.store(0);
+    m_processedBytes.store(0);
+    m_readBytes.store(0);
+    m_totalEntries.store(0);
+    m_processedEntries.store(0);
+}
+
+void ProgressChannel::setTotalProgress(int percent)
+{
+    storeInt(m_totalProgress, percent);
+}
+
+int ProgressChannel::totalProgress() const
+{
+    return loadInt(m_totalProgress);
+}
+
+void ProgressChannel::setCurrentFileProgress(int percent)
+{
+    storeInt(m_fileProgress, percent);
+}
+
+int ProgressChannel::currentFileProgress() const
+{
+    return loadInt(m_fileProgress);
+}
+
+void ProgressChannel::setCurrentFile(const QString &name)
+{
+    QMutexLocker locker(&m_fileMutex);
+    m_currentFile = name;
+    m_fileSerial.fetchAndAddRelease(1);
+}
+
+QString ProgressChannel::currentFile() const
+{
+    QMutexLocker locker(&m_fileMutex);
+    return m_currentFile;
+}
+
+int ProgressChannel::currentFileSerial() const
+{
+    return loadInt(m_fileSerial);
+}
+
+void ProgressChannel::setTotalBytes(qint64 bytes)
+{
+    m_totalBytes.store(bytes);
+}
+
+qint64 ProgressChannel::totalBytes() const
+{
+    return m_totalBytes.load();
+}
+
+void ProgressChannel::addProcessedBytes(qint64 bytes)
+{
+    m_processedBytes.add(bytes);
+}
+
+qint64 ProgressChannel::processedBytes() const
+{
+    return m_processedBytes.load();
+}
+
+void ProgressChannel::setReadBytes(qint64 bytes)
+{
+    m_readBytes.store(bytes);
+}
+
+qint64 ProgressChannel::readBytes() const
+{
+    return m_readBytes.load();
+}
+
+void ProgressChannel::setTotalEntries(qint64 count)
+{
+    m_totalEntries.store(count);
+}
+
+qint64 ProgressChannel::totalEntries() const
+{
+    return m_totalEntries.load();
+}
+
+void ProgressChannel::addProcessedEntries(qint64 count)
+{
+    m_processedEntries.add(count);
+}
+
+qint64 ProgressChannel::processedEntries() const
+{
+    return m_processedEntries.load();
+}
@@ -0,0 +1,89 @@
+#ifndef PROGRESSCHANNEL_H
+#define PROGRESSCHANNEL_H
+
+#include <QAtomicInt>
+#include <QMutex>
+#include <QString>
+
+/* 64-bit counter updated by the worker thread and read by the GUI */
+class ProgressCounter
+{
+public:
+    ProgressCounter();
+
+    void store(qint64 value);
+    void add(qint64 delta);
+    qint64 load() const;
+
+private:
+#if (QT_VERSION >= QT_VERSION_CHECK(5, 3, 0))
+    QAtomicInteger<qint64> m_value;
+#else
+    // Qt 4 has no 64-bit atomics
+    mutable QMutex m_mutex;
+    qint64 m_value;
+#endif
+};
+
+
+/*
+ * Progress of a running job. The backend only stores the values, no signal
+ * is emitted, the GUI samples them with a timer (see ProgressDialog).
+ * Numbers are atomic, the file name is guarded by a mutex taken
+ * once per entry.
+ */
+class ProgressChannel
+{
+public:
+    enum Progress {
+        NoProgress = -1,    // not known yet
+        HiddenProgress = -2 // current file progress is not shown
+    };
+
+    ProgressChannel();
+
+    void reset();
+
+    // Percent of the whole job
+    void setTotalProgress(int percent);
+    int totalProgress() const;
+
+    // Percent of the current file
+    void setCurrentFileProgress(int percent);
+    int currentFileProgress() const;
+
+    void setCurrentFile(const QString &name);
+    QString currentFile() const;
+    // Changed by every setCurrentFile(), the name needs to be read only if it differs
+    int currentFileSerial() const;
+
+    // Uncompressed data extracted, tested or added
+    void setTotalBytes(qint64 bytes);
+    qint64 totalBytes() const;
+    void addProcessedBytes(qint64 bytes);
+    qint64 processedBytes() const;
+
+    // Compressed data read from the archive file so far
+    void setReadBytes(qint64 bytes);
+    qint64 readBytes() const;
+
+    void setTotalEntries(qint64 count);
+    qint64 totalEntries() const;
+    void addProcessedEntries(qint64 count = 1);
+    qint64 processedEntries() const;
+
+private:
+    QAtomicInt m_totalProgress;
+    QAtomicInt m_fileProgress;
+    QAtomicInt m_fileSerial;
+    mutable QMutex m_fileMutex;
+    QString m_currentFile;
+
+    ProgressCounter m_totalBytes;
+    ProgressCounter m_processedBytes;
+    ProgressCounter m_readBytes;
+    ProgressCounter m_totalEntries;
+    ProgressCounter m_processedEntries;
+};
+
+#endif // PROGRESSCHANNEL_H
@@ -2,10 +2,22 @@
 #include "ui_progressdialog.h"
 
 #include "iconprovider.h"
+#include "progresschannel.h"
+#include "QSizeFormater.h"
+
+// Interval of sampling the job progress (ms)
+static const int c_sampleInterval = 100;
 
 ProgressDialog::ProgressDialog(QWidget *parent) :
     QDialog(parent),
-    ui(new Ui::ProgressDialog)
+    ui(new Ui::ProgressDialog),
+    m_channel(0),
+    m_totalProgress(ProgressChannel::NoProgress),
+    m_fileProgress(ProgressChannel::NoProgress),
+    m_fileSerial(-1),
+    m_totalSize(0),
+    m_processedSize(0),
+    m_speed(0)
 {
     ui->setupUi(this);
     this->setWindowTitle(qApp->applicationName());
@@ -25,9 +37,9 @@ ProgressDialog::ProgressDialog(QWidget *parent) :
 
     elapsed = 0;
     timer = new QTimer(this);
-    timer->setInterval(1000); // 1s
+    timer->setInterval(c_sampleInterval);
+    connect(timer, SIGNAL(timeout()), this, SLOT(sampleProgress()));
     connect(timer, SIGNAL(timeout()), this, SLOT(updateElapsed()));
-    connect(timer, SIGNAL(timeout()), this, SLOT(updateTimeLeft()));
 }
 
 ProgressDialog::~ProgressDialog()
@@ -50,6 +62,8 @@ void ProgressDialog::resetUi()
     ui->currentFileProgressBar->setValue(0);
     ui->currentFileProgressBar->setMinimum(0);
     ui->currentFileProgressBar->setMaximum(0);
+
+    ui->label_8->setText("--");
 }
 
 void ProgressDialog::setCurrentLabelText(const QString &text)
@@ -100,12 +114,14 @@ void ProgressDialog::onJobStarted(QJob* job)
 {
     Q_UNUSED(job);
     elapsed = 0;
+    clock.start();
     timer->start();
 }
 
 void ProgressDialog::onJobFinished(QJob* job)
 {
     Q_UNUSED(job);
+    sampleProgress();
     this->jobFinished();
     this->hide();
 }
@@ -114,10 +130,20 @@ void ProgressDialog::registerJob(QJob *job)
 {
     this->resetUi();
 
+    // File names and progress are not signalled, the timer samples them
+    m_channel = job->progressChannel();
+    m_totalProgress = ProgressChannel::NoProgress;
+    m_fileProgress = ProgressChannel::NoProgress;
+    m_fileSerial = -1;
+    m_totalSize = 0;
+    m_processedSize = 0;
+    m_speed = 0;
+
     connect(job, SIGNAL(percent(QJob*,ulong)), this, SLOT(setTotalProgress(QJob*,ulong)));
     connect(job, SIGNAL(currentArchive(const QString&)), this, SLOT(setTotalDescription(const QString&)));
-    connect(job, SIGNAL(currentFile(const QString&)), this, SLOT(setCurrentLabelText(const QString&)));
-    connect(job, SIGNAL(currentFileProgress(int)), this, SLOT(setCurrentProgress(int)));
+    connect(job, SIGNAL(totalSize(QJob*,qulonglong)), this, SLOT(setTotalSize(QJob*,qulonglong)));
+    connect(job, SIGNAL(processedSize(QJob*,qulonglong)), this, SLOT(setProcessedSize(QJob*,qulonglong)));
+    connect(job, SIGNAL(speed(QJob*,ulong)), this, SLOT(setSpeed(QJob*,ulong)));
 
 
     QObject::connect(job, SIGNAL(started(QJob*)), this, SLOT(onJobStarted(QJob*)));
@@ -146,6 +172,7 @@ void ProgressDialog::registerJob(QJob *job)
 void ProgressDialog::unregisterJob(QJob *job)
 {
     job->disconnect(this);
+    m_channel = 0;
 }
 
 void ProgressDialog::jobFinished()
@@ -159,6 +186,29 @@ void ProgressDialog::onJobPercent(QJob *job, unsigned long percent)
     setTotalProgress(percent);
 }
 
+void ProgressDialog::setTotalSize(QJob *job, qulonglong size)
+{
+    Q_UNUSED(job)
+    m_totalSize = size;
+}
+
+void ProgressDialog::setProcessedSize(QJob *job, qulonglong size)
+{
+    Q_UNUSED(job)
+    m_processedSize = size;
+}
+
+void ProgressDialog::setSpeed(QJob *job, unsigned long bytesPerSecond)
+{
+    Q_UNUSED(job)
+    m_speed = bytesPerSecond;
+    if (bytesPerSecond > 0) {
+        ui->label_8->setText(tr("%1/s").arg(QSizeFormater::convertSize(bytesPerSecond)));
+    } else {
+        ui->label_8->setText("--");
+    }
+}
+
 void ProgressDialog::setDescription(QJob *job, const QString &title, const QPair<QString, QString> &f1, const QPair<QString, QString> &f2)
 {
     Q_UNUSED(job)
@@ -186,7 +236,13 @@ void ProgressDialog::setCompletedValue(int value)
 
 void ProgressDialog::updateElapsed()
 {
-    elapsed++;
+    const long seconds_elapsed = clock.elapsed() / 1000;
+    if (seconds_elapsed == elapsed) {
+        return;
+    }
+    elapsed = seconds_elapsed;
+    updateTimeLeft();
+
     int hours, minutes, seconds;
     minutes = elapsed / 60;
     seconds = elapsed % 60;
@@ -201,10 +257,15 @@ void ProgressDialog::updateTimeLeft()
     int total_count = ui->totalProgressBar->maximum();
     int processed = ui->totalProgressBar->value();
 
-    if (processed > 0) {
+    if ((m_speed > 0 && m_totalSize > 0) || processed > 0) {
         long left = 0;
         int hours, minutes, seconds;
-        left = float(total_count) / float(processed) * elapsed - elapsed;
+        if (m_speed > 0 && m_totalSize > 0) {
+            // Rest of the job at the current speed
+            left = m_totalSize > m_processedSize ? (m_totalSize - m_processedSize) / m_speed : 0;
+        } else {
+            left = float(total_count) / float(processed) * elapsed - elapsed;
+        }
         minutes = left / 60;
         seconds = left % 60;
         hours = minutes / 60;
@@ -217,3 +278,32 @@ void ProgressDialog::updateTimeLeft()
         ui->label_7->setText(QString("%1:%2:%3").arg("",2, fillChar).arg("",2, fillChar).arg("",2, fillChar));
     }
 }
+
+void ProgressDialog::sampleProgress()
+{
+    if (!m_channel) {
+        return;
+    }
+
+    const int total = m_channel->totalProgress();
+    if (total != m_totalProgress) {
+        m_totalProgress = total;
+        if (total >= 0) {
+            setTotalProgress(total);
+        }
+    }
+
+    const int file = m_channel->currentFileProgress();
+    if (file != m_fileProgress) {
+        m_fileProgress = file;
+        if (file != ProgressChannel::NoProgress) {
+            setCurrentProgress(file);
+        }
+    }
+
+    const int serial = m_channel->currentFileSerial();
+    if (serial != m_fileSerial) {
+        m_fileSerial = serial;
+        setCurrentLabelText(m_channel->currentFile());
+    }
+}
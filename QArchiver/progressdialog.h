@@ -5,9 +5,12 @@
 #include <QLabel>
 #include <QProgressBar>
 #include <QTimer>
+#include <QElapsedTimer>
 
 #include "jobinterface.h"
 
+class ProgressChannel;
+
 namespace Ui {
 class ProgressDialog;
 }
@@ -36,6 +39,9 @@ public slots:
 
     void jobFinished();
     void onJobPercent(QJob *job, unsigned long  percent);
+    void setTotalSize(QJob *job, qulonglong size);
+    void setProcessedSize(QJob *job, qulonglong size);
+    void setSpeed(QJob *job, unsigned long bytesPerSecond);
     void setDescription(QJob *job, const QString &title, const QPair< QString, QString > &f1, const QPair< QString, QString > &f2);
     void setInformation(QJob *job, const QString &plain, const QString &rich);
 
@@ -43,11 +49,24 @@ private slots:
     void setCompletedValue(int value);
     void updateElapsed();
     void updateTimeLeft();
+    void sampleProgress();
 private:
     Ui::ProgressDialog *ui;
     QTimer *timer;
+    QElapsedTimer clock;
     QPixmap icon;
     long int elapsed;
+
+    // progress of the registered job, sampled by the timer
+    ProgressChannel *m_channel;
+    int m_totalProgress;
+    int m_fileProgress;
+    int m_fileSerial;
+
+    // sizes and speed of the job for the time left
+    qulonglong m_totalSize;
+    qulonglong m_processedSize;
+    unsigned long m_speed;
 };
 
 #endif // PROGRESSDIALOG_H
@@ -27,6 +27,7 @@ Archive::Archive(ArchiveInterface *interface, QObject *parent) :
 
     if (QMetaType::type("ArchiveEntry") == 0) {
         qRegisterMetaType<ArchiveEntry>("ArchiveEntry");
+        qRegisterMetaType<ArchiveEntryList>("ArchiveEntryList");
     }
 }
 
@@ -49,12 +50,17 @@ Archive::Archive(const QMimeType &mimeType, const QString &fileName, ArchiveInte
 
     if (QMetaType::type("ArchiveEntry") == 0) {
         qRegisterMetaType<ArchiveEntry>("ArchiveEntry");
+        qRegisterMetaType<ArchiveEntryList>("ArchiveEntryList");
     }
 }
 
 OpenJob *Archive::open()
 {
     OpenJob* job = new OpenJob(this, this);
+
+    // Archive may be listed during opening
+    connect(job, SIGNAL(result(QJob*)), this, SLOT(onOpenFinished(QJob*)));
+
     return job;
 }
 
@@ -200,6 +206,14 @@ QString Archive::createSubfolderName()
     return base;
 }
 
+void Archive::onOpenFinished(QJob *job)
+{
+    OpenJob *ojob = qobject_cast<OpenJob*>(job);
+    if (ojob && ojob->entriesListed()) {
+        onListFinished(job);
+    }
+}
+
 void Archive::onListFinished(QJob *job)
 {
     qDebug()<< "Archive::onListFinished()";
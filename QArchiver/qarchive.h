@@ -42,6 +42,8 @@ enum EntryMetaDataType {
 
 // Archive entry
 typedef QHash<int, QVariant> ArchiveEntry;
+// Entries are delivered from the backends in batches
+typedef QList<ArchiveEntry> ArchiveEntryList;
 
 // Compression / Extraction opt
 typedef QHash<QString, QVariant> CompressionOptions;
@@ -113,6 +115,7 @@ signals:
     void codePageChanged(const QString &cp);
 
 private slots:
+    void onOpenFinished(QJob*);
     void onListFinished(QJob*);
     void onAddFinished(QJob *);
 
@@ -1,6 +1,11 @@
 #include "qstandarddirs.h"
 #include <QDir>
 #include <QApplication>
+#if (QT_VERSION >= QT_VERSION_CHECK(5, 0, 0))
+#include <QStandardPaths>
+#else
+#include <QDesktopServices>
+#endif
 #include <QDebug>
 
 QStandardDirs::QStandardDirs(QObject *parent) :
@@ -87,3 +92,19 @@ QString QStandardDirs::testPath()
 
     return path.join("\n");
 }
+
+// Adresář pro cache aplikace, vytvoří se pokud neexistuje
+QString QStandardDirs::cacheLocation(const QString &subdir)
+{
+#if (QT_VERSION >= QT_VERSION_CHECK(5, 0, 0))
+    QString path = QStandardPaths::writableLocation(QStandardPaths::CacheLocation);
+#else
+    QString path = QDesktopServices::storageLocation(QDesktopServices::CacheLocation);
+#endif
+    if (!subdir.isEmpty()) {
+        path += QLatin1Char('/') + subdir;
+    }
+
+    QDir().mkpath(path);
+    return path;
+}
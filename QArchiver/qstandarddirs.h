@@ -11,6 +11,7 @@ public:
     explicit QStandardDirs(QObject *parent = 0);
     static QString findExe(const QString &appname);
     static QString testPath();
+    static QString cacheLocation(const QString &subdir = QString());
 
 signals:
     
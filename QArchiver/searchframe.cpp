@@ -0,0 +1,157 @@
+#include "searchframe.h"
+#include "archivemodel.h"
+#include "archivesearchindex.h"
+#include "archivesearchmodel.h"
+
+#include <QComboBox>
+#include <QHideEvent>
+#include <QHBoxLayout>
+#include <QLabel>
+#include <QLineEdit>
+#include <QListView>
+#include <QTimer>
+#include <QVBoxLayout>
+
+// Delay between the last key press and the search (ms)
+static const int c_searchDelay = 150;
+
+SearchFrame::SearchFrame(QWidget *parent) :
+    QFrame(parent),
+    m_model(NULL),
+    m_indexOutdated(false)
+{
+    m_index = new ArchiveSearchIndex(this);
+    m_results = new ArchiveSearchModel(m_index, this);
+
+    m_patternEdit = new QLineEdit(this);
+    m_patternEdit->setPlaceholderText(tr("Search in archive"));
+
+    m_syntaxCombo = new QComboBox(this);
+    m_syntaxCombo->addItem(tr("Text"), ArchiveSearchIndex::Substring);
+    m_syntaxCombo->addItem(tr("Wildcard"), ArchiveSearchIndex::Wildcard);
+    m_syntaxCombo->addItem(tr("Regular expression"), ArchiveSearchIndex::RegExp);
+
+    m_statusLabel = new QLabel(this);
+
+    m_resultView = new QListView(this);
+    m_resultView->setModel(m_results);
+    m_resultView->setUniformItemSizes(true);
+    m_resultView->setEditTriggers(QAbstractItemView::NoEditTriggers);
+
+    QHBoxLayout *patternLayout = new QHBoxLayout;
+    patternLayout->addWidget(m_patternEdit, 1);
+    patternLayout->addWidget(m_syntaxCombo);
+
+    QVBoxLayout *layout = new QVBoxLayout(this);
+    layout->setContentsMargins(0, 0, 0, 0);
+    layout->addLayout(patternLayout);
+    layout->addWidget(m_statusLabel);
+    layout->addWidget(m_resultView, 1);
+
+    m_searchTimer = new QTimer(this);
+    m_searchTimer->setSingleShot(true);
+    m_searchTimer->setInterval(c_searchDelay);
+
+    connect(m_patternEdit, SIGNAL(textChanged(QString)), this, SLOT(scheduleSearch()));
+    connect(m_patternEdit, SIGNAL(returnPressed()), this, SLOT(search()));
+    connect(m_syntaxCombo, SIGNAL(currentIndexChanged(int)), this, SLOT(search()));
+    connect(m_searchTimer, SIGNAL(timeout()), this, SLOT(search()));
+    connect(m_results, SIGNAL(modelReset()), this, SLOT(updateStatus()));
+    connect(m_resultView, SIGNAL(activated(QModelIndex)), this, SLOT(onResultActivated(QModelIndex)));
+
+    updateStatus();
+}
+
+void SearchFrame::setArchiveModel(ArchiveModel *model)
+{
+    m_model = model;
+    m_indexOutdated = false;
+
+    // Index is built when the listing is finished
+    m_index->clear();
+    m_results->refresh();
+}
+
+void SearchFrame::updateIndex()
+{
+    if (m_model == NULL) {
+        return;
+    }
+
+    if (!isVisible()) {
+        m_indexOutdated = true;
+        return;
+    }
+    m_indexOutdated = false;
+
+    QVector<QString> paths;
+    QBitArray dirs;
+    m_model->collectPaths(&paths, &dirs);
+    m_index->build(paths, dirs);
+
+    // Results are searched again when the index is ready
+    m_results->refresh();
+}
+
+void SearchFrame::showEvent(QShowEvent *event)
+{
+    QFrame::showEvent(event);
+
+    if (m_indexOutdated) {
+        updateIndex();
+    }
+    m_patternEdit->setFocus();
+}
+
+/* Index is not kept for the closed frame, it is built again when shown */
+void SearchFrame::hideEvent(QHideEvent *event)
+{
+    QFrame::hideEvent(event);
+
+    // Minimized window
+    if (event->spontaneous()) {
+        return;
+    }
+    if (m_model != NULL && (m_index->isReady() || m_index->isBuilding())) {
+        m_index->clear();
+        m_results->refresh();
+        m_indexOutdated = true;
+    }
+}
+
+void SearchFrame::scheduleSearch()
+{
+    m_searchTimer->start();
+}
+
+void SearchFrame::search()
+{
+    m_searchTimer->stop();
+
+    const ArchiveSearchIndex::Syntax syntax =
+            ArchiveSearchIndex::Syntax(m_syntaxCombo->itemData(m_syntaxCombo->currentIndex()).toInt());
+    m_results->setPattern(m_patternEdit->text(), syntax);
+}
+
+void SearchFrame::updateStatus()
+{
+    QString status;
+    if (!m_results->pattern().isEmpty()) {
+        status = tr("%n matches", "", m_results->rowCount());
+    }
+    if (m_results->isSearching()) {
+        status = tr("Searching...");
+    }
+    if (m_index->isBuilding()) {
+        status = status.isEmpty() ? tr("Indexing...") : tr("%1 (indexing...)").arg(status);
+    }
+    m_statusLabel->setText(status);
+}
+
+void SearchFrame::onResultActivated(const QModelIndex &index)
+{
+    const QString path = m_results->path(index);
+    if (!path.isEmpty()) {
+        emit entryActivated(path);
+    }
+}
@@ -0,0 +1,55 @@
+#ifndef SEARCHFRAME_H
+#define SEARCHFRAME_H
+
+#include <QFrame>
+
+class QComboBox;
+class QLabel;
+class QLineEdit;
+class QListView;
+class QModelIndex;
+class QTimer;
+class ArchiveModel;
+class ArchiveSearchIndex;
+class ArchiveSearchModel;
+
+/* Search box with the list of matching entries */
+class SearchFrame : public QFrame
+{
+    Q_OBJECT
+
+public:
+    explicit SearchFrame(QWidget *parent = 0);
+
+    void setArchiveModel(ArchiveModel *model);
+
+public slots:
+    // Index the entries again, postponed while the frame is hidden
+    void updateIndex();
+
+signals:
+    void entryActivated(const QString &path);
+
+protected:
+    virtual void showEvent(QShowEvent *event);
+    virtual void hideEvent(QHideEvent *event);
+
+private slots:
+    void scheduleSearch();
+    void search();
+    void updateStatus();
+    void onResultActivated(const QModelIndex &index);
+
+private:
+    ArchiveModel *m_model;
+    ArchiveSearchIndex *m_index;
+    ArchiveSearchModel *m_results;
+    QLineEdit *m_patternEdit;
+    QComboBox *m_syntaxCombo;
+    QLabel *m_statusLabel;
+    QListView *m_resultView;
+    QTimer *m_searchTimer; // search after typing stops
+    bool m_indexOutdated;
+};
+
+#endif // SEARCHFRAME_H
@@ -0,0 +1,110 @@
+#include "selectionmatcher.h"
+
+SelectionMatcher::SelectionMatcher()
+{
+}
+
+SelectionMatcher::SelectionMatcher(const QVariantList &files)
+{
+    m_paths.reserve(files.count());
+    foreach (const QVariant &file, files) {
+        m_paths.insert(file.toString());
+    }
+}
+
+void SelectionMatcher::addPath(const QString &path)
+{
+    m_paths.insert(path);
+}
+
+void SelectionMatcher::addDirectory(const QString &path)
+{
+    if (m_trie.isEmpty()) {
+        m_trie.append(TrieNode());
+    }
+
+    int node = 0;
+    int from = 0;
+    const int len = path.length();
+    while (from < len) {
+        int slash = path.indexOf(QLatin1Char('/'), from);
+        if (slash < 0) {
+            slash = len;
+        }
+        if (slash > from) {
+            const QString piece = path.mid(from, slash - from);
+            int child = m_trie.at(node).children.value(piece, -1);
+            if (child < 0) {
+                child = m_trie.count();
+                m_trie.append(TrieNode());
+                m_trie[node].children.insert(piece, child);
+            }
+            node = child;
+        }
+        from = slash + 1;
+    }
+
+    // The root would select everything
+    if (node > 0) {
+        m_trie[node].selected = true;
+    }
+}
+
+bool SelectionMatcher::isEmpty() const
+{
+    return m_paths.isEmpty() && m_trie.isEmpty();
+}
+
+bool SelectionMatcher::matches(const QString &path) const
+{
+    return m_paths.contains(path) || matchesDirectory(path, false);
+}
+
+bool SelectionMatcher::matchesParent(const QString &path) const
+{
+    return matchesDirectory(path, true);
+}
+
+/* Walk the trie along the path pieces until a selected directory is found */
+bool SelectionMatcher::matchesDirectory(const QString &path, bool parentsOnly) const
+{
+    if (m_trie.isEmpty()) {
+        return false;
+    }
+
+    // "dir/" is the same path as "dir"
+    int len = path.length();
+    while (len > 0 && path.at(len - 1) == QLatin1Char('/')) {
+        --len;
+    }
+    if (len == 0) {
+        return false;
+    }
+    if (parentsOnly) {
+        len = path.lastIndexOf(QLatin1Char('/'), len - 1);
+        if (len <= 0) {
+            return false;
+        }
+    }
+
+    int node = 0;
+    int from = 0;
+    while (from < len) {
+        int slash = path.indexOf(QLatin1Char('/'), from);
+        if (slash < 0 || slash > len) {
+            slash = len;
+        }
+        if (slash > from) {
+            node = m_trie.at(node).children.value(path.mid(from, slash - from), -1);
+            if (node < 0) {
+                return false;
+            }
+            if (m_trie.at(node).selected) {
+                return true;
+            }
+        }
+        from = slash + 1;
+    }
+
+    return false;
+}
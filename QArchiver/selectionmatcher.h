@@ -0,0 +1,45 @@
+#ifndef SELECTIONMATCHER_H
+#define SELECTIONMATCHER_H
+
+#include <QHash>
+#include <QSet>
+#include <QString>
+#include <QVariant>
+#include <QVector>
+
+/*
+ * Set of selected archive paths. Paths are hashed, selected directories
+ * are kept in a trie of path pieces and match their whole subtree.
+ * Const methods can be used from more threads.
+ */
+class SelectionMatcher
+{
+public:
+    SelectionMatcher();
+    // Exact paths (InternalID of the entries)
+    explicit SelectionMatcher(const QVariantList &files);
+
+    void addPath(const QString &path);
+    void addDirectory(const QString &path);
+
+    bool isEmpty() const;
+
+    // Selected path or a path inside a selected directory
+    bool matches(const QString &path) const;
+    // Some parent directory of the path is selected
+    bool matchesParent(const QString &path) const;
+
+private:
+    struct TrieNode {
+        TrieNode() : selected(false) {}
+        QHash<QString, int> children; // piece -> node
+        bool selected;
+    };
+
+    bool matchesDirectory(const QString &path, bool parentsOnly) const;
+
+    QSet<QString> m_paths;
+    QVector<TrieNode> m_trie; // [0] is the root, empty without directories
+};
+
+#endif // SELECTIONMATCHER_H
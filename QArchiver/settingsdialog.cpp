@@ -51,6 +51,16 @@ void SettingsDialog::createPages()
     la_settings->setToolManager(ArchiveToolManager::Instance());
     vertical_layout->addWidget(la_settings);
 
+    lazyLoading = new QCheckBox(ui->page);
+    lazyLoading->setText(tr("Load folder contents when expanded (saves memory on large archives)"));
+    lazyLoading->setChecked(false);
+    vertical_layout->addWidget(lazyLoading);
+
+    naturalSorting = new QCheckBox(ui->page);
+    naturalSorting->setText(tr("Sort numbers in names by value (file2 before file10)"));
+    naturalSorting->setChecked(true);
+    vertical_layout->addWidget(naturalSorting);
+
     /* Page 2 */
     QVBoxLayout *vertical_layout_p2 = new QVBoxLayout(ui->page_2);
 
@@ -71,6 +81,8 @@ void SettingsDialog::readSettings()
 {
     QSettings settings;
     encodingInfo->setChecked(settings.value("showEncodingInfo", true).toBool());
+    lazyLoading->setChecked(settings.value("lazyLoading", false).toBool());
+    naturalSorting->setChecked(settings.value("naturalSorting", true).toBool());
 //    analyseEncoding->setChecked(settings.value("analyseEncoding", true).toBool());
 }
 
@@ -78,12 +90,16 @@ void SettingsDialog::writeSettings()
 {
     QSettings settings;
     settings.setValue("showEncodingInfo", encodingInfo->isChecked());
+    settings.setValue("lazyLoading", lazyLoading->isChecked());
+    settings.setValue("naturalSorting", naturalSorting->isChecked());
 //    settings.setValue("analyseEncoding", analyseEncoding->isChecked());
 }
 
 void SettingsDialog::defaultSettings()
 {
     encodingInfo->setChecked(true);
+    lazyLoading->setChecked(false);
+    naturalSorting->setChecked(true);
 //    analyseEncoding->setChecked(true);
 }
 
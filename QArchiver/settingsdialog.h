@@ -41,6 +41,8 @@ private:
     LibAchiveSettingsWidget *la_settings;
     //QCheckBox *analyseEncoding;
     QCheckBox *encodingInfo;
+    QCheckBox *lazyLoading;
+    QCheckBox *naturalSorting;
 };
 
 #endif // SETTINGSDIALOG_H